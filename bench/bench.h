@@ -0,0 +1,99 @@
+// Helpers shared by the benchmark drivers, included right after ../src/main.c
+#ifndef KORT_BENCH_H
+#define KORT_BENCH_H
+
+#include <errno.h>
+#include <time.h>
+
+// Results go here, stdout is pointed at /dev/null so kort's own logging stays out of the timings
+FILE *benchOut;
+
+// Keep the driver's report on the real stdout and silence everything kort prints
+void startBenchReport(void) {
+    fflush(stdout);
+    int reportFd = dup(STDOUT_FILENO);
+    benchOut = reportFd >= 0 ? fdopen(reportFd, "w") : NULL;
+    if (benchOut == NULL) {
+        benchOut = stderr;
+        return;
+    }
+    setvbuf(benchOut, NULL, _IOLBF, 0);
+    if (freopen("/dev/null", "w", stdout) == NULL) {
+        fprintf(stderr, "kort-bench: could not silence stdout, kort's log is mixed into the report\n");
+    }
+}
+
+// Monotonic clock in seconds
+double benchSeconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// Create an empty directory for one run under $TMPDIR (or /tmp)
+bool makeBenchDir(char *buffer, size_t bufferSize) {
+    const char *tempDir = getenv("TMPDIR");
+    int written = snprintf(buffer, bufferSize, "%s/kort-bench-XXXXXX",
+                           tempDir != NULL && tempDir[0] != '\0' ? tempDir : "/tmp");
+    if (written < 0 || (size_t)written >= bufferSize || mkdtemp(buffer) == NULL) {
+        fprintf(stderr, "kort-bench: could not create a temp directory: %s\n", strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+// Write a whole file, says why when it could not
+bool writeBenchFile(const char *path, const char *data, size_t length) {
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) {
+        fprintf(stderr, "kort-bench: could not create %s: %s\n", path, strerror(errno));
+        return false;
+    }
+    bool ok = fwrite(data, 1, length, file) == length;
+    ok = fclose(file) == 0 && ok;
+    if (!ok) {
+        fprintf(stderr, "kort-bench: could not write %s\n", path);
+    }
+    return ok;
+}
+
+// Delete a benchmark directory and everything the run left in it
+void removeBenchDir(const char *path) {
+    DIR *dir = opendir(path);
+    if (dir != NULL) {
+        struct dirent *entry;
+        char child[4096];
+        while ((entry = readdir(dir)) != NULL) {
+            if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+            snprintf(child, sizeof(child), "%s/%s", path, entry->d_name);
+            struct stat info;
+            if (lstat(child, &info) == 0 && S_ISDIR(info.st_mode)) {
+                removeBenchDir(child);
+            } else {
+                unlink(child);
+            }
+        }
+        closedir(dir);
+    }
+    rmdir(path);
+}
+
+// qsort comparator for latency samples
+int compareBenchSamples(const void *a, const void *b) {
+    double left = *(const double*)a;
+    double right = *(const double*)b;
+    return (left > right) - (left < right);
+}
+
+// Print the median, 99th percentile and worst of samples taken in seconds, sorts them in place
+void printLatencies(const char *label, double *samples, int count) {
+    if (count <= 0) {
+        fprintf(benchOut, "%-28s no samples\n", label);
+        return;
+    }
+    qsort(samples, count, sizeof(double), compareBenchSamples);
+    fprintf(benchOut, "%-28s p50 %9.3f ms   p99 %9.3f ms   max %9.3f ms   (%d samples)\n", label,
+            samples[count / 2] * 1000.0, samples[(int)(count * 0.99)] * 1000.0, samples[count - 1] * 1000.0, count);
+}
+
+#endif
@@ -0,0 +1,106 @@
+// Content grep throughput over a large synthetic script corpus.
+//
+//   npm run build:bench && ./bench/bin/content_grep [corpus MB]
+//
+// Writes the corpus once (files of 16 KB to 1 MB spread over 16 folders, 256 MB by default), then
+// runs the grep the search box starts for a pattern on a few hundred lines, one on every other
+// line and one that never matches. The corpus stays in the page cache, so this is the scan and
+// not the disk. Match counts are checked against the ones planted in the corpus.
+#define main kort_main
+#include "../src/main.c"
+#undef main
+#include "bench.h"
+
+#define DEFAULT_CORPUS_MB 256
+#define GREP_ROUNDS 3
+#define RARE_PATTERN "https://www.ebay.com/sh/ovw"
+#define RARE_EVERY 20000
+
+// Run one grep to the end and return its elapsed seconds
+double runGrep(ContentGrep *grep, const char *pattern) {
+    startContentGrep(grep, pattern);
+    while (grep->active) {
+        pollContentGrep(grep);
+        usleep(100);
+    }
+    return grep->elapsedMs / 1000.0;
+}
+
+int main(int argc, char **argv) {
+    int corpusMb = argc > 1 ? atoi(argv[1]) : DEFAULT_CORPUS_MB;
+    if (corpusMb <= 0) {
+        fprintf(stderr, "usage: %s [corpus MB]\n", argv[0]);
+        return 2;
+    }
+    startBenchReport();
+
+    char dir[256];
+    char path[PATH_MAX];
+    if (!makeBenchDir(dir, sizeof(dir))) {
+        return 1;
+    }
+
+    size_t fileCapacity = 1024 * 1024 + 256;
+    char *content = (char*)malloc(fileCapacity);
+    uint64_t corpusBytes = (uint64_t)corpusMb * 1024 * 1024;
+    uint64_t written = 0;
+    long lineNumber = 0;
+    int rareLines = 0;
+    int echoLines = 0;
+    int files = 0;
+    double startTime = benchSeconds();
+    for (int folder = 0; folder < 16; folder++) {
+        snprintf(path, sizeof(path), "%s/team-%d", dir, folder);
+        mkdir(path, 0700);
+    }
+    while (written < corpusBytes) {
+        size_t target = (size_t)16 * 1024 << (files % 7);
+        size_t length = 0;
+        while (length < target) {
+            if (++lineNumber % RARE_EVERY == 0) {
+                length += (size_t)sprintf(content + length, "open \"%s?page=%ld\"\n", RARE_PATTERN, lineNumber);
+                rareLines++;
+            } else if (lineNumber % 2 == 0) {
+                length += (size_t)sprintf(content + length, "echo \"step %ld of the nightly deploy\"\n", lineNumber);
+                echoLines++;
+            } else {
+                length += (size_t)sprintf(content + length, "curl -s https://api.example.com/v1/items/%ld | jq .name\n",
+                                          lineNumber);
+            }
+        }
+        snprintf(path, sizeof(path), "%s/team-%d/job-%d.sh", dir, files % 16, files);
+        if (!writeBenchFile(path, content, length)) {
+            free(content);
+            removeBenchDir(dir);
+            return 1;
+        }
+        written += length;
+        files++;
+    }
+    fprintf(benchOut, "wrote %d files, %.1f MB in %.2f s\n", files, written / (1024.0 * 1024.0),
+            benchSeconds() - startTime);
+
+    ContentGrep grep;
+    initContentGrep(&grep, dir);
+    const char *patterns[] = { RARE_PATTERN, "echo \"step", "kort-never-matches" };
+    const int expected[] = { rareLines, echoLines, 0 };
+    int wrong = 0;
+    for (int p = 0; p < 3; p++) {
+        double best = 0;
+        for (int round = 0; round < GREP_ROUNDS; round++) {
+            double elapsed = runGrep(&grep, patterns[p]);
+            if (round == 0 || elapsed < best) best = elapsed;
+        }
+        bool counted = grep.matchTotal == expected[p] && grep.bytesScanned == written;
+        wrong += !counted;
+        fprintf(benchOut, "%-22s %7.2f GB/s  %8.1f ms  %8d matching lines%s\n", patterns[p],
+                best > 0 ? grep.bytesScanned / best / 1e9 : 0.0, best * 1000.0, grep.matchTotal,
+                counted ? "" : "  (wrong count or bytes)");
+    }
+    fprintf(benchOut, "%d grep threads\n", grep.threadCount);
+
+    freeContentGrep(&grep);
+    free(content);
+    removeBenchDir(dir);
+    return wrong == 0 ? 0 : 1;
+}
@@ -0,0 +1,142 @@
+// Daemon round trips and triggers per second against a local stand-in client.
+//
+//   npm run build:bench && ./bench/bin/daemon_triggers [requests per phase]
+//
+// Forks a daemon (runDaemon) on a private socket, then acts as the client: status and list round
+// trips on one connection, script triggers on one connection, and a fresh connection per trigger
+// the way a shell keybinding calls "kort trigger". Triggers run an empty script inline on
+// /dev/null in our cwd and environment, so they measure the daemon's request handling plus its
+// hand-off to a spawner and not a terminal. Back to back, the empty scripts share the CPU with the
+// daemon, so "paced" leaves 5 ms between triggers to show the latency of a single keypress.
+// KORT_WARM_SHELLS=0 shows the cold posix_spawn path.
+// The daemon lists scripts next to its executable, so the trigger script is created in
+// bench/bin/scripts for the run and removed afterwards.
+#define main kort_main
+#include "../src/main.c"
+#undef main
+#include "bench.h"
+
+#define DEFAULT_REQUESTS 5000
+#define PACED_GAP_US 5000
+#define TRIGGER_SCRIPT "kort-bench-trigger"
+
+// One request and its response, false when the daemon did not answer with status >= 0
+bool daemonRoundTrip(int fd, DaemonOp op, uint8_t flags, const int *fds, int fdCount) {
+    static char payload[DAEMON_MAX_PAYLOAD];
+    size_t length = op == DAEMON_OP_RUN ? buildDaemonRunPayload(TRIGGER_SCRIPT, payload, sizeof(payload)) : 0;
+    DaemonResponse response;
+    char *reply = NULL;
+    bool ok = sendDaemonRequest(fd, op, flags, payload, length, fds, fdCount) &&
+              readDaemonResponse(fd, &response, &reply) && response.status >= 0;
+    free(reply);
+    return ok;
+}
+
+// Time one phase of requests and print its rate and latencies, returns how many failed. gapUs
+// pauses between requests, outside the timing
+int runPhase(const char *label, int requests, double *samples, DaemonOp op, uint8_t flags, const int *fds,
+             int fdCount, bool connectEach, int gapUs) {
+    int fd = connectEach ? -1 : connectDaemon();
+    int done = 0;
+    int failed = 0;
+    double phaseStart = benchSeconds();
+    double paused = 0;
+    for (int i = 0; i < requests; i++) {
+        if (gapUs > 0) {
+            double pauseStart = benchSeconds();
+            usleep(gapUs);
+            paused += benchSeconds() - pauseStart;
+        }
+        double startTime = benchSeconds();
+        if (connectEach) {
+            fd = connectDaemon();
+        }
+        bool ok = fd >= 0 && daemonRoundTrip(fd, op, flags, fds, fdCount);
+        if (connectEach && fd >= 0) {
+            close(fd);
+            fd = -1;
+        }
+        if (!ok) {
+            failed++;
+            continue;
+        }
+        samples[done++] = benchSeconds() - startTime;
+    }
+    double elapsed = benchSeconds() - phaseStart - paused;
+    if (fd >= 0) {
+        close(fd);
+    }
+    fprintf(benchOut, "%-28s %8.0f per second\n", label, done / elapsed);
+    printLatencies("", samples, done);
+    return failed;
+}
+
+int main(int argc, char **argv) {
+    int requests = argc > 1 ? atoi(argv[1]) : DEFAULT_REQUESTS;
+    if (requests <= 0) {
+        fprintf(stderr, "usage: %s [requests per phase]\n", argv[0]);
+        return 2;
+    }
+    startBenchReport();
+
+    char dir[256];
+    char socketPath[PATH_MAX];
+    char scriptDir[PATH_MAX];
+    char scriptPath[PATH_MAX + 32];
+    if (!makeBenchDir(dir, sizeof(dir))) {
+        return 1;
+    }
+    snprintf(socketPath, sizeof(socketPath), "%s/kort.sock", dir);
+    setenv("KORT_SOCKET", socketPath, 1);
+    getScriptsPath(scriptDir, sizeof(scriptDir));
+    snprintf(scriptPath, sizeof(scriptPath), "%s/%s.sh", scriptDir, TRIGGER_SCRIPT);
+    if (!writeBenchFile(scriptPath, ":\n", 2)) {
+        removeBenchDir(dir);
+        return 1;
+    }
+
+    pid_t daemonPid = fork();
+    if (daemonPid == 0) {
+        _exit(runDaemon());
+    }
+    int probe = -1;
+    for (int i = 0; i < 500 && probe < 0 && daemonPid > 0; i++) {
+        usleep(10000);
+        probe = connectDaemon();
+    }
+    if (probe < 0) {
+        fprintf(benchOut, "the daemon did not come up on %s\n", socketPath);
+        if (daemonPid > 0) kill(daemonPid, SIGTERM);
+        unlink(scriptPath);
+        removeBenchDir(dir);
+        return 1;
+    }
+    close(probe);
+
+    int nullFd = open("/dev/null", O_RDWR | O_CLOEXEC);
+    int cwdFd = open(".", O_PATH | O_DIRECTORY | O_CLOEXEC);
+    const int runFds[DAEMON_RUN_FDS] = { cwdFd, nullFd, nullFd, nullFd };
+    double *samples = (double*)malloc(requests * sizeof(double));
+    int failed = 0;
+    int paced = requests / 10 > 0 ? requests / 10 : 1;
+    failed += runPhase("status, one connection", requests, samples, DAEMON_OP_STATUS, 0, NULL, 0, false, 0);
+    failed += runPhase("list, one connection", requests, samples, DAEMON_OP_LIST, 0, NULL, 0, false, 0);
+    failed += runPhase("trigger, one connection", requests, samples, DAEMON_OP_RUN, DAEMON_RUN_INLINE, runFds,
+                       DAEMON_RUN_FDS, false, 0);
+    failed += runPhase("trigger, connect each", requests, samples, DAEMON_OP_RUN, DAEMON_RUN_INLINE, runFds,
+                       DAEMON_RUN_FDS, true, 0);
+    failed += runPhase("trigger, paced", paced, samples, DAEMON_OP_RUN, DAEMON_RUN_INLINE, runFds,
+                       DAEMON_RUN_FDS, true, PACED_GAP_US);
+    if (failed > 0) {
+        fprintf(benchOut, "%d requests failed or were refused\n", failed);
+    }
+
+    kill(daemonPid, SIGTERM);
+    waitpid(daemonPid, NULL, 0);
+    close(nullFd);
+    close(cwdFd);
+    free(samples);
+    unlink(scriptPath);
+    removeBenchDir(dir);
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,146 @@
+// Typing, pasting and deleting in multi-MB scripts through the editor Modal.
+//
+//   npm run build:bench && ./bench/bin/editor_edits [script MB]
+//
+// Loads a script of 1 MB and one of the given size (8 MB by default) into the editor, then types
+// 100k keys in the middle, pastes 1 MB, backspaces 100k keys and makes 1000 edits at random
+// positions, all through insertTextAtCursor and deleteCharAtCursor with their undo logging. The
+// text is checked after the paste and again after undoing everything. For comparison the same
+// keystrokes are replayed on a flat array that memmoves its tail, like the old editor did.
+#define main kort_main
+#include "../src/main.c"
+#undef main
+#include "bench.h"
+
+#define DEFAULT_SCRIPT_MB 8
+#define TYPED_KEYS 100000
+#define PASTE_BYTES (1024 * 1024)
+#define RANDOM_EDITS 1000
+#define FLAT_KEYS 20000
+
+// Edit a script of size bytes, returns false when the text came out wrong
+bool benchScript(const char *doc, int size, const char *paste) {
+    Modal modal;
+    initModal(&modal);
+    openModal(&modal);
+
+    double startTime = benchSeconds();
+    setTextContent(&modal.command, doc, size);
+    modal.commandLength = size;
+    double loadTime = benchSeconds() - startTime;
+
+    int middle = size / 2;
+    modal.cursorPos = middle;
+    startTime = benchSeconds();
+    for (int i = 0; i < TYPED_KEYS; i++) {
+        insertTextAtCursor(&modal, "x");
+    }
+    double typeTime = benchSeconds() - startTime;
+
+    startTime = benchSeconds();
+    insertTextAtCursor(&modal, paste);
+    double pasteTime = benchSeconds() - startTime;
+
+    startTime = benchSeconds();
+    for (int i = 0; i < TYPED_KEYS; i++) {
+        deleteCharAtCursor(&modal, true);
+    }
+    double deleteTime = benchSeconds() - startTime;
+
+    // Expected: the text before the middle, the typed keys, what is left of the paste, the rest
+    int keptPaste = PASTE_BYTES - TYPED_KEYS;
+    const char *text = getTextString(&modal.command);
+    bool ok = modal.commandLength == size + PASTE_BYTES && memcmp(text, doc, middle) == 0 &&
+              memcmp(text + middle + TYPED_KEYS, paste, keptPaste) == 0 &&
+              memcmp(text + middle + TYPED_KEYS + keptPaste, doc + middle, size - middle) == 0;
+    for (int i = 0; ok && i < TYPED_KEYS; i++) {
+        ok = text[middle + i] == 'x';
+    }
+
+    srand(1);
+    startTime = benchSeconds();
+    for (int i = 0; i < RANDOM_EDITS; i++) {
+        modal.cursorPos = rand() % modal.commandLength;
+        insertTextAtCursor(&modal, "y");
+    }
+    double randomTime = benchSeconds() - startTime;
+
+    startTime = benchSeconds();
+    int undoSteps = 0;
+    while (modal.editCount > 0) {
+        performUndo(&modal);
+        undoSteps++;
+    }
+    double undoTime = benchSeconds() - startTime;
+    bool undone = modal.commandLength == size && memcmp(getTextString(&modal.command), doc, size) == 0;
+
+    fprintf(benchOut, "%.0f MB script: load %.2f ms, type %.1f ns/key, paste 1 MB %.2f ms, backspace %.1f ns/key, "
+            "random edit %.2f us, undo all (%d steps) %.2f ms\n", size / (1024.0 * 1024.0), loadTime * 1e3,
+            typeTime / TYPED_KEYS * 1e9, pasteTime * 1e3, deleteTime / TYPED_KEYS * 1e9,
+            randomTime / RANDOM_EDITS * 1e6, undoSteps, undoTime * 1e3);
+    if (!ok || !undone) {
+        fprintf(benchOut, "%s\n", !ok ? "text is wrong after type, paste and backspace" : "undo did not restore the script");
+    }
+
+    clearUndoHistory(&modal);
+    freeTextBuffer(&modal.command);
+    freeTextLayout(&modal.layout);
+    return ok && undone;
+}
+
+// The old engine: one array, every keystroke in the middle moves the whole tail
+void benchFlatArray(const char *doc, int size) {
+    char *flat = (char*)malloc(size + FLAT_KEYS + 1);
+    memcpy(flat, doc, size);
+    int length = size;
+    int pos = size / 2;
+
+    double startTime = benchSeconds();
+    for (int i = 0; i < FLAT_KEYS; i++) {
+        memmove(flat + pos + 1, flat + pos, length - pos);
+        flat[pos++] = 'x';
+        length++;
+    }
+    double typeTime = benchSeconds() - startTime;
+
+    startTime = benchSeconds();
+    for (int i = 0; i < FLAT_KEYS; i++) {
+        memmove(flat + pos - 1, flat + pos, length - pos);
+        pos--;
+        length--;
+    }
+    double deleteTime = benchSeconds() - startTime;
+
+    fprintf(benchOut, "%.0f MB flat array: type %.1f ns/key, backspace %.1f ns/key\n", size / (1024.0 * 1024.0),
+            typeTime / FLAT_KEYS * 1e9, deleteTime / FLAT_KEYS * 1e9);
+    free(flat);
+}
+
+int main(int argc, char **argv) {
+    int scriptMb = argc > 1 ? atoi(argv[1]) : DEFAULT_SCRIPT_MB;
+    if (scriptMb <= 0 || scriptMb > 1024) {
+        fprintf(stderr, "usage: %s [script MB]\n", argv[0]);
+        return 2;
+    }
+    startBenchReport();
+
+    int size = scriptMb * 1024 * 1024;
+    char *doc = (char*)malloc(size + 1);
+    for (int i = 0; i < size; i++) {
+        doc[i] = i % 60 == 59 ? '\n' : "echo deploy service "[i % 20];
+    }
+    doc[size] = '\0';
+    char *paste = (char*)malloc(PASTE_BYTES + 1);
+    for (int i = 0; i < PASTE_BYTES; i++) {
+        paste[i] = i % 48 == 47 ? '\n' : "curl -s https://example.com "[i % 28];
+    }
+    paste[PASTE_BYTES] = '\0';
+
+    bool ok = benchScript(doc, 1024 * 1024, paste);
+    ok = benchScript(doc, size, paste) && ok;
+    benchFlatArray(doc, size);
+
+    free(doc);
+    free(paste);
+    return ok ? 0 : 1;
+}
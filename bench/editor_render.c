@@ -0,0 +1,139 @@
+// Editor frame cost on a 1M-line script, against the 60 FPS budget.
+//
+//   npm run build:bench && ./bench/bin/editor_render [lines] [frames]
+//
+// Run it from the repository root so it picks up the same font as kort. Opens a hidden raylib
+// window without a frame cap and draws the editor box with DrawCommandWithLineNumbers: parked in
+// the middle, jumping to a new scroll position with a selection every frame, and typing a key
+// every frame. Each phase runs on a 100-line script too, the times should not depend on the
+// size. "draw" is the renderer alone, "frame" adds EndDrawing's flush to the GPU.
+#define main kort_main
+#include "../src/main.c"
+#undef main
+#include "bench.h"
+
+#define DEFAULT_LINES 1000000
+#define DEFAULT_FRAMES 600
+#define FRAME_BUDGET (1.0 / 60.0)
+
+// Build a script of count lines with a long one every thousand lines, the caller frees it
+char *makeEditorScript(int count, int *length) {
+    size_t capacity = (size_t)count * 128 + 1;
+    char *doc = (char*)malloc(capacity);
+    size_t used = 0;
+    for (int i = 0; i < count; i++) {
+        used += (size_t)snprintf(doc + used, capacity - used, "echo line %d %s\n", i,
+                                 i % 1000 == 0 ? "with a tail long enough to run past the right edge of the editor box" : "");
+    }
+    doc[--used] = '\0';
+    *length = (int)used;
+    return doc;
+}
+
+// Draw frames of one phase and print draw and frame times, returns true when p99 fits the budget
+bool renderPhase(const char *label, Modal *modal, Font font, bool useFont, Rectangle box, int frames, int phase,
+                 double *drawTimes, double *frameTimes) {
+    int lineHeight = fontSize + 4;
+    int lineCount = getTextLineCount(&modal->command);
+    modal->cursorPos = getTextLineStart(&modal->command, lineCount / 2) + 5;
+    for (int f = 0; f < frames; f++) {
+        float scrollY = (float)(lineCount / 2 - 5) * lineHeight;
+        bool hasSelection = false;
+        int selStart = 0;
+        int selEnd = 0;
+        if (phase == 1) {
+            int line = (int)((long long)f * 1667 % lineCount);
+            scrollY = (float)line * lineHeight;
+            selStart = getTextLineStart(&modal->command, line);
+            selEnd = getTextLineEnd(&modal->command, line + 5 < lineCount ? line + 5 : lineCount - 1);
+            hasSelection = true;
+        }
+
+        double frameStart = benchSeconds();
+        if (phase == 2) {
+            int cursorLine;
+            int cursorColumn;
+            insertTextAtCursor(modal, "x");
+            getCursorLineCol(&modal->command, modal->cursorPos, &cursorLine, &cursorColumn);
+        }
+        BeginDrawing();
+        ClearBackground((Color){40, 42, 54, 255});
+        double drawStart = benchSeconds();
+        DrawCommandWithLineNumbers(font, useFont, &modal->command, &modal->layout, box, scrollY, fontSize,
+                                   modal->cursorPos, true, selStart, selEnd, hasSelection);
+        drawTimes[f] = benchSeconds() - drawStart;
+        EndDrawing();
+        frameTimes[f] = benchSeconds() - frameStart;
+    }
+
+    char name[96];
+    snprintf(name, sizeof(name), "%s draw", label);
+    printLatencies(name, drawTimes, frames);
+    snprintf(name, sizeof(name), "%s frame", label);
+    printLatencies(name, frameTimes, frames);
+    // Sorted by printLatencies
+    return frameTimes[(int)(frames * 0.99)] <= FRAME_BUDGET;
+}
+
+int main(int argc, char **argv) {
+    int lines = argc > 1 ? atoi(argv[1]) : DEFAULT_LINES;
+    int frames = argc > 2 ? atoi(argv[2]) : DEFAULT_FRAMES;
+    if (lines <= 0 || frames <= 0) {
+        fprintf(stderr, "usage: %s [lines] [frames]\n", argv[0]);
+        return 2;
+    }
+    startBenchReport();
+
+    SetTraceLogLevel(LOG_WARNING);
+    SetConfigFlags(FLAG_WINDOW_HIDDEN);
+    InitWindow(screenWidth, screenHeight, "kort editor render benchmark");
+    SetTargetFPS(0);
+    Font font = {0};
+    bool useFont = false;
+    if (FileExists("fonts/ttf/JetBrainsMono-Light.ttf")) {
+        font = LoadFont("fonts/ttf/JetBrainsMono-Light.ttf");
+        useFont = true;
+    }
+    // Where kort puts the box in its centered modal
+    Rectangle box = { (float)((screenWidth - 800) / 2 + 20), (float)((screenHeight - 550) / 2 + 160), 760, 300 };
+
+    double *drawTimes = (double*)malloc(frames * sizeof(double));
+    double *frameTimes = (double*)malloc(frames * sizeof(double));
+    const int sizes[] = { 100, lines };
+    const char *phases[] = { "parked", "scrolling", "typing" };
+    bool withinBudget = true;
+    for (int s = 0; s < 2; s++) {
+        int length;
+        char *doc = makeEditorScript(sizes[s], &length);
+        Modal modal;
+        initModal(&modal);
+        openModal(&modal);
+        double loadStart = benchSeconds();
+        setTextContent(&modal.command, doc, length);
+        modal.commandLength = length;
+        fprintf(benchOut, "%d lines (%.1f MB), loaded in %.1f ms, %s font\n", sizes[s], length / (1024.0 * 1024.0),
+                (benchSeconds() - loadStart) * 1000.0, useFont ? "JetBrains Mono" : "default");
+
+        for (int phase = 0; phase < 3; phase++) {
+            char label[64];
+            snprintf(label, sizeof(label), "%7d %s", sizes[s], phases[phase]);
+            withinBudget = renderPhase(label, &modal, font, useFont, box, frames, phase, drawTimes, frameTimes) &&
+                           withinBudget;
+        }
+
+        clearUndoHistory(&modal);
+        freeTextBuffer(&modal.command);
+        freeTextLayout(&modal.layout);
+        free(doc);
+    }
+    fprintf(benchOut, "p99 frame %s the %.1f ms budget of 60 FPS\n", withinBudget ? "within" : "OVER",
+            FRAME_BUDGET * 1000.0);
+
+    if (useFont) {
+        UnloadFont(font);
+    }
+    CloseWindow();
+    free(drawTimes);
+    free(frameTimes);
+    return withinBudget ? 0 : 1;
+}
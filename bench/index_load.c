@@ -0,0 +1,71 @@
+// Load a folder of 100k scripts into the script index.
+//
+//   npm run build:bench && ./bench/bin/index_load [scripts]
+//
+// Creates the scripts once, then times loadFiles (listing, header parsing and interning) a few
+// times over and reports how much memory the index holds per script: the FileItem array, the
+// interned strings, the name lookup and the folder's sort orders.
+#define main kort_main
+#include "../src/main.c"
+#undef main
+#include "bench.h"
+
+#define DEFAULT_SCRIPTS 100000
+#define LOAD_ROUNDS 5
+
+int main(int argc, char **argv) {
+    int scripts = argc > 1 ? atoi(argv[1]) : DEFAULT_SCRIPTS;
+    if (scripts <= 0) {
+        fprintf(stderr, "usage: %s [scripts]\n", argv[0]);
+        return 2;
+    }
+    startBenchReport();
+
+    char dir[256];
+    char path[PATH_MAX];
+    if (!makeBenchDir(dir, sizeof(dir))) {
+        return 1;
+    }
+
+    // Every tenth script carries header comments, like a shared folder with a few tuned ones
+    double startTime = benchSeconds();
+    for (int i = 0; i < scripts; i++) {
+        char content[128];
+        int length = i % 10 == 0 ? snprintf(content, sizeof(content), "# kort:timeout=30\n# kort:after=deploy-%d\necho %d\n", i / 2, i) :
+                                   snprintf(content, sizeof(content), "echo %d\n", i);
+        snprintf(path, sizeof(path), "%s/deploy-%d.sh", dir, i);
+        if (!writeBenchFile(path, content, length)) {
+            removeBenchDir(dir);
+            return 1;
+        }
+    }
+    fprintf(benchOut, "created %d scripts in %.2f s\n", scripts, benchSeconds() - startTime);
+
+    ScriptIndex index = {0};
+    double *samples = (double*)malloc(LOAD_ROUNDS * sizeof(double));
+    int count = 0;
+    for (int round = 0; round < LOAD_ROUNDS; round++) {
+        startTime = benchSeconds();
+        count = loadFiles(&index, dir);
+        samples[round] = benchSeconds() - startTime;
+    }
+    printLatencies("loadFiles", samples, LOAD_ROUNDS);
+
+    const ScriptFolder *root = &index.folders[0];
+    size_t fileBytes = (size_t)index.capacity * sizeof(FileItem);
+    size_t lookupBytes = index.lookupCapacity * sizeof(int);
+    size_t folderBytes = (size_t)root->fileCapacity * sizeof(int) * (1 + SORT_MODE_COUNT);
+    size_t runBytes = (size_t)index.runInfoCapacity * sizeof(ScriptRunInfo);
+    size_t totalBytes = fileBytes + index.strings.bytes + lookupBytes + folderBytes + runBytes;
+    int perScript = count > 0 ? count : 1;
+    fprintf(benchOut, "indexed %d of %d scripts, %.2f us per script\n", count, scripts,
+            samples[LOAD_ROUNDS / 2] / perScript * 1e6);
+    fprintf(benchOut, "memory %.1f MB, %zu bytes per script: files %zu (FileItem is %zu), strings %zu, lookup %zu, orders %zu, run state %zu\n",
+            totalBytes / 1e6, totalBytes / perScript, fileBytes / perScript, sizeof(FileItem),
+            index.strings.bytes / perScript, lookupBytes / perScript, folderBytes / perScript, runBytes / perScript);
+
+    freeScriptIndex(&index);
+    free(samples);
+    removeBenchDir(dir);
+    return count == scripts ? 0 : 1;
+}
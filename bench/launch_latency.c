@@ -0,0 +1,113 @@
+// Launch latency of 1 KB, 64 KB and 10 MB scripts.
+//
+//   npm run build:bench && ./bench/bin/launch_latency [launches per size]
+//
+// "in place" is kort's launch path: executeFileContent hands the script's own path to bash, so
+// the cost does not depend on the script's size. "copy" replays the old path for comparison: read
+// the whole script, write it back out with a wrapper header into a temp file, then run that.
+// Every script exits on its first line, so spawn-to-exit measures launching and not the script,
+// except that bash's "." reads a sourced file whole before running it, which shows at 10 MB.
+#define main kort_main
+#include "../src/main.c"
+#undef main
+#include "bench.h"
+
+#define DEFAULT_LAUNCHES 50
+
+// The old launch path: read the script, rewrite it with a header into a temp file, run the copy
+ProcessId launchCopy(const char *filePath, const char *copyPath) {
+    FILE *source = fopen(filePath, "rb");
+    if (source == NULL) {
+        return 0;
+    }
+    fseek(source, 0, SEEK_END);
+    long size = ftell(source);
+    fseek(source, 0, SEEK_SET);
+    char *content = (char*)malloc(size + 1);
+    size_t got = content != NULL ? fread(content, 1, size, source) : 0;
+    fclose(source);
+
+    FILE *copy = fopen(copyPath, "wb");
+    if (copy == NULL) {
+        free(content);
+        return 0;
+    }
+    fputs("#!/bin/bash\n", copy);
+    fwrite(content, 1, got, copy);
+    fputs("\nexit $?\n", copy);
+    fclose(copy);
+    free(content);
+
+    char *argv[] = { "/bin/bash", (char*)copyPath, NULL };
+    return spawnProcess(argv, -1);
+}
+
+int main(int argc, char **argv) {
+    int launches = argc > 1 ? atoi(argv[1]) : DEFAULT_LAUNCHES;
+    if (launches <= 0) {
+        fprintf(stderr, "usage: %s [launches per size]\n", argv[0]);
+        return 2;
+    }
+    startBenchReport();
+
+    char dir[256];
+    if (!makeBenchDir(dir, sizeof(dir))) {
+        return 1;
+    }
+
+    const size_t sizes[] = { 1024, 64 * 1024, 10 * 1024 * 1024 };
+    const char *labels[] = { "1 KB", "64 KB", "10 MB" };
+    double *spawnTimes = (double*)malloc(launches * sizeof(double));
+    double *exitTimes = (double*)malloc(launches * sizeof(double));
+    char *content = (char*)malloc(sizes[2]);
+    char filePath[PATH_MAX];
+    char copyPath[PATH_MAX];
+    char label[64];
+    int failures = 0;
+
+    for (int s = 0; s < 3; s++) {
+        // "exit 0" first, then comment lines up to the size
+        size_t length = (size_t)snprintf(content, sizes[s], "exit 0\n");
+        for (; length < sizes[s]; length++) {
+            content[length] = length % 64 == 63 || length == sizes[s] - 1 ? '\n' : '#';
+        }
+        snprintf(filePath, sizeof(filePath), "%s/script-%d.sh", dir, s);
+        snprintf(copyPath, sizeof(copyPath), "%s/copy.sh", dir);
+        if (!writeBenchFile(filePath, content, length)) {
+            failures++;
+            break;
+        }
+
+        for (int copied = 0; copied < 2; copied++) {
+            int samples = 0;
+            for (int i = 0; i < launches; i++) {
+                void *processHandle;
+                void *jobHandle;
+                RunResult result;
+                double startTime = benchSeconds();
+                ProcessId pid = copied ? launchCopy(filePath, copyPath) :
+                                         executeFileContent(filePath, RUN_MODE_INLINE, &processHandle, &jobHandle, NULL);
+                double spawnTime = benchSeconds();
+                if (pid == 0 || !collectProcessResult(pid, NULL, true, &result) || result.exitCode != 0) {
+                    failures++;
+                    continue;
+                }
+                spawnTimes[samples] = spawnTime - startTime;
+                exitTimes[samples++] = benchSeconds() - startTime;
+            }
+            snprintf(label, sizeof(label), "%-5s %-8s spawn", labels[s], copied ? "copy" : "in place");
+            printLatencies(label, spawnTimes, samples);
+            snprintf(label, sizeof(label), "%-5s %-8s to exit", labels[s], copied ? "copy" : "in place");
+            printLatencies(label, exitTimes, samples);
+        }
+    }
+    if (failures > 0) {
+        fprintf(benchOut, "%d launches failed\n", failures);
+    }
+
+    free(content);
+    free(spawnTimes);
+    free(exitTimes);
+    removeBenchDir(dir);
+    return failures == 0 ? 0 : 1;
+}
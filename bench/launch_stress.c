@@ -0,0 +1,128 @@
+// Launch stress test: fires hundreds of script launches back to back, as many at once as there are
+// run slots, and checks that every child ran its own script and nobody else's.
+//
+//   npm run build:bench && ./bench/bin/launch_stress [launches]
+//
+// Each script writes the number baked into its content and the name of the file it was started
+// from, so a launch that picked up another run's content (the old shared /tmp/kort_exec.sh race)
+// shows up as a mismatch or a missing result.
+#define main kort_main
+#include "../src/main.c"
+#undef main
+#include "bench.h"
+
+#define DEFAULT_LAUNCHES 500
+
+int main(int argc, char **argv) {
+    int launches = argc > 1 ? atoi(argv[1]) : DEFAULT_LAUNCHES;
+    if (launches <= 0) {
+        fprintf(stderr, "usage: %s [launches]\n", argv[0]);
+        return 2;
+    }
+    startBenchReport();
+
+    char dir[256];
+    char scriptDir[PATH_MAX];
+    char resultDir[PATH_MAX];
+    if (!makeBenchDir(dir, sizeof(dir))) {
+        return 1;
+    }
+    snprintf(scriptDir, sizeof(scriptDir), "%s/scripts", dir);
+    snprintf(resultDir, sizeof(resultDir), "%s/results", dir);
+    mkdir(scriptDir, 0700);
+    mkdir(resultDir, 0700);
+
+    // Padding gives every script a different size, like a real folder of mixed scripts
+    char path[PATH_MAX + 32];
+    char content[PATH_MAX + 256];
+    for (int i = 0; i < launches; i++) {
+        int length = snprintf(content, sizeof(content) - 128, "echo \"%d ${BASH_SOURCE[0]##*/}\" > '%s/%d'\n",
+                              i, resultDir, i);
+        for (int pad = 0; pad < i % 97; pad++) {
+            content[length++] = '#';
+        }
+        content[length++] = '\n';
+        snprintf(path, sizeof(path), "%s/%d.sh", scriptDir, i);
+        if (!writeBenchFile(path, content, length)) {
+            removeBenchDir(dir);
+            return 1;
+        }
+    }
+
+    ScriptIndex index = {0};
+    RunManager manager;
+    initRunManager(&manager);
+    int count = loadFiles(&index, scriptDir);
+    if (count != launches) {
+        fprintf(benchOut, "indexed %d of %d scripts\n", count, launches);
+        removeBenchDir(dir);
+        return 1;
+    }
+
+    double *spawnTimes = (double*)malloc(launches * sizeof(double));
+    int started = 0;
+    int failed = 0;
+    double startTime = benchSeconds();
+    for (int i = 0; i < count; i++) {
+        // Only wait for a reap once every slot is taken, the rest launch in the same "frame"
+        while (allocateRunSlot(&manager) < 0) {
+            pollScriptRuns(&manager, &index);
+            usleep(200);
+        }
+        double launchTime = benchSeconds();
+        if (startScriptRun(&manager, &index, i, RUN_MODE_INLINE) < 0) {
+            failed++;
+            continue;
+        }
+        spawnTimes[started++] = benchSeconds() - launchTime;
+    }
+    for (bool busy = true; busy; ) {
+        pollScriptRuns(&manager, &index);
+        busy = false;
+        for (int i = 0; i < MAX_RUNS; i++) {
+            busy = busy || manager.runs[i].active;
+        }
+        if (busy) usleep(200);
+    }
+    double elapsed = benchSeconds() - startTime;
+
+    // Entries are in directory order, the script's number is its display name
+    int wrong = 0;
+    int missing = 0;
+    int exitFailures = 0;
+    for (int i = 0; i < count; i++) {
+        const FileItem *file = &index.files[i];
+        const ScriptRunInfo *info = peekRunInfo(&index, file);
+        int number = atoi(file->displayName);
+        if (!info->hasResult || info->lastResult.exitCode != 0) {
+            exitFailures++;
+        }
+
+        snprintf(path, sizeof(path), "%s/%d", resultDir, number);
+        FILE *result = fopen(path, "r");
+        int seenNumber = -1;
+        char seenFile[256] = "";
+        if (result == NULL) {
+            missing++;
+            continue;
+        }
+        if (fscanf(result, "%d %255s", &seenNumber, seenFile) != 2 || seenNumber != number ||
+            strcmp(seenFile, file->fileName) != 0) {
+            fprintf(benchOut, "%s ran script %d's content\n", file->fileName, seenNumber);
+            wrong++;
+        }
+        fclose(result);
+    }
+
+    fprintf(benchOut, "%d launches in %.2f s (%.0f per second), %d run slots\n",
+            started, elapsed, started / elapsed, MAX_RUNS);
+    printLatencies("spawn", spawnTimes, started);
+    fprintf(benchOut, "failed to start %d, nonzero exit %d, no result %d, wrong content %d\n",
+            failed, exitFailures, missing, wrong);
+
+    shutdownRunManager(&manager);
+    freeScriptIndex(&index);
+    free(spawnTimes);
+    removeBenchDir(dir);
+    return failed == 0 && exitFailures == 0 && missing == 0 && wrong == 0 ? 0 : 1;
+}
@@ -0,0 +1,111 @@
+// Cold and warm launch latency of the "no terminal" run modes.
+//
+//   npm run build:bench && KORT_WARM_SHELLS=4 ./bench/bin/warm_launch [launches]
+//
+// Cold is RUN_MODE_CAPTURE (a fresh bash per launch), warm is RUN_MODE_WARM handing the script to
+// a pre-started shell. Each launch is timed from executeFileContent until the script has exited,
+// its output captured like the console panel does. "refilled" waits for the pool to be back at
+// its size between launches, "back to back" does not, so it shows what happens once the pool
+// runs dry. KORT_WARM_SHELLS sets the pool size as it does for kort itself.
+#define main kort_main
+#include "../src/main.c"
+#undef main
+#include "bench.h"
+
+#define DEFAULT_LAUNCHES 200
+
+// Block until the refill thread has the pool back at its target, false after a second
+bool waitForWarmPool(void) {
+    for (int i = 0; i < 1000; i++) {
+        lockMutex(&warmShells.lock);
+        bool full = warmShells.count >= warmShells.target;
+        unlockMutex(&warmShells.lock);
+        if (full) {
+            return true;
+        }
+        usleep(1000);
+    }
+    return false;
+}
+
+// Launch the script once and wait for it, returns the seconds it took or -1 on failure
+double timeLaunch(const char *filePath, RunMode mode) {
+    OutputCapture *capture = createOutputCapture("warm_launch");
+    if (capture == NULL) {
+        return -1;
+    }
+    void *processHandle;
+    void *jobHandle;
+    RunResult result;
+    double startTime = benchSeconds();
+    ProcessId pid = executeFileContent(filePath, mode, &processHandle, &jobHandle, capture);
+    bool ok = pid != 0 && collectProcessResult(pid, NULL, true, &result) && result.exitCode == 0;
+    double elapsed = benchSeconds() - startTime;
+    if (capture->readerStarted) {
+        joinThread(capture->reader);
+    }
+    destroyOutputCapture(capture);
+    return ok ? elapsed : -1;
+}
+
+int main(int argc, char **argv) {
+    int launches = argc > 1 ? atoi(argv[1]) : DEFAULT_LAUNCHES;
+    if (launches <= 0) {
+        fprintf(stderr, "usage: %s [launches]\n", argv[0]);
+        return 2;
+    }
+    startBenchReport();
+
+    char dir[256];
+    char filePath[PATH_MAX];
+    if (!makeBenchDir(dir, sizeof(dir))) {
+        return 1;
+    }
+    snprintf(filePath, sizeof(filePath), "%s/hello.sh", dir);
+    if (!writeBenchFile(filePath, "echo hello\n", 11)) {
+        removeBenchDir(dir);
+        return 1;
+    }
+
+    initWarmShells();
+    if (!warmShells.started || !waitForWarmPool()) {
+        fprintf(benchOut, "no warm shell pool (KORT_WARM_SHELLS=0 or bash failed to start)\n");
+        shutdownWarmShells();
+        removeBenchDir(dir);
+        return 1;
+    }
+    fprintf(benchOut, "%d warm shells\n", warmShells.target);
+
+    double *samples = (double*)malloc(launches * sizeof(double));
+    const char *labels[] = { "cold", "warm, refilled", "warm, back to back" };
+    int failures = 0;
+    for (int phase = 0; phase < 3; phase++) {
+        uint64_t warmBefore = warmShells.warmLaunches;
+        int count = 0;
+        for (int i = 0; i < launches; i++) {
+            if (phase == 1) {
+                waitForWarmPool();
+            }
+            double elapsed = timeLaunch(filePath, phase == 0 ? RUN_MODE_CAPTURE : RUN_MODE_WARM);
+            if (elapsed < 0) {
+                failures++;
+                continue;
+            }
+            samples[count++] = elapsed;
+        }
+        printLatencies(labels[phase], samples, count);
+        if (phase > 0) {
+            fprintf(benchOut, "%-28s %llu of %d launches found a warm shell\n", "",
+                    (unsigned long long)(warmShells.warmLaunches - warmBefore), launches);
+        }
+        waitForWarmPool();
+    }
+    if (failures > 0) {
+        fprintf(benchOut, "%d launches failed\n", failures);
+    }
+
+    shutdownWarmShells();
+    free(samples);
+    removeBenchDir(dir);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,20 @@
+const { execSync } = require("child_process");
+const fs = require("fs");
+const os = require("os");
+const path = require("path");
+// Every driver in ./bench includes ./src/main.c itself, so each one is a single gcc call
+let flags = "";
+if (os.platform() === "linux") {
+  flags = "-O3 -Wall -I./src/include -L./src/lib -lraylib -lGL -lm -ldl -lpthread";
+} else {
+  console.log("The benchmarks drive the Linux process, socket and watcher code and only build on Linux.");
+  process.exit(1);
+}
+fs.mkdirSync("./bench/bin", { recursive: true });
+const drivers = fs.readdirSync("./bench").filter((file) => file.endsWith(".c"));
+for (const driver of drivers) {
+  const gccCommand = `gcc ./bench/${driver} ${flags} -o ./bench/bin/${path.basename(driver, ".c")}`;
+  console.log(gccCommand);
+  execSync(gccCommand, { stdio: "inherit" });
+}
+console.log(`Built ${drivers.length} benchmarks into ./bench/bin`);
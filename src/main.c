@@ -1,7 +1,18 @@
+#ifndef _WIN32
+    #define _GNU_SOURCE     // pipe2, accept4, struct ucred
+#endif
 #include <stdio.h>
 #include <string.h>
 #include <dirent.h>
 #include <stdlib.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <limits.h>
+#if defined(__SSE2__)
+    #include <emmintrin.h>
+#endif
 
 // Platform detection
 #ifdef _WIN32
@@ -10,6 +21,8 @@
     #define NOGDI
     #define NOUSER
     #include <windows.h>
+    #include <psapi.h>
+    #include <sys/stat.h>
     #undef NOGDI
     #undef NOUSER
 
@@ -25,8 +38,20 @@
 #else
     #define PLATFORM_LINUX
     #include <unistd.h>
+    #include <fcntl.h>
+    #include <spawn.h>
+    #include <poll.h>
+    #include <signal.h>
+    #include <pthread.h>
     #include <sys/stat.h>
     #include <sys/types.h>
+    #include <sys/wait.h>
+    #include <sys/resource.h>
+    #include <sys/mman.h>
+    #include <sys/socket.h>
+    #include <sys/un.h>
+    #include <sys/inotify.h>
+    extern char **environ;
 #endif
 
 #include "raylib.h"
@@ -35,45 +60,745 @@
 #define screenWidth 1000
 #define screenHeight 650
 #define intialFPS 60
-#define MAX_FILES 256
 #define fontSize 18
-#define MAX_SCRIPT_SIZE 65536
 #define MAX_FILENAME_CHARS 50
-#define MAX_COMMAND_CHARS 2000
-#define MAX_UNDO_STACK 50
+#define EDITOR_LAYOUT_SLOTS 64              // Measured editor lines kept, indexed by line number
+#define MAX_RUNS 64
+#define CAPTURE_RING_SIZE (1 << 20)         // Pipe bytes buffered between reader thread and UI
+#define CONSOLE_TEXT_SIZE (1 << 20)         // Scrollback bytes kept per captured run
+#define CONSOLE_MAX_LINES (1 << 16)         // Scrollback lines kept per captured run
+#define CONSOLE_PANEL_HEIGHT 220
+#define MAX_POOL_WORKERS 32
+#define DEFAULT_POOL_WORKERS 4
+#define RUN_EVENT_QUEUE_SIZE 1024           // Power of two
+#define METADATA_SCAN_LINES 32              // Header lines searched for kort: comments
+#define CONSOLE_LINE_HEIGHT 18
+#define CONSOLE_FONT_SIZE 16
+#define HISTORY_FILE_NAME "kort-history.bin"
+#define HISTORY_MAGIC 0x4854524Bu           // "KRTH"
+#define HISTORY_VERSION 1
+#define HISTORY_BUCKETS 128                 // Log buckets, 4 per power of two of milliseconds
+#define HISTORY_CHANGED_KEYS 16             // Scripts of the latest runs, for whoever keeps keys derived from the table
+#define CANCEL_GRACE_SECONDS 3.0            // SIGTERM to SIGKILL delay when cancelling a run
+#define DAEMON_MAX_CLIENTS 64
+#define DAEMON_MAX_RUNS 1024
+#define DAEMON_MAX_PAYLOAD 65535
+#define MAX_WARM_SHELLS 16
+#define DEFAULT_WARM_SHELLS 2
+#define WATCH_FOLDER_REQUESTS 16           // Folder listings queued for the scan thread
+#define SEARCH_MAX_QUERY 63
+#define SEARCH_MAX_RESULTS 500
+#define SEARCH_BODY_BYTES (256 * 1024)      // Bytes of a script read for the content trigrams
+#define SEARCH_NAME_WEIGHT 4                // A query trigram found in the path counts as this many body hits
+#define SEARCH_PATH_TRIGRAM 0x80000000u
+#define SEARCH_MERGE_BUDGET 25000           // Postings merged per frame while the indexer catches up
+#define SEARCH_TREE_DOC UINT32_MAX          // Job or result of the tree walk, its document is made when it is merged
+#define SEARCH_TREE_BACKLOG 4096            // Jobs and unmerged results the tree walk lets pile up before it waits
+#define GREP_MAX_THREADS 8
+#define GREP_MAX_MATCHES 10000              // Matching lines kept per grep, the rest are only counted
+#define GREP_PREVIEW_CHARS 160
+#define GREP_CHUNK_BYTES (256 * 1024)       // Files are read this much at a time, a longer line grows the buffer
+#define STRING_ARENA_BLOCK_SIZE (64 * 1024) // Index strings are bump allocated in blocks this big
+#define INDEX_CACHE_FILE_NAME "kort-index.bin"
+#define INDEX_CACHE_MAGIC 0x4954524Bu       // "KRTI"
+#define INDEX_CACHE_VERSION 2
+#define INDEX_CACHE_DIRECTORY 1u          // IndexCacheEntry flag for a subfolder
+#define WATCH_REMOVED_SLOTS 16              // Removed entries remembered so delete+create keeps selection and result
+
+#ifdef PLATFORM_WINDOWS
+typedef unsigned long ProcessId;
+typedef HANDLE ThreadHandle;
+typedef CRITICAL_SECTION Mutex;
+typedef CONDITION_VARIABLE CondVar;
+#else
+typedef pid_t ProcessId;
+typedef pthread_t ThreadHandle;
+typedef pthread_mutex_t Mutex;
+typedef pthread_cond_t CondVar;
+#endif
 
+typedef enum {
+    RUN_STATE_IDLE,
+    RUN_STATE_QUEUED,       // Waiting for a pool worker
+    RUN_STATE_RUNNING,
+    RUN_STATE_STOPPING,     // Cancelled, waiting for the process tree to exit
+    RUN_STATE_SUCCEEDED,    // Last run exited with status 0
+    RUN_STATE_FAILED,       // Last run exited non-zero or was killed
+} RunState;
+
+typedef enum {
+    RUN_MODE_TERMINAL,      // External terminal window (default)
+    RUN_MODE_CAPTURE,       // No window, output shown in the console panel
+    RUN_MODE_INLINE,        // Shares kort's own terminal, used by the command line
+    RUN_MODE_WARM,          // Like capture, but handed to an already running shell when one is idle
+} RunMode;
+
+// Lock-free single-producer/single-consumer byte ring. Offsets only ever grow,
+// so head - tail is the fill level; the producer drops (and counts) what doesn't fit
 typedef struct {
-    char displayName[256];
-    char filePath[512];
-    char fileExtension[16];
-    Rectangle bounds;
-    Rectangle editBounds;
-    Rectangle deleteBounds;
-    bool isExecuting;
+    char *data;
+    size_t capacity;            // Power of two
+    _Atomic size_t head;        // Written by the reader thread
+    _Atomic size_t tail;        // Written by the UI thread
+    _Atomic size_t dropped;
+} ByteRing;
+
+// Bounded scrollback owned by the UI thread, lines addressed by absolute number
+typedef struct {
+    char *text;                 // CONSOLE_TEXT_SIZE ring, indexed by offset & mask
+    uint64_t start;             // Oldest byte still kept
+    uint64_t end;               // One past the newest byte
+    uint64_t *lineStarts;       // CONSOLE_MAX_LINES ring of line start offsets
+    uint64_t firstLine;         // Absolute number of the oldest kept line
+    uint64_t lineCount;         // Lines kept, the last one may still be open
+    float scrollOffset;         // Pixels from the top of the kept lines
+    bool followTail;
+} ConsoleBuffer;
+
+// Output of one captured run: pipe -> reader thread -> ring -> console
+typedef struct {
+    ByteRing ring;
+    ConsoleBuffer console;
+    ThreadHandle reader;
+    bool readerStarted;
+#ifdef PLATFORM_WINDOWS
+    HANDLE readHandle;
+#else
+    int readFd;
+#endif
+    _Atomic bool readerDone;
+    bool processExited;
+    char title[256];
+} OutputCapture;
+
+// Exit status and resource usage of a finished child
+typedef struct {
+    int exitCode;           // 128 + signal when killed, -1 when unknown
+    double wallSeconds;
+    double cpuSeconds;      // User + system time, including descendants it waited for
+    long maxRssKb;
+    bool cancelled;         // Stopped from the UI or by its timeout
+    bool timedOut;
+} RunResult;
+
+// Run state of one index entry, kept in ScriptIndex.runInfo so only scripts that ran (or that the
+// run history knows) pay for it. All zero is a script that never ran
+typedef struct {
+    ProcessId pid;      // Most recent child launched from this entry (0 when none)
+    RunState runState;
+    int activeRuns;     // Runs started from this entry that are still alive
+    int queuedRuns;     // Batch jobs for this entry waiting for a worker
+    int stoppingRuns;   // Active runs that have been cancelled
+    bool hasResult;
+    RunResult lastResult;   // Most recent finished run, drives SUCCEEDED/FAILED
+    int64_t lastRunTime;    // Sort keys from the run history: Unix seconds of the last run, 0 when never run
+    uint32_t runCount;
+    uint32_t averageMs;
+    int nextFree;           // Next released entry + 1 while on the free list
+} ScriptRunInfo;
+
+// Strings point into the owning ScriptIndex's arena and live until the index is rebuilt
+typedef struct {
+    const char *displayName;    // Base name up to the first dot
+    const char *fileName;       // Relative path, the file's path is the index's scriptDir + "/" + fileName
+    const char *fileExtension;  // Points into fileName, "" when there is none
+    const char *dependsOn;  // Comma separated script names from "kort:after=" headers, "" for none
+    uint64_t historyKey;    // Hash of the file name, looks up the run history
+    double timeoutSeconds;  // From a "kort:timeout=" header, 0 for none
+    int64_t modifiedTime;   // Nanoseconds since the epoch when the header was parsed
+    int64_t fileSize;
+    int folder;             // ScriptIndex.folders entry the file is listed in
+    uint32_t searchDoc;     // Current SearchIndex document of the file
+    uint64_t nameKey;       // First 8 bytes of displayName lowercased, big-endian, decides most name comparisons
+    int runInfo;            // ScriptIndex.runInfo entry, -1 until the script first has run state
+    bool isSelected;
 } FileItem;
 
+// Header comments of a script, parsed before its entry exists
+typedef struct {
+    char dependsOn[256];
+    double timeoutSeconds;
+    int64_t modifiedTime;       // Of the file that was parsed, tells a later scan whether to parse again
+    int64_t fileSize;
+    bool isDirectory;           // A subfolder, nothing else is set
+} ScriptMetadata;
+
+// Orders the list can be shown in, each kept as a permutation of every folder's files
+typedef enum {
+    SORT_BY_NAME,
+    SORT_BY_MODIFIED,       // Newest first
+    SORT_BY_LAST_RUN,       // Most recent first, never run last
+    SORT_BY_RUN_COUNT,      // Most runs first
+    SORT_BY_AVERAGE_TIME,   // Slowest first, never run last
+    SORT_MODE_COUNT
+} SortMode;
+
+// A directory of the index, folders[0] is the scripts directory itself.
+// A folder's contents are only listed (and watched) once it is first expanded
+typedef struct {
+    const char *path;       // Relative to the scripts directory, "" for the root
+    const char *name;       // Last component of path
+    int parent;             // -1 for the root
+    int depth;              // Indentation of its row, -1 for the root which has none
+    bool expanded;          // Always true for the root
+    bool loaded;            // Contents listed, changes inside it are applied
+    bool removed;           // Deleted on disk, ids are never reused
+    int *children;          // Subfolder ids, listed before the files
+    int childCount;
+    int childCapacity;
+    int *files;             // Indices into ScriptIndex.files, in the order they were listed
+    int fileCount;
+    int fileCapacity;       // Also of each order
+    int *orders[SORT_MODE_COUNT];       // files permuted into each sort order
+    int sortedCounts[SORT_MODE_COUNT];  // Leading entries of each order in place, the rest were added since
+    int contentRows;        // List rows its contents take when expanded: files plus each subfolder's rows
+} ScriptFolder;
+
+// One line of the script list, resolved from a row number by getScriptRow
+typedef struct {
+    int folder;             // The folder itself when file is -1, else the one holding the file
+    int file;
+    int depth;
+} ScriptRow;
+
+typedef struct ArenaBlock {
+    struct ArenaBlock *next;
+    size_t used;
+    size_t capacity;
+    char data[];
+} ArenaBlock;
+
+// Bump allocator for index strings, freed all at once
+typedef struct {
+    ArenaBlock *head;
+    size_t bytes;
+} StringArena;
+
+// Documents containing one trigram, each entry is doc << 1 with the low bit set when it was in the path
+typedef struct {
+    uint32_t key;           // Trigram + 1, 0 marks a free slot
+    uint32_t count;
+    uint32_t capacity;
+    uint32_t *entries;
+} SearchPosting;
+
+// One indexed version of a script. Ids are never reused, a rewrite retires the document and adds a new one
+typedef struct {
+    uint64_t fileKey;       // historyKey of the script
+    char *treeName;         // Relative path of a script only the tree walk found, NULL for listed ones
+    bool live;
+} SearchDoc;
+
+// A script for the indexer thread to read, and the trigrams it found in its path and body
+typedef struct {
+    uint32_t doc;           // SEARCH_TREE_DOC for scripts found by the tree walk
+    char *fileName;         // Relative to scriptDir, owned by the job
+} SearchBodyJob;
+
+typedef struct {
+    uint32_t doc;
+    uint32_t *trigrams;     // Unique, SEARCH_PATH_TRIGRAM set on those from the path
+    int count;
+    int merged;             // Trigrams already added, a result can be merged over several frames
+    char *fileName;         // Tree walk results only, handed over to the document
+} SearchBodyResult;
+
+typedef struct {
+    uint64_t fileKey;
+    uint32_t score;
+} SearchResult;
+
+// Trigram index over script paths and bodies. Both are read by a background thread and merged a
+// bounded amount per frame, so listing 100k scripts costs the UI thread next to nothing. Listed scripts
+// are added as they are listed; the scan thread queues the rest of the tree, so folders that were never
+// expanded are searchable too. Everything but the job and result queues belongs to the UI thread
+typedef struct {
+    SearchPosting *postings;    // Open addressing on the trigram
+    size_t postingCapacity;     // Power of two
+    size_t postingCount;
+    size_t entryCount;
+    SearchDoc *docs;
+    uint32_t docCount;
+    uint32_t docCapacity;
+    uint32_t liveDocs;
+    uint32_t deadDocs;          // Still in the postings, dropped in bulk once they outnumber the live ones
+    uint64_t generation;        // Moves on every change, so shown results know to refresh
+    uint32_t *scores;           // Query scratch, docCapacity each, zero between queries
+    uint32_t *touched;
+    uint32_t *docLookup;        // Open addressing on fileKey, holds the newest document + 1 (0 is free)
+    size_t docLookupCapacity;   // Power of two, at least twice docLookupCount
+    size_t docLookupCount;
+
+    char scriptDir[512];
+    ThreadHandle thread;
+    bool threadStarted;
+    _Atomic bool stopping;
+    Mutex lock;
+    CondVar wake;
+    SearchBodyJob *jobs;        // Under lock, taken from the end
+    int jobCount;
+    int jobCapacity;
+    SearchBodyResult *results;  // Under lock
+    int resultCount;
+    int resultCapacity;
+    SearchBodyResult *merging;  // UI thread, taken from results as a whole
+    int mergingCount;
+    int mergingNext;
+} SearchIndex;
+
+// One line containing the grep pattern
+typedef struct {
+    const char *fileName;   // Relative to scriptDir, in ContentGrep.names
+    int line;               // 1-based
+    int column;             // Byte offset of the match in the line
+    char preview[GREP_PREVIEW_CHARS + 1];
+} GrepMatch;
+
+// Literal content search over every file under the scripts directory, listed or not. The worker
+// threads share one queue of paths: a folder expands into its entries, a file is read and scanned in chunks.
+// Matches reach the UI thread in per-file batches while the grep is still running
+typedef struct {
+    char scriptDir[512];
+    ThreadHandle threads[GREP_MAX_THREADS];
+    int threadCount;
+    _Atomic bool stopping;
+    _Atomic uint32_t generation;    // Moves on every new grep, work of older ones is dropped
+    Mutex lock;
+    CondVar wake;
+    char pattern[SEARCH_MAX_QUERY + 1];     // Under lock, of the current generation
+    size_t patternLength;
+    char **paths;           // Under lock, relative paths still to visit, folders end in '/' ("" is the root)
+    int pathCount;
+    int pathCapacity;
+    int busy;               // Under lock, workers inside a path
+    GrepMatch *found;       // Under lock, not yet taken by pollContentGrep
+    int foundCount;
+    int foundCapacity;
+    StringArena names;      // Under lock, file names of the current grep's matches
+    int keptTotal;          // Under lock, matches handed out by the current grep
+    int matchTotal;         // Under lock, including the ones over GREP_MAX_MATCHES
+    int matchedFiles;
+    int filesScanned;
+    uint64_t bytesScanned;
+
+    // UI thread
+    GrepMatch *matches;
+    int matchCount;
+    int matchCapacity;
+    bool active;
+    double startTime;
+    double elapsedMs;
+} ContentGrep;
+
+// Growable list of the scripts in one directory
+typedef struct {
+    FileItem *files;
+    int count;
+    int capacity;
+    const char *scriptDir;
+    StringArena strings;
+    int *lookup;                // Open addressing on historyKey, holds file index + 1 (0 is free)
+    size_t lookupCapacity;      // Power of two, at least twice count
+    ScriptRunInfo *runInfo;     // Run state of the entries that have any, see FileItem.runInfo
+    int runInfoCount;
+    int runInfoCapacity;
+    int freeRunInfo;            // First released runInfo entry + 1, 0 when none
+    ScriptFolder *folders;
+    int folderCount;
+    int folderCapacity;
+    int lastFolder;             // Last findScriptFolder hit, changes tend to arrive folder by folder
+    SearchIndex *search;        // Kept in step with every added and removed file when set
+    struct RunHistory *history; // Sort keys of new files come from it when set
+    uint64_t historyGeneration; // Of the history the sort keys were last read from
+    SortMode sortMode;
+    unsigned dirtyOrders;       // Bit per SortMode, set while some folder has entries of that order out of place
+} ScriptIndex;
+
+// Start of the index cache file, followed by entryCount entries and then stringBytes of strings
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entrySize;
+    uint32_t entryCount;
+    int64_t dirModifiedTime;    // Of the scripts directory before the listing was read
+    uint32_t stringBytes;
+    uint32_t scriptDirOffset;   // The directory the listing belongs to
+} IndexCacheHeader;
+
+// One top-level script or subfolder as of the last scan, strings are offsets into the string blob
+typedef struct {
+    uint64_t nameKey;           // hashScriptName() of the file name
+    int64_t modifiedTime;
+    int64_t fileSize;
+    double timeoutSeconds;
+    uint32_t nameOffset;
+    uint32_t dependsOnOffset;
+    uint32_t flags;             // INDEX_CACHE_DIRECTORY
+    uint32_t reserved;
+} IndexCacheEntry;
+
+// Last session's index, mapped read-only. The UI lists it for the first frame,
+// then the scan thread uses it to skip files that did not change and unmaps it
+typedef struct {
+    char path[512];
+    const unsigned char *data;
+    size_t size;
+    const IndexCacheHeader *header;     // NULL when missing, of another format or another directory
+    const IndexCacheEntry *entries;
+    const char *strings;
+} IndexCache;
+
+// Start of the history file
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t recordSize;
+    uint32_t reserved;
+} HistoryHeader;
+
+// One finished run, appended to the history file as-is
+typedef struct {
+    uint64_t scriptKey;     // FNV-1a of the script's file name
+    int64_t timestamp;      // Unix seconds when the run finished
+    uint32_t durationMs;
+    int32_t exitCode;
+    uint32_t maxRssKb;
+    uint32_t reserved;
+} HistoryRecord;
+
+// Aggregate of every recorded run of one script, fixed size however long the history gets
+typedef struct {
+    uint64_t scriptKey;     // 0 marks a free slot
+    uint32_t runs;
+    uint32_t failures;
+    uint32_t buckets[HISTORY_BUCKETS];
+    uint32_t p50Ms;
+    uint32_t p95Ms;
+    uint32_t p99Ms;
+    bool percentilesDirty;
+    uint64_t totalMs;
+    int64_t lastRunTime;    // Unix seconds of the latest record
+} ScriptHistory;
+
+// Open addressing table of script aggregates keyed by scriptKey
+typedef struct {
+    ScriptHistory *entries;
+    size_t capacity;        // Power of two
+    size_t count;
+} HistoryTable;
+
+// Run history file plus the aggregates built from it. The loader thread maps the
+// file and builds loadedTable, the UI adopts it and keeps it current from then on
+typedef struct RunHistory {
+    char path[512];
+    HistoryTable table;         // UI thread only
+    HistoryTable loadedTable;   // Loader thread until loadDone
+    uint64_t loadedEnd;         // File offset the loader read up to
+    ThreadHandle loader;
+    bool loaderStarted;
+    _Atomic bool loadDone;
+    bool loaded;
+    uint64_t generation;        // Moves whenever table changes
+    uint64_t loadGeneration;    // Generation the table was adopted at, everything changed then
+    uint64_t changedKeys[HISTORY_CHANGED_KEYS];     // Script each later generation added a run to
+} RunHistory;
+
+// One launched script, tracked until the child exits
+typedef struct {
+    bool active;
+    ProcessId pid;
+    void *processHandle;        // Windows process HANDLE (NULL on Linux)
+    int fileIndex;
+    char filePath[512];
+    OutputCapture *capture;     // NULL unless launched in capture mode
+    RunMode mode;
+    bool ownedByPool;           // A pool or pipeline worker waits for this child, not the UI
+    int jobId;
+    double startTime;
+    void *jobHandle;            // Windows job holding the run's process tree (NULL on Linux)
+    double timeoutSeconds;      // 0 for none
+    bool cancelRequested;       // SIGTERM sent, SIGKILL follows after the grace period
+    bool killSent;
+    bool timedOut;
+    double cancelTime;
+} ScriptRun;
+
+typedef struct {
+    ScriptRun runs[MAX_RUNS];
+    OutputCapture *captures[MAX_RUNS];  // Live captures, may outlive their run
+    OutputCapture *shownCapture;        // Capture displayed in the console panel
+    RunHistory *history;                // Finished runs are appended here (may be NULL)
+    ProcessId lingeringGroups[MAX_RUNS];    // Cancelled runs whose leader exited before the rest of its group
+    double lingeringDeadlines[MAX_RUNS];    // When those groups get SIGKILL
+} RunManager;
+
+typedef enum {
+    RUN_EVENT_STARTED,
+    RUN_EVENT_FINISHED,
+} RunEventType;
+
+// Posted by pool workers, consumed by the UI thread
+typedef struct {
+    RunEventType type;
+    int jobId;
+    ProcessId pid;          // 0 in FINISHED when the launch failed
+    void *jobHandle;        // Set in STARTED, ownership passes to the UI
+    RunResult result;       // Set in FINISHED
+    OutputCapture *capture;
+    RunMode mode;
+    char filePath[512];
+} RunEvent;
+
+typedef struct {
+    _Atomic size_t sequence;
+    RunEvent event;
+} RunEventCell;
+
+// Bounded lock-free multi-producer queue (Vyukov), one cell per pending event
+typedef struct {
+    RunEventCell *cells;
+    size_t mask;
+    _Atomic size_t enqueuePos;
+    _Atomic size_t dequeuePos;
+} RunEventQueue;
+
+typedef struct {
+    int jobId;
+    char filePath[512];
+    RunMode mode;
+    OutputCapture *capture;
+} PoolJob;
+
+// Bounded worker pool: at most concurrencyCap jobs run at once, the rest wait in FIFO order.
+// Pipeline nodes count against the same running total
+typedef struct {
+    ThreadHandle threads[MAX_POOL_WORKERS];
+    int threadCount;
+    Mutex lock;
+    CondVar wake;
+    PoolJob *jobs;                  // Ring of queued jobs
+    int jobHead;
+    int jobCount;
+    int jobCapacity;
+    int running;
+    int concurrencyCap;
+    int nextJobId;
+    bool shuttingDown;
+    RunEventQueue events;
+} WorkerPool;
+
+// An idle shell waiting for one script path on commandFd, its output pipe already made
+typedef struct {
+    ProcessId pid;
+    int commandFd;
+    int outputFd;
+} WarmShell;
+
+// Pre-started shells for warm runs, topped up to target by a background thread
+typedef struct {
+    WarmShell shells[MAX_WARM_SHELLS];
+    int count;
+    int target;
+    Mutex lock;
+    CondVar wake;
+    ThreadHandle refiller;
+    bool started;
+    bool shuttingDown;
+    uint64_t warmLaunches;
+    uint64_t coldLaunches;
+} WarmShellPool;
+
+typedef enum {
+    NODE_PENDING,
+    NODE_RUNNING,
+    NODE_SUCCEEDED,
+    NODE_FAILED,
+    NODE_SKIPPED,           // A dependency failed
+} PipelineNodeState;
+
+typedef struct {
+    int jobId;
+    char filePath[512];
+    char displayName[64];
+    RunMode mode;
+    OutputCapture *capture;
+    int *dependencies;
+    int dependencyCount;
+    int *dependents;
+    int dependentCount;
+    _Atomic int remaining;          // Unfinished dependencies
+    _Atomic bool dependencyFailed;
+    _Atomic int state;              // PipelineNodeState
+    RunResult result;
+    double startTime;
+    double endTime;
+} PipelineNode;
+
+// Per-worker deque: the owner pushes and pops at the bottom, thieves take from the top
+typedef struct {
+    Mutex lock;
+    int *items;
+    int top;
+    int bottom;
+} WorkDeque;
+
+// Arguments of one pipeline worker thread
+typedef struct {
+    struct Pipeline *pipeline;
+    int workerIndex;
+} PipelineWorker;
+
+// One dependency-ordered run of scripts on a work-stealing set of workers
+typedef struct Pipeline {
+    bool active;
+    PipelineNode *nodes;
+    int nodeCount;
+    WorkDeque deques[MAX_POOL_WORKERS];
+    ThreadHandle threads[MAX_POOL_WORKERS];
+    _Atomic int workerCount;        // Workers that started, only ever lowered before any work is seeded
+    Mutex idleLock;
+    CondVar idleWake;
+    _Atomic int readyCount;
+    _Atomic int doneCount;
+    double startTime;
+    _Atomic bool finished;
+    WorkerPool *pool;               // Nodes take its run slots, so batches and pipelines share one cap
+    RunEventQueue *events;
+    int *topoOrder;
+    PipelineWorker workerArgs[MAX_POOL_WORKERS];
+} Pipeline;
+
+typedef enum {
+    SCRIPT_CHANGE_UPSERT,   // Created or rewritten, fileName plus its freshly parsed metadata
+    SCRIPT_CHANGE_REMOVE,   // Deleted or renamed away, only fileName is set
+    SCRIPT_CHANGE_RESCAN,   // Events were lost, reload the whole directory
+    SCRIPT_CHANGE_SCAN_DONE,    // The startup scan has posted every entry
+} ScriptChangeType;
+
+typedef struct {
+    ScriptChangeType type;
+    char fileName[PATH_MAX];    // Relative to the scripts directory
+    ScriptMetadata metadata;    // Upserts only
+} ScriptChange;
+
+// An inotify watch on a listed folder, events carry only the wd
+typedef struct {
+    int wd;
+    char path[PATH_MAX];        // Relative to the scripts directory, "" for the root
+} WatchedFolder;
+
+// What an entry keeps across a delete + create of the same file
+typedef struct {
+    char fileName[PATH_MAX];    // "" when the slot is free
+    bool isSelected;
+    bool hasResult;
+    RunResult lastResult;
+} RemovedScript;
+
+// Watches the scripts directory on a background thread, the UI thread applies the changes every frame.
+// The startup scan streams its entries through the same queue
+typedef struct {
+    char scriptDir[512];
+    ThreadHandle thread;
+    bool running;
+    ThreadHandle scanThread;
+    bool scanning;                  // Scan thread started and not yet joined
+    double scanStartTime;           // getMonotonicSeconds() the startup timings are measured from
+    IndexCache *cache;              // Owned by the scan thread until it posts SCAN_DONE
+    int64_t scanDirTime;            // Directory mtime the scan started from, 0 when unknown
+    bool scanChangedIndex;          // The scan posted changes, so the cache needs rewriting
+    CondVar scanWake;               // After startup the scan thread waits here for folders to list
+    SearchIndex *search;            // Fed the whole tree once the scan is done, NULL for none
+    char folderRequests[WATCH_FOLDER_REQUESTS][PATH_MAX];
+    int folderRequestCount;
+    _Atomic bool stopping;
+    Mutex lock;
+    ScriptChange *changes;          // Posted by the thread, taken as a whole by the UI
+    int changeCount;
+    int changeCapacity;
+    RemovedScript removed[WATCH_REMOVED_SLOTS];
+    int removedNext;
+#ifdef PLATFORM_WINDOWS
+    HANDLE dirHandle;
+#else
+    int inotifyFd;
+    int stopPipe[2];
+    WatchedFolder *watchedFolders;  // Root and every listed subfolder, under lock
+    int watchedCount;
+    int watchedCapacity;
+#endif
+} ScriptWatcher;
+
+// Editor text as a gap buffer: an edit only moves the characters between the previous edit and this one
+typedef struct {
+    char *data;
+    int capacity;
+    int gapStart;
+    int gapEnd;             // Kept past gapStart once allocated, so the text can be terminated in place
+    // Start of every line but the first, gapped like the text: entries before the gap are offsets,
+    // entries after it count back from the end of the text so edits at the gap leave them alone
+    int *lineStarts;
+    int lineCapacity;
+    int lineGapStart;
+    int lineGapEnd;
+    unsigned int revision;  // Bumped by every edit
+} TextBuffer;
+
+// One logged edit: `length` characters inserted at or deleted from `pos`
+typedef struct {
+    char *text;
+    int length;
+    int capacity;
+    int pos;
+    bool isInsert;
+    bool isTyping;          // Keystrokes next to it grow this edit instead of adding a step
+    bool startsStep;        // Undo and redo stop at the first edit of a step
+    bool reversed;          // text is stored back to front, a backspace run appends to it
+} EditOp;
+
+// Widths of the prefixes of one editor line, valid while the text revision is unchanged
+typedef struct {
+    int line;
+    int start;
+    int length;
+    unsigned int revision;
+    float *widths;          // widths[i] is MeasureTextEx of the first i bytes
+    int capacity;
+} LineLayout;
+
+// Glyph advances of the editor font, so line widths are sums instead of MeasureTextEx calls
+typedef struct {
+    Font font;
+    float size;
+    float spacing;
+    float advances[128];    // Scaled ASCII advances, the rest are looked up as they appear
+    LineLayout lines[EDITOR_LAYOUT_SLOTS];
+} TextLayout;
+
 typedef struct {
     bool isOpen;
     char filename[MAX_FILENAME_CHARS + 1];
-    char command[MAX_COMMAND_CHARS + 1];
+    TextBuffer command;
     int filenameLength;
     int commandLength;
     bool filenameActive;
     bool commandActive;
     int framesCounter;
     bool isEditMode;
-    int editIndex;
+    char editPath[512];     // The watcher can reorder the list while the modal is open, so saves go by path
     Rectangle filenameBox;
     Rectangle commandBox;
     float commandScrollOffsetY;
     float commandScrollOffsetX;
     float commandMaxScrollY;
     float commandMaxScrollX;
-    // Undo/Redo stacks
-    char undoStack[MAX_UNDO_STACK][MAX_COMMAND_CHARS + 1];
-    int undoStackSize;
-    char redoStack[MAX_UNDO_STACK][MAX_COMMAND_CHARS + 1];
-    int redoStackSize;
+    // Undo/Redo log, edits[editCount..editTotal) are the undone ones
+    EditOp *edits;
+    int editCount;
+    int editTotal;
+    int editCapacity;
+    bool coalesceEdits;     // The last edit can still absorb the next keystroke
+    TextLayout layout;
     // Text editor cursor
     int cursorPos;
     int selectionStart;
@@ -92,6 +817,14 @@ typedef struct {
     float maxScroll;
 } ScrollableList;
 
+// Hit boxes of one list row, only worked out for the rows on screen
+typedef struct {
+    Rectangle bounds;
+    Rectangle editBounds;
+    Rectangle deleteBounds;
+    Rectangle cancelBounds;
+} FileRowLayout;
+
 // Get absolute path to scripts directory
 void getScriptsPath(char *buffer, size_t bufferSize) {
 #ifdef PLATFORM_WINDOWS
@@ -133,705 +866,7720 @@ void getScriptsPath(char *buffer, size_t bufferSize) {
 #endif
 }
 
-// Read file content
+// Read whole file content (no size cap)
 char* readFileContent(const char *filepath) {
     FILE *file = fopen(filepath, "r");
     if (file == NULL) {
         return NULL;
     }
 
-    char *buffer = (char*)malloc(MAX_SCRIPT_SIZE);
+    long fileSize = 0;
+    if (fseek(file, 0, SEEK_END) == 0) {
+        fileSize = ftell(file);
+        fseek(file, 0, SEEK_SET);
+    }
+    if (fileSize < 0) fileSize = 0;
+
+    char *buffer = (char*)malloc((size_t)fileSize + 1);
     if (buffer == NULL) {
         fclose(file);
         return NULL;
     }
 
-    size_t bytesRead = fread(buffer, 1, MAX_SCRIPT_SIZE - 1, file);
+    // Text mode may return fewer bytes than the size on disk (CRLF), never more
+    size_t bytesRead = fread(buffer, 1, (size_t)fileSize, file);
     buffer[bytesRead] = '\0';
     fclose(file);
     return buffer;
 }
 
-// Execute file content as command using system()
-void executeFileContent(const char *filepath) {
-    char *content = readFileContent(filepath);
-    if (content == NULL) {
-        return;
-    }
-
 #ifdef PLATFORM_WINDOWS
-    char tempPath[2048] = {0};
-    char tempFile[2048] = {0};
-
-    if (GetTempPathA(sizeof(tempPath) - 20, tempPath) == 0) {
-        strcpy(tempPath, "C:\\Temp\\");
-    }
+typedef struct {
+    void *(*func)(void *);
+    void *arg;
+} ThreadStart;
+
+// Adapt a pthread-style entry point to CreateThread
+DWORD WINAPI threadTrampoline(LPVOID param) {
+    ThreadStart start = *(ThreadStart*)param;
+    free(param);
+    start.func(start.arg);
+    return 0;
+}
+#endif
 
-    // Ensure path ends with backslash
-    size_t len = strlen(tempPath);
-    if (len > 0 && tempPath[len-1] != '\\') {
-        strcat(tempPath, "\\");
+// Start a thread running func(arg), returns false on failure
+bool startThread(ThreadHandle *thread, void *(*func)(void *), void *arg) {
+#ifdef PLATFORM_WINDOWS
+    ThreadStart *start = (ThreadStart*)malloc(sizeof(ThreadStart));
+    if (start == NULL) {
+        return false;
     }
+    start->func = func;
+    start->arg = arg;
 
-    strcat(tempFile, tempPath);
-    strcat(tempFile, "kort_exec.bat");
-
-    FILE *temp = fopen(tempFile, "w");
-    if (temp) {
-        fprintf(temp, "@echo off\n");
-        fprintf(temp, "%s\n", content);
-        fprintf(temp, "echo.\n");
-        fprintf(temp, "echo Press any key to close...\n");
-        fclose(temp);
-
-        // Use ShellExecuteA instead of system() for better performance
-        char cmdArgs[4096];
-        snprintf(cmdArgs, sizeof(cmdArgs), "/c \"%s\"", tempFile);
-        ShellExecuteA(NULL, "open", "cmd.exe", cmdArgs, NULL, SW_SHOW);
+    *thread = CreateThread(NULL, 0, threadTrampoline, start, 0, NULL);
+    if (*thread == NULL) {
+        free(start);
+        return false;
     }
+    return true;
 #else
-    char tempFile[512];
-    snprintf(tempFile, sizeof(tempFile), "/tmp/kort_exec.sh");
-
-    FILE *temp = fopen(tempFile, "w");
-    if (temp) {
-        fprintf(temp, "#!/bin/bash\n");
-        fprintf(temp, "%s\n", content);
-        fprintf(temp, "echo\n");
-        fprintf(temp, "read -p 'Press Enter to close...'\n");
-        fclose(temp);
-        chmod(tempFile, 0755);
-
-        char command[1024];
-        snprintf(command, sizeof(command),
-                 "x-terminal-emulator -e \"%s\" 2>/dev/null || "
-                 "gnome-terminal -- \"%s\" 2>/dev/null || "
-                 "xterm -e \"%s\" 2>/dev/null || "
-                 "konsole -e \"%s\" 2>/dev/null &",
-                 tempFile, tempFile, tempFile, tempFile);
-        system(command);
-    }
+    return pthread_create(thread, NULL, func, arg) == 0;
 #endif
+}
 
-    free(content);
+// Processors available to this process, at least 1
+int getCpuCount(void) {
+#ifdef PLATFORM_WINDOWS
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors > 0 ? (int)info.dwNumberOfProcessors : 1;
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (int)count : 1;
+#endif
 }
 
-// Open scripts folder in file explorer
-void openScriptsFolder(const char *scriptDir) {
+// Wait for a thread to finish and release it
+void joinThread(ThreadHandle thread) {
 #ifdef PLATFORM_WINDOWS
-    // Use ShellExecuteA instead of system() for better performance
-    ShellExecuteA(NULL, "open", scriptDir, NULL, NULL, SW_SHOW);
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
 #else
-    char command[1024];
-    snprintf(command, sizeof(command),
-             "xdg-open \"%s\" 2>/dev/null || "
-             "nautilus \"%s\" 2>/dev/null || "
-             "dolphin \"%s\" 2>/dev/null &",
-             scriptDir, scriptDir, scriptDir);
-    system(command);
+    pthread_join(thread, NULL);
 #endif
 }
 
-// Save script
-bool saveNewScript(const char *scriptDir, const char *filename, const char *command) {
-    if (strlen(filename) == 0 || strlen(command) == 0) {
-        return false;
-    }
+void initMutex(Mutex *mutex) {
+#ifdef PLATFORM_WINDOWS
+    InitializeCriticalSection(mutex);
+#else
+    pthread_mutex_init(mutex, NULL);
+#endif
+}
 
-    char filepath[512];
+void lockMutex(Mutex *mutex) {
+#ifdef PLATFORM_WINDOWS
+    EnterCriticalSection(mutex);
+#else
+    pthread_mutex_lock(mutex);
+#endif
+}
 
+void unlockMutex(Mutex *mutex) {
 #ifdef PLATFORM_WINDOWS
-    if (strstr(filename, ".bat") == NULL && strstr(filename, ".cmd") == NULL) {
-        snprintf(filepath, sizeof(filepath), "%s/%s.bat", scriptDir, filename);
-    } else {
-        snprintf(filepath, sizeof(filepath), "%s/%s", scriptDir, filename);
-    }
+    LeaveCriticalSection(mutex);
 #else
-    if (strstr(filename, ".sh") == NULL) {
-        snprintf(filepath, sizeof(filepath), "%s/%s.sh", scriptDir, filename);
-    } else {
-        snprintf(filepath, sizeof(filepath), "%s/%s", scriptDir, filename);
-    }
+    pthread_mutex_unlock(mutex);
 #endif
+}
 
-    FILE *file = fopen(filepath, "w");
-    if (file == NULL) {
-        return false;
-    }
+void initCondVar(CondVar *cond) {
+#ifdef PLATFORM_WINDOWS
+    InitializeConditionVariable(cond);
+#else
+    pthread_cond_init(cond, NULL);
+#endif
+}
 
+// Release mutex and sleep until woken, the mutex is held again on return
+void waitCondVar(CondVar *cond, Mutex *mutex) {
 #ifdef PLATFORM_WINDOWS
-    fprintf(file, "@echo off\n");
-    fprintf(file, "%s\n", command);
+    SleepConditionVariableCS(cond, mutex, INFINITE);
 #else
-    fprintf(file, "#!/bin/bash\n");
-    fprintf(file, "%s\n", command);
+    pthread_cond_wait(cond, mutex);
 #endif
+}
 
-    fclose(file);
+void broadcastCondVar(CondVar *cond) {
+#ifdef PLATFORM_WINDOWS
+    WakeAllConditionVariable(cond);
+#else
+    pthread_cond_broadcast(cond);
+#endif
+}
 
-#ifndef PLATFORM_WINDOWS
-    chmod(filepath, 0755);
+// Give up the rest of this thread's time slice for roughly a millisecond
+void sleepBriefly(void) {
+#ifdef PLATFORM_WINDOWS
+    Sleep(1);
+#else
+    usleep(1000);
 #endif
+}
 
-    return true;
+// Monotonic clock in seconds, usable from any thread
+double getMonotonicSeconds(void) {
+#ifdef PLATFORM_WINDOWS
+    LARGE_INTEGER frequency, counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (double)counter.QuadPart / (double)frequency.QuadPart;
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+#endif
 }
 
-// Delete script file
-bool deleteScript(const char *filepath) {
-    if (remove(filepath) == 0) {
-        return true;
-    } else {
+// Allocate ring storage, capacity must be a power of two
+bool initByteRing(ByteRing *ring, size_t capacity) {
+    ring->data = (char*)malloc(capacity);
+    if (ring->data == NULL) {
         return false;
     }
+    ring->capacity = capacity;
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->dropped, 0);
+    return true;
 }
 
-// Reload files from directory
-int loadFiles(FileItem *files, const char *scriptDir) {
-    int fileCount = 0;
-
-    DIR *dir = opendir(scriptDir);
-    if (dir == NULL) {
-        return 0;
+// Producer side: copy as much as fits, count the rest as dropped
+void pushByteRing(ByteRing *ring, const char *data, size_t length) {
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    size_t space = ring->capacity - (head - tail);
+    size_t count = length < space ? length : space;
+
+    size_t offset = head & (ring->capacity - 1);
+    size_t firstPart = ring->capacity - offset;
+    if (firstPart > count) firstPart = count;
+    memcpy(ring->data + offset, data, firstPart);
+    memcpy(ring->data, data + firstPart, count - firstPart);
+
+    atomic_store_explicit(&ring->head, head + count, memory_order_release);
+    if (count < length) {
+        atomic_fetch_add_explicit(&ring->dropped, length - count, memory_order_relaxed);
     }
+}
 
-    struct dirent *entry;
-
-    while ((entry = readdir(dir)) && fileCount < MAX_FILES) {
-        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
-            continue;
-
-        snprintf(files[fileCount].filePath, sizeof(files[fileCount].filePath),
-                 "%s/%s", scriptDir, entry->d_name);
+// Consumer side: copy up to maxLength bytes out, returns the byte count
+size_t popByteRing(ByteRing *ring, char *out, size_t maxLength) {
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    size_t count = head - tail;
+    if (count > maxLength) count = maxLength;
+
+    size_t offset = tail & (ring->capacity - 1);
+    size_t firstPart = ring->capacity - offset;
+    if (firstPart > count) firstPart = count;
+    memcpy(out, ring->data + offset, firstPart);
+    memcpy(out + firstPart, ring->data, count - firstPart);
+
+    atomic_store_explicit(&ring->tail, tail + count, memory_order_release);
+    return count;
+}
 
-        const char *ext = strrchr(entry->d_name, '.');
-        if (ext != NULL) {
-            strncpy(files[fileCount].fileExtension, ext, sizeof(files[fileCount].fileExtension) - 1);
-            files[fileCount].fileExtension[sizeof(files[fileCount].fileExtension) - 1] = '\0';
-        } else {
-            files[fileCount].fileExtension[0] = '\0';
-        }
+// Allocate console scrollback
+bool initConsoleBuffer(ConsoleBuffer *console) {
+    memset(console, 0, sizeof(*console));
+    console->text = (char*)malloc(CONSOLE_TEXT_SIZE);
+    console->lineStarts = (uint64_t*)malloc(CONSOLE_MAX_LINES * sizeof(uint64_t));
+    if (console->text == NULL || console->lineStarts == NULL) {
+        free(console->text);
+        free(console->lineStarts);
+        return false;
+    }
+    console->lineStarts[0] = 0;
+    console->lineCount = 1;
+    console->followTail = true;
+    return true;
+}
 
-        size_t len = strlen(entry->d_name);
-        size_t dotIndex = len;
-        for (size_t x = 0; x < len; x++) {
-            if (entry->d_name[x] == '.') {
-                dotIndex = x;
-                break;
-            }
-        }
+void freeConsoleBuffer(ConsoleBuffer *console) {
+    free(console->text);
+    free(console->lineStarts);
+    console->text = NULL;
+    console->lineStarts = NULL;
+}
 
-        strncpy(files[fileCount].displayName, entry->d_name, dotIndex);
-        files[fileCount].displayName[dotIndex] = '\0';
-        files[fileCount].isExecuting = false;
+// Drop the oldest line, keeping at least the open last line
+void dropConsoleLine(ConsoleBuffer *console) {
+    if (console->lineCount <= 1) return;
+    console->firstLine++;
+    console->lineCount--;
+    console->start = console->lineStarts[console->firstLine & (CONSOLE_MAX_LINES - 1)];
+}
 
-        fileCount++;
+// Append bytes to the scrollback, evicting old lines once it is full
+void appendConsoleText(ConsoleBuffer *console, const char *data, size_t length) {
+    // Only the tail of an oversized chunk can survive anyway
+    if (length > CONSOLE_TEXT_SIZE / 2) {
+        data += length - CONSOLE_TEXT_SIZE / 2;
+        length = CONSOLE_TEXT_SIZE / 2;
     }
-    closedir(dir);
 
-    return fileCount;
-}
+    while (console->end + length - console->start > CONSOLE_TEXT_SIZE && console->lineCount > 1) {
+        dropConsoleLine(console);
+    }
+    if (console->end + length - console->start > CONSOLE_TEXT_SIZE) {
+        // A single open line filled everything, cut its head
+        console->start = console->end + length - CONSOLE_TEXT_SIZE;
+        console->lineStarts[console->firstLine & (CONSOLE_MAX_LINES - 1)] = console->start;
+    }
 
-// Push command to undo stack
-void pushUndo(Modal *modal) {
-    if (modal->undoStackSize >= MAX_UNDO_STACK) {
-        // Shift stack
-        for (int i = 0; i < MAX_UNDO_STACK - 1; i++) {
-            strcpy(modal->undoStack[i], modal->undoStack[i + 1]);
+    size_t offset = console->end & (CONSOLE_TEXT_SIZE - 1);
+    size_t firstPart = CONSOLE_TEXT_SIZE - offset;
+    if (firstPart > length) firstPart = length;
+    memcpy(console->text + offset, data, firstPart);
+    memcpy(console->text, data + firstPart, length - firstPart);
+
+    const char *cursor = data;
+    const char *limit = data + length;
+    while ((cursor = memchr(cursor, '\n', limit - cursor)) != NULL) {
+        cursor++;
+        if (console->lineCount == CONSOLE_MAX_LINES) {
+            dropConsoleLine(console);
         }
-        modal->undoStackSize = MAX_UNDO_STACK - 1;
+        uint64_t lineStart = console->end + (uint64_t)(cursor - data);
+        console->lineStarts[(console->firstLine + console->lineCount) & (CONSOLE_MAX_LINES - 1)] = lineStart;
+        console->lineCount++;
     }
 
-    strcpy(modal->undoStack[modal->undoStackSize], modal->command);
-    modal->undoStackSize++;
-    modal->redoStackSize = 0; // Clear redo stack on new action
+    console->end += length;
 }
 
-// Perform undo
-void performUndo(Modal *modal) {
-    if (modal->undoStackSize > 0) {
-        // Push current to redo stack
-        if (modal->redoStackSize < MAX_UNDO_STACK) {
-            strcpy(modal->redoStack[modal->redoStackSize], modal->command);
-            modal->redoStackSize++;
-        }
+// Copy a kept line (without its newline) into out, returns its length
+int getConsoleLine(const ConsoleBuffer *console, uint64_t line, char *out, int outSize) {
+    uint64_t lineStart = console->lineStarts[line & (CONSOLE_MAX_LINES - 1)];
+    uint64_t lineEnd = console->end;
+    if (line + 1 < console->firstLine + console->lineCount) {
+        lineEnd = console->lineStarts[(line + 1) & (CONSOLE_MAX_LINES - 1)] - 1;
+    }
 
-        // Pop from undo stack
-        modal->undoStackSize--;
-        strcpy(modal->command, modal->undoStack[modal->undoStackSize]);
-        modal->commandLength = strlen(modal->command);
-        modal->cursorPos = modal->commandLength;
-        modal->hasSelection = false;
+    int length = 0;
+    for (uint64_t i = lineStart; i < lineEnd && length < outSize - 1; i++) {
+        char c = console->text[i & (CONSOLE_TEXT_SIZE - 1)];
+        if (c == '\r') continue;
+        out[length++] = (c == '\t') ? ' ' : c;
     }
+    out[length] = '\0';
+    return length;
 }
 
-// Perform redo
-void performRedo(Modal *modal) {
-    if (modal->redoStackSize > 0) {
-        // Push current to undo stack
-        pushUndo(modal);
+#ifndef PLATFORM_WINDOWS
+typedef struct {
+    const char *name;
+    const char *execArgs[3];    // Arguments placed between the terminal and the script
+} TerminalCandidate;
 
-        // Pop from redo stack
-        modal->redoStackSize--;
-        strcpy(modal->command, modal->redoStack[modal->redoStackSize]);
-        modal->commandLength = strlen(modal->command);
-        modal->cursorPos = modal->commandLength;
-        modal->hasSelection = false;
+static const TerminalCandidate terminalCandidates[] = {
+    { "x-terminal-emulator", { "-e", NULL } },
+    { "gnome-terminal", { "--wait", "--", NULL } },
+    { "xterm", { "-e", NULL } },
+    { "konsole", { "-e", NULL } },
+};
 
-        // Remove the auto-pushed undo (we just did that)
-        modal->undoStackSize--;
+typedef struct {
+    bool resolved;
+    bool found;
+    char path[512];
+    const TerminalCandidate *candidate;
+} TerminalInfo;
+
+// Search PATH for an executable, writing its absolute path to out
+bool findExecutable(const char *name, char *out, size_t outSize) {
+    const char *pathEnv = getenv("PATH");
+    if (pathEnv == NULL) {
+        pathEnv = "/usr/local/bin:/usr/bin:/bin";
     }
-}
 
-// Insert text at cursor position
-void insertTextAtCursor(Modal *modal, const char *text) {
-    int textLen = strlen(text);
+    const char *dirStart = pathEnv;
+    while (*dirStart != '\0') {
+        const char *dirEnd = strchr(dirStart, ':');
+        size_t dirLen = dirEnd ? (size_t)(dirEnd - dirStart) : strlen(dirStart);
 
-    // Delete selection if exists
-    if (modal->hasSelection) {
-        int selStart = modal->selectionStart < modal->selectionEnd ? modal->selectionStart : modal->selectionEnd;
-        int selEnd = modal->selectionStart > modal->selectionEnd ? modal->selectionStart : modal->selectionEnd;
+        if (dirLen > 0) {
+            snprintf(out, outSize, "%.*s/%s", (int)dirLen, dirStart, name);
+            if (access(out, X_OK) == 0) {
+                return true;
+            }
+        }
 
-        memmove(modal->command + selStart, modal->command + selEnd, modal->commandLength - selEnd + 1);
-        modal->commandLength -= (selEnd - selStart);
-        modal->cursorPos = selStart;
-        modal->hasSelection = false;
+        if (dirEnd == NULL) break;
+        dirStart = dirEnd + 1;
     }
 
-    if (modal->commandLength + textLen < MAX_COMMAND_CHARS) {
-        // Shift text to make room
-        memmove(modal->command + modal->cursorPos + textLen,
-                modal->command + modal->cursorPos,
-                modal->commandLength - modal->cursorPos + 1);
-
-        // Insert new text
-        memcpy(modal->command + modal->cursorPos, text, textLen);
-        modal->commandLength += textLen;
-        modal->cursorPos += textLen;
-    }
+    out[0] = '\0';
+    return false;
 }
 
-// Delete character at cursor
-void deleteCharAtCursor(Modal *modal, bool isBackspace) {
-    if (modal->hasSelection) {
-        int selStart = modal->selectionStart < modal->selectionEnd ? modal->selectionStart : modal->selectionEnd;
-        int selEnd = modal->selectionStart > modal->selectionEnd ? modal->selectionStart : modal->selectionEnd;
-
-        memmove(modal->command + selStart, modal->command + selEnd, modal->commandLength - selEnd + 1);
-        modal->commandLength -= (selEnd - selStart);
-        modal->cursorPos = selStart;
-        modal->hasSelection = false;
-    } else if (isBackspace && modal->cursorPos > 0) {
-        memmove(modal->command + modal->cursorPos - 1,
-                modal->command + modal->cursorPos,
-                modal->commandLength - modal->cursorPos + 1);
-        modal->cursorPos--;
-        modal->commandLength--;
-    } else if (!isBackspace && modal->cursorPos < modal->commandLength) {
-        memmove(modal->command + modal->cursorPos,
-                modal->command + modal->cursorPos + 1,
-                modal->commandLength - modal->cursorPos);
-        modal->commandLength--;
+// x-terminal-emulator is an alternatives symlink, on Debian/Ubuntu to gnome-terminal.wrapper which
+// returns at once. When it points at a terminal we know, launch that one with its own arguments
+const TerminalCandidate *resolveTerminalAlias(const TerminalCandidate *candidate, char *path, size_t pathSize) {
+    char target[PATH_MAX];
+    if (strcmp(candidate->name, "x-terminal-emulator") != 0 || realpath(path, target) == NULL) {
+        return candidate;
     }
-}
-
-// Get cursor position (line, column) from cursor index
-void getCursorLineCol(const char *text, int cursorPos, int *line, int *col) {
-    *line = 0;
-    *col = 0;
-
-    for (int i = 0; i < cursorPos && i < strlen(text); i++) {
-        if (text[i] == '\n') {
-            (*line)++;
-            *col = 0;
-        } else {
-            (*col)++;
+    const char *base = strrchr(target, '/');
+    base = base != NULL ? base + 1 : target;
+
+    int candidateCount = sizeof(terminalCandidates) / sizeof(terminalCandidates[0]);
+    for (int i = 0; i < candidateCount; i++) {
+        const TerminalCandidate *known = &terminalCandidates[i];
+        size_t nameLength = strlen(known->name);
+        if (known == candidate || strncmp(base, known->name, nameLength) != 0 ||
+            (base[nameLength] != '\0' && base[nameLength] != '.')) {
+            continue;
+        }
+        // "gnome-terminal.wrapper" is not the terminal itself, look the real one up
+        char direct[512];
+        if (findExecutable(known->name, direct, sizeof(direct))) {
+            snprintf(path, pathSize, "%s", direct);
+            return known;
+        }
+        if (base[nameLength] == '\0') {
+            snprintf(path, pathSize, "%s", target);
+            return known;
         }
     }
+    return candidate;
 }
 
-// Get cursor index from line and column
-int getCursorPosFromLineCol(const char *text, int targetLine, int targetCol) {
-    int line = 0;
-    int col = 0;
-
-    for (int i = 0; i <= strlen(text); i++) {
-        if (line == targetLine && col == targetCol) {
-            return i;
-        }
-
-        if (text[i] == '\n') {
-            if (line == targetLine) {
-                return i; // End of line
+// Resolve the terminal emulator once and reuse it for every launch
+const TerminalInfo *resolveTerminal(void) {
+    static TerminalInfo terminal = {0};
+
+    if (!terminal.resolved) {
+        terminal.resolved = true;
+        int candidateCount = sizeof(terminalCandidates) / sizeof(terminalCandidates[0]);
+        for (int i = 0; i < candidateCount; i++) {
+            if (findExecutable(terminalCandidates[i].name, terminal.path, sizeof(terminal.path))) {
+                terminal.found = true;
+                terminal.candidate = resolveTerminalAlias(&terminalCandidates[i], terminal.path, sizeof(terminal.path));
+                printf("[EXEC] Using terminal: %s\n", terminal.path);
+                break;
             }
-            line++;
-            col = 0;
-        } else if (text[i] == '\0') {
-            return i;
-        } else {
-            col++;
+        }
+        if (!terminal.found) {
+            printf("[EXEC] No terminal emulator found, scripts will run detached\n");
         }
     }
 
-    return strlen(text);
+    return &terminal;
 }
 
-// Get cursor position from mouse click
-int getCursorPosFromMouse(Font font, const char *text, int mouseX, int mouseY, Rectangle box, float scrollY) {
-    int lineHeight = fontSize + 4;
-    int startX = (int)box.x + 45;
-    int startY = (int)box.y;
-
-    // Account for scroll offset when calculating which line was clicked
-    int adjustedMouseY = mouseY + (int)scrollY;
-    int clickedLine = (adjustedMouseY - startY) / lineHeight;
-    if (clickedLine < 0) clickedLine = 0;
-
-    // Count lines in text
-    int totalLines = 1;
-    for (int i = 0; i < strlen(text); i++) {
-        if (text[i] == '\n') totalLines++;
-    }
-    if (clickedLine >= totalLines) clickedLine = totalLines - 1;
-
-    // Find start of clicked line
-    int currentLine = 0;
-    int lineStart = 0;
-    for (int i = 0; i <= strlen(text); i++) {
-        if (currentLine == clickedLine) {
-            lineStart = i;
-            break;
-        }
-        if (text[i] == '\n') {
-            currentLine++;
+// outputFd for a child that keeps kort's stdio and foreground process group (Ctrl-C reaches both)
+#define SPAWN_INHERIT_STDIO -2
+
+// Spawn argv[0] directly (no shell), stdout/stderr go to outputFd or /dev/null when it is -1
+ProcessId spawnProcess(char *const argv[], int outputFd) {
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    if (outputFd != SPAWN_INHERIT_STDIO) {
+        posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+        if (outputFd >= 0) {
+            posix_spawn_file_actions_adddup2(&actions, outputFd, STDOUT_FILENO);
+            posix_spawn_file_actions_adddup2(&actions, outputFd, STDERR_FILENO);
+        } else {
+            posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+            posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
         }
     }
 
-    // Find end of clicked line
-    int lineEnd = lineStart;
-    while (lineEnd < strlen(text) && text[lineEnd] != '\n') {
-        lineEnd++;
+    // Own process group, so a cancel can signal the child and everything it started
+    posix_spawnattr_t attributes;
+    posix_spawnattr_init(&attributes);
+    if (outputFd != SPAWN_INHERIT_STDIO) {
+        posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETPGROUP);
+        posix_spawnattr_setpgroup(&attributes, 0);
     }
 
-    // Extract the line
-    char line[MAX_COMMAND_CHARS];
-    int lineLen = lineEnd - lineStart;
-    strncpy(line, text + lineStart, lineLen);
-    line[lineLen] = '\0';
-
-    // Find closest character in the line
-    int relativeX = mouseX - startX;
-    int bestPos = lineStart;
-    int minDist = 10000;
+    pid_t pid = 0;
+    int result = posix_spawn(&pid, argv[0], &actions, &attributes, argv, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attributes);
 
-    for (int i = 0; i <= lineLen; i++) {
-        char substr[MAX_COMMAND_CHARS];
-        strncpy(substr, line, i);
-        substr[i] = '\0';
+    if (result != 0) {
+        printf("[EXEC] posix_spawn failed for %s: %s\n", argv[0], strerror(result));
+        return 0;
+    }
+    return pid;
+}
+#endif
+
+// Reader thread: move pipe output into the capture ring until EOF
+void *captureReaderThread(void *arg) {
+    OutputCapture *capture = (OutputCapture*)arg;
+    char chunk[65536];
+
+#ifdef PLATFORM_WINDOWS
+    DWORD bytesRead = 0;
+    while (ReadFile(capture->readHandle, chunk, sizeof(chunk), &bytesRead, NULL) && bytesRead > 0) {
+        pushByteRing(&capture->ring, chunk, bytesRead);
+    }
+#else
+    struct pollfd pfd = { capture->readFd, POLLIN, 0 };
+    for (;;) {
+        ssize_t bytesRead = read(capture->readFd, chunk, sizeof(chunk));
+        if (bytesRead > 0) {
+            pushByteRing(&capture->ring, chunk, (size_t)bytesRead);
+        } else if (bytesRead == 0) {
+            break;
+        } else if (errno == EAGAIN || errno == EINTR) {
+            poll(&pfd, 1, -1);
+        } else {
+            break;
+        }
+    }
+#endif
+
+    atomic_store_explicit(&capture->readerDone, true, memory_order_release);
+    return NULL;
+}
+
+// Allocate a capture with its ring and scrollback
+OutputCapture *createOutputCapture(const char *title) {
+    OutputCapture *capture = (OutputCapture*)calloc(1, sizeof(OutputCapture));
+    if (capture == NULL) {
+        return NULL;
+    }
+    if (!initByteRing(&capture->ring, CAPTURE_RING_SIZE)) {
+        free(capture);
+        return NULL;
+    }
+    if (!initConsoleBuffer(&capture->console)) {
+        free(capture->ring.data);
+        free(capture);
+        return NULL;
+    }
+    atomic_init(&capture->readerDone, false);
+    snprintf(capture->title, sizeof(capture->title), "%s", title);
+#ifdef PLATFORM_WINDOWS
+    capture->readHandle = NULL;
+#else
+    capture->readFd = -1;
+#endif
+    return capture;
+}
+
+// Free a capture whose reader thread has been joined (or never started)
+void destroyOutputCapture(OutputCapture *capture) {
+#ifdef PLATFORM_WINDOWS
+    if (capture->readHandle != NULL) CloseHandle(capture->readHandle);
+#else
+    if (capture->readFd >= 0) close(capture->readFd);
+#endif
+    freeConsoleBuffer(&capture->console);
+    free(capture->ring.data);
+    free(capture);
+}
+
+// Move everything the reader thread produced into the scrollback
+void drainOutputCapture(OutputCapture *capture) {
+    char chunk[65536];
+    size_t total = 0;
+    size_t count;
+
+    // Bounded per frame so a flood can't stall rendering
+    while (total < CAPTURE_RING_SIZE && (count = popByteRing(&capture->ring, chunk, sizeof(chunk))) > 0) {
+        appendConsoleText(&capture->console, chunk, count);
+        total += count;
+    }
+
+    size_t dropped = atomic_exchange_explicit(&capture->ring.dropped, 0, memory_order_relaxed);
+    if (dropped > 0) {
+        char note[96];
+        int noteLength = snprintf(note, sizeof(note), "\n[kOrT: %zu bytes dropped, output too fast]\n", dropped);
+        appendConsoleText(&capture->console, note, (size_t)noteLength);
+    }
+}
+
+#ifndef PLATFORM_WINDOWS
+// Runs the script in place: $1 is the script path, sourced so an `exit`
+// inside it skips the prompt exactly like the old inlined temp file did
+#define RUN_WRAPPER_SCRIPT "f=$1; shift; . \"$f\"; s=$?; echo; read -p 'Press Enter to close...'; exit $s"
+#define RUN_CAPTURE_SCRIPT "f=$1; shift; . \"$f\""
+// Warm shells block on one line naming the script, then run it exactly like a capture run
+#define RUN_WARM_SCRIPT "IFS= read -r f || exit 0; exec </dev/null; . \"$f\""
+#endif
+
+static WarmShellPool warmShells;
+
+#ifndef PLATFORM_WINDOWS
+// Start one idle shell in its own process group, stdin is a socket we send the path on
+bool spawnWarmShell(WarmShell *shell) {
+    int commandFds[2];
+    int outputFds[2];
+    // Close-on-exec from the start, so a script spawned concurrently never inherits them
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, commandFds) != 0) {
+        return false;
+    }
+    if (pipe2(outputFds, O_CLOEXEC) != 0) {
+        close(commandFds[0]);
+        close(commandFds[1]);
+        return false;
+    }
+    // Only our end is non-blocking, the shell writes to a normal pipe
+    fcntl(outputFds[0], F_SETFL, O_NONBLOCK);
+
+    char *argv[] = { "/bin/bash", "-c", RUN_WARM_SCRIPT, "kort", NULL };
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, commandFds[1], STDIN_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, outputFds[1], STDOUT_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, outputFds[1], STDERR_FILENO);
+
+    posix_spawnattr_t attributes;
+    posix_spawnattr_init(&attributes);
+    posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETPGROUP);
+    posix_spawnattr_setpgroup(&attributes, 0);
+
+    pid_t pid = 0;
+    int result = posix_spawn(&pid, argv[0], &actions, &attributes, argv, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attributes);
+    close(commandFds[1]);
+    close(outputFds[1]);
+
+    if (result != 0) {
+        printf("[WARM] posix_spawn failed: %s\n", strerror(result));
+        close(commandFds[0]);
+        close(outputFds[0]);
+        return false;
+    }
+    shell->pid = pid;
+    shell->commandFd = commandFds[0];
+    shell->outputFd = outputFds[0];
+    return true;
+}
+
+// Close an idle shell, it exits on the EOF
+void discardWarmShell(WarmShell *shell) {
+    close(shell->commandFd);
+    close(shell->outputFd);
+    waitpid(shell->pid, NULL, 0);
+}
+
+// Refill thread: spawn shells outside the lock until the pool is back at its target
+void *warmShellRefillThread(void *arg) {
+    WarmShellPool *pool = (WarmShellPool*)arg;
+
+    lockMutex(&pool->lock);
+    while (!pool->shuttingDown) {
+        if (pool->count >= pool->target) {
+            waitCondVar(&pool->wake, &pool->lock);
+            continue;
+        }
+        unlockMutex(&pool->lock);
+
+        // Woken by a launch: give the script that just got a shell a head start on the CPU
+        sleepBriefly();
+        WarmShell shell;
+        bool spawned = spawnWarmShell(&shell);
+
+        lockMutex(&pool->lock);
+        if (!spawned) {
+            // Don't spin on a broken bash, later warm runs just start cold
+            pool->target = pool->count;
+        } else if (pool->shuttingDown) {
+            unlockMutex(&pool->lock);
+            discardWarmShell(&shell);
+            lockMutex(&pool->lock);
+        } else {
+            pool->shells[pool->count++] = shell;
+        }
+    }
+    unlockMutex(&pool->lock);
+    return NULL;
+}
+
+// Hand out an idle shell, false when none is ready
+bool takeWarmShell(WarmShell *shell) {
+    if (!warmShells.started) {
+        return false;
+    }
+
+    bool found = false;
+    lockMutex(&warmShells.lock);
+    while (!found && warmShells.count > 0) {
+        *shell = warmShells.shells[--warmShells.count];
+        // Killed while idle: it is reaped here and the next one is tried
+        if (waitpid(shell->pid, NULL, WNOHANG) == 0) {
+            found = true;
+        } else {
+            close(shell->commandFd);
+            close(shell->outputFd);
+        }
+    }
+    if (found) {
+        warmShells.warmLaunches++;
+    } else {
+        warmShells.coldLaunches++;
+        broadcastCondVar(&warmShells.wake);
+    }
+    unlockMutex(&warmShells.lock);
+    return found;
+}
+
+// Wake the refill thread, done after a launch so spawning the replacement doesn't delay it
+void refillWarmShells(void) {
+    lockMutex(&warmShells.lock);
+    broadcastCondVar(&warmShells.wake);
+    unlockMutex(&warmShells.lock);
+}
+
+// Run a script on an idle shell with its output going to capture, returns 0 when none was ready
+ProcessId launchOnWarmShell(const char *filepath, OutputCapture *capture) {
+    char line[1024];
+    int lineLength = snprintf(line, sizeof(line), "%s\n", filepath);
+    if (lineLength >= (int)sizeof(line) || strchr(filepath, '\n') != NULL) {
+        return 0;
+    }
+
+    WarmShell shell;
+    if (!takeWarmShell(&shell)) {
+        return 0;
+    }
+
+    // The socket buffer takes the whole line at once, closing it gives the shell EOF for the script's stdin
+    bool sent = send(shell.commandFd, line, (size_t)lineLength, MSG_NOSIGNAL) == lineLength;
+    close(shell.commandFd);
+    refillWarmShells();
+    if (!sent) {
+        close(shell.outputFd);
+        waitpid(shell.pid, NULL, 0);
+        return 0;
+    }
+
+    capture->readFd = shell.outputFd;
+    return shell.pid;
+}
+#endif
+
+// How many shells to keep ready: KORT_WARM_SHELLS, capped at MAX_WARM_SHELLS (0 turns them off)
+int getWarmShellTarget(void) {
+    int target = DEFAULT_WARM_SHELLS;
+    const char *sizeEnv = getenv("KORT_WARM_SHELLS");
+    if (sizeEnv != NULL) {
+        target = atoi(sizeEnv);
+        if (target < 0) target = 0;
+        if (target > MAX_WARM_SHELLS) target = MAX_WARM_SHELLS;
+    }
+    return target;
+}
+
+// Start the warm shell pool once, KORT_WARM_SHELLS sets its size (0 turns it off)
+void initWarmShells(void) {
+    if (warmShells.started) {
+        return;
+    }
+
+#ifdef PLATFORM_WINDOWS
+    printf("[WARM] Warm shells are not available on Windows, warm runs start cold\n");
+#else
+    int target = getWarmShellTarget();
+    if (target == 0) {
+        printf("[WARM] KORT_WARM_SHELLS is 0, warm runs start cold\n");
+        return;
+    }
+
+    initMutex(&warmShells.lock);
+    initCondVar(&warmShells.wake);
+    warmShells.target = target;
+    if (!startThread(&warmShells.refiller, warmShellRefillThread, &warmShells)) {
+        printf("[WARM] Could not start the refill thread, warm runs start cold\n");
+        return;
+    }
+    warmShells.started = true;
+    printf("[WARM] Keeping %d shells ready\n", target);
+#endif
+}
+
+// Stop refilling and let the idle shells exit
+void shutdownWarmShells(void) {
+#ifndef PLATFORM_WINDOWS
+    if (!warmShells.started) {
+        return;
+    }
+
+    lockMutex(&warmShells.lock);
+    warmShells.shuttingDown = true;
+    broadcastCondVar(&warmShells.wake);
+    unlockMutex(&warmShells.lock);
+    joinThread(warmShells.refiller);
+
+    for (int i = 0; i < warmShells.count; i++) {
+        discardWarmShell(&warmShells.shells[i]);
+    }
+    printf("[WARM] %llu warm launches, %llu started cold\n",
+           (unsigned long long)warmShells.warmLaunches, (unsigned long long)warmShells.coldLaunches);
+    memset(&warmShells, 0, sizeof(warmShells));
+#endif
+}
+
+#ifndef PLATFORM_WINDOWS
+// Command line of a run: bash sourcing the script, inside the resolved terminal for terminal runs.
+// Returns the argument count, argv is NULL terminated
+int fillRunArgv(char *argv[12], const char *filepath, RunMode mode) {
+    int argc = 0;
+    if (mode == RUN_MODE_TERMINAL) {
+        const TerminalInfo *terminal = resolveTerminal();
+        if (terminal->found) {
+            argv[argc++] = (char*)terminal->path;
+            for (int i = 0; terminal->candidate->execArgs[i] != NULL; i++) {
+                argv[argc++] = (char*)terminal->candidate->execArgs[i];
+            }
+        }
+    }
+    argv[argc++] = "/bin/bash";
+    argv[argc++] = "-c";
+    argv[argc++] = mode == RUN_MODE_TERMINAL ? RUN_WRAPPER_SCRIPT : RUN_CAPTURE_SCRIPT;
+    argv[argc++] = "kort";
+    argv[argc++] = (char*)filepath;
+    argv[argc] = NULL;
+    return argc;
+}
+#endif
+
+// Execute a script straight from its file, returns the child PID (0 on failure).
+// Capture and warm mode send output to a pipe read by a thread, terminal mode to a new terminal and
+// inline mode to kort's own stdio.
+// The child leads its own process group (sits in its own job on Windows) so it can be cancelled as a tree
+ProcessId executeFileContent(const char *filepath, RunMode mode, void **processHandle, void **jobHandle, OutputCapture *capture) {
+    *processHandle = NULL;
+    *jobHandle = NULL;
+    ProcessId pid = 0;
+
+#ifdef PLATFORM_WINDOWS
+    // cmd strips the outer quotes after /c, /q replaces the old "@echo off" header,
+    // /v:on lets the trailing exit hand back the script's errorlevel (echo leaves it alone)
+    char cmdLine[4096];
+    if (mode != RUN_MODE_TERMINAL) {
+        snprintf(cmdLine, sizeof(cmdLine), "cmd.exe /q /c \"call \"%s\"\"", filepath);
+    } else {
+        snprintf(cmdLine, sizeof(cmdLine),
+                 "cmd.exe /q /v:on /c \"call \"%s\" & echo. & echo Press any key to close... & exit !errorlevel!\"", filepath);
+    }
+
+    // CreateProcessA (unlike ShellExecuteA) hands back the child PID
+    STARTUPINFOA startupInfo = {0};
+    PROCESS_INFORMATION processInfo = {0};
+    startupInfo.cb = sizeof(startupInfo);
+    DWORD creationFlags = mode == RUN_MODE_INLINE ? 0 : CREATE_NEW_CONSOLE;
+    BOOL inheritHandles = FALSE;
+    HANDLE writeHandle = NULL;
+
+    if (capture != NULL) {
+        SECURITY_ATTRIBUTES security = { sizeof(SECURITY_ATTRIBUTES), NULL, TRUE };
+        if (!CreatePipe(&capture->readHandle, &writeHandle, &security, 0)) {
+            capture->readHandle = NULL;
+            return 0;
+        }
+        SetHandleInformation(capture->readHandle, HANDLE_FLAG_INHERIT, 0);
+        startupInfo.dwFlags = STARTF_USESTDHANDLES;
+        startupInfo.hStdInput = NULL;
+        startupInfo.hStdOutput = writeHandle;
+        startupInfo.hStdError = writeHandle;
+        creationFlags = CREATE_NO_WINDOW;
+        inheritHandles = TRUE;
+    } else if (mode == RUN_MODE_INLINE) {
+        // Pass our own handles on explicitly so redirected output follows too
+        startupInfo.dwFlags = STARTF_USESTDHANDLES;
+        startupInfo.hStdInput = GetStdHandle(STD_INPUT_HANDLE);
+        startupInfo.hStdOutput = GetStdHandle(STD_OUTPUT_HANDLE);
+        startupInfo.hStdError = GetStdHandle(STD_ERROR_HANDLE);
+        inheritHandles = TRUE;
+    }
+
+    // Started suspended so it is inside its job before it can spawn anything
+    HANDLE job = CreateJobObjectA(NULL, NULL);
+    if (CreateProcessA(NULL, cmdLine, NULL, NULL, inheritHandles, creationFlags | CREATE_SUSPENDED,
+                       NULL, NULL, &startupInfo, &processInfo)) {
+        if (job != NULL && !AssignProcessToJobObject(job, processInfo.hProcess)) {
+            printf("[EXEC] Could not assign pid %lu to a job, cancel will only stop the script itself\n",
+                   processInfo.dwProcessId);
+            CloseHandle(job);
+            job = NULL;
+        }
+        ResumeThread(processInfo.hThread);
+        pid = processInfo.dwProcessId;
+        *processHandle = processInfo.hProcess;
+        *jobHandle = job;
+        CloseHandle(processInfo.hThread);
+    } else if (job != NULL) {
+        CloseHandle(job);
+    }
+    if (writeHandle != NULL) {
+        CloseHandle(writeHandle);
+    }
+#else
+    // Warm runs skip shell startup when an idle shell is ready, otherwise they start cold like capture runs
+    if (mode == RUN_MODE_WARM && capture != NULL) {
+        pid = launchOnWarmShell(filepath, capture);
+    }
+
+    if (pid == 0) {
+        char *argv[12];
+        int pipeFds[2] = { -1, -1 };
+        int outputFd = SPAWN_INHERIT_STDIO;
+
+        if (capture != NULL) {
+            // Close-on-exec from the start, other threads may be spawning while this one sets up
+            if (pipe2(pipeFds, O_CLOEXEC) != 0) {
+                return 0;
+            }
+            fcntl(pipeFds[0], F_SETFL, O_NONBLOCK);
+            capture->readFd = pipeFds[0];
+            outputFd = pipeFds[1];
+        } else if (mode == RUN_MODE_TERMINAL) {
+            outputFd = -1;
+        }
+        fillRunArgv(argv, filepath, mode);
+
+        pid = spawnProcess(argv, outputFd);
+
+        // Only the child keeps the write end, so the reader sees EOF when it exits
+        if (pipeFds[1] >= 0) {
+            close(pipeFds[1]);
+        }
+    }
+#endif
+
+    if (capture != NULL && pid != 0) {
+        capture->readerStarted = startThread(&capture->reader, captureReaderThread, capture);
+        if (!capture->readerStarted) {
+            atomic_store(&capture->readerDone, true);
+        }
+    }
+
+    return pid;
+}
+
+// FNV-1a hash of a script's file name, never 0 so it can key the history table
+uint64_t hashScriptName(const char *name) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (const unsigned char *c = (const unsigned char*)name; *c != '\0'; c++) {
+        hash ^= *c;
+        hash *= 1099511628211ULL;
+    }
+    return hash != 0 ? hash : 1;
+}
+
+// Duration bucket: exact below 4ms, then 4 buckets per power of two (max 19% error)
+int historyBucketIndex(uint32_t ms) {
+    if (ms < 4) return (int)ms;
+    int exponent = 31 - __builtin_clz(ms);
+    return 4 + (exponent - 2) * 4 + (int)((ms >> (exponent - 2)) & 3);
+}
+
+// Representative duration of a bucket (its midpoint)
+uint32_t historyBucketValue(int bucket) {
+    if (bucket < 4) return (uint32_t)bucket;
+    int exponent = (bucket - 4) / 4 + 2;
+    uint32_t low = (uint32_t)(4 + (bucket - 4) % 4) << (exponent - 2);
+    return low + ((1u << (exponent - 2)) >> 1);
+}
+
+// Find a script's aggregate, optionally inserting an empty one (NULL when absent or out of memory)
+ScriptHistory *findScriptHistory(HistoryTable *table, uint64_t key, bool create) {
+    if (table->capacity == 0 || (create && (table->count + 1) * 10 > table->capacity * 7)) {
+        if (!create) return NULL;
+
+        size_t newCapacity = table->capacity == 0 ? 256 : table->capacity * 2;
+        ScriptHistory *entries = (ScriptHistory*)calloc(newCapacity, sizeof(ScriptHistory));
+        if (entries == NULL) return NULL;
+
+        for (size_t i = 0; i < table->capacity; i++) {
+            if (table->entries[i].scriptKey == 0) continue;
+            size_t slot = table->entries[i].scriptKey & (newCapacity - 1);
+            while (entries[slot].scriptKey != 0) slot = (slot + 1) & (newCapacity - 1);
+            entries[slot] = table->entries[i];
+        }
+        free(table->entries);
+        table->entries = entries;
+        table->capacity = newCapacity;
+    }
+
+    size_t slot = key & (table->capacity - 1);
+    while (table->entries[slot].scriptKey != 0) {
+        if (table->entries[slot].scriptKey == key) return &table->entries[slot];
+        slot = (slot + 1) & (table->capacity - 1);
+    }
+    if (!create) return NULL;
+
+    table->entries[slot].scriptKey = key;
+    table->count++;
+    return &table->entries[slot];
+}
+
+// Fold one record into the aggregates
+void addHistoryRecord(HistoryTable *table, const HistoryRecord *record) {
+    ScriptHistory *entry = findScriptHistory(table, record->scriptKey, true);
+    if (entry == NULL) return;
+
+    entry->runs++;
+    if (record->exitCode != 0) entry->failures++;
+    entry->buckets[historyBucketIndex(record->durationMs)]++;
+    entry->percentilesDirty = true;
+    entry->totalMs += record->durationMs;
+    if (record->timestamp > entry->lastRunTime) entry->lastRunTime = record->timestamp;
+}
+
+// Release a table's storage
+void freeHistoryTable(HistoryTable *table) {
+    free(table->entries);
+    memset(table, 0, sizeof(*table));
+}
+
+// Map a whole file read-only (the history or the index cache), returns NULL when it is missing or empty
+const unsigned char *mapReadOnlyFile(const char *path, size_t *size) {
+    *size = 0;
+#ifdef PLATFORM_WINDOWS
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                              NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) return NULL;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+        CloseHandle(file);
+        return NULL;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (mapping == NULL) return NULL;
+
+    // The view keeps the mapping alive
+    const unsigned char *data = (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (data == NULL) return NULL;
+
+    *size = (size_t)fileSize.QuadPart;
+    return data;
+#else
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) return NULL;
+
+    struct stat info;
+    if (fstat(fd, &info) == -1 || info.st_size == 0) {
+        close(fd);
+        return NULL;
+    }
+
+    void *data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return NULL;
+
+    madvise(data, (size_t)info.st_size, MADV_SEQUENTIAL);
+    *size = (size_t)info.st_size;
+    return (const unsigned char*)data;
+#endif
+}
+
+// Drop a mapping made by mapReadOnlyFile
+void unmapReadOnlyFile(const unsigned char *data, size_t size) {
+#ifdef PLATFORM_WINDOWS
+    (void)size;
+    UnmapViewOfFile(data);
+#else
+    munmap((void*)data, size);
+#endif
+}
+
+// True when a file starts with a header this build can read
+bool isHistoryHeaderValid(const HistoryHeader *header) {
+    return header->magic == HISTORY_MAGIC && header->version == HISTORY_VERSION &&
+           header->recordSize == sizeof(HistoryRecord);
+}
+
+// Loader thread: aggregate every complete record in the mapped file
+void *historyLoaderThread(void *arg) {
+    RunHistory *history = (RunHistory*)arg;
+    double startTime = getMonotonicSeconds();
+
+    size_t size = 0;
+    const unsigned char *data = mapReadOnlyFile(history->path, &size);
+    uint64_t recordCount = 0;
+    history->loadedEnd = 0;
+
+    if (data != NULL && size >= sizeof(HistoryHeader)) {
+        HistoryHeader header;
+        memcpy(&header, data, sizeof(header));
+
+        if (isHistoryHeaderValid(&header)) {
+            recordCount = (size - sizeof(HistoryHeader)) / sizeof(HistoryRecord);
+            const unsigned char *cursor = data + sizeof(HistoryHeader);
+            for (uint64_t i = 0; i < recordCount; i++, cursor += sizeof(HistoryRecord)) {
+                HistoryRecord record;
+                memcpy(&record, cursor, sizeof(record));
+                addHistoryRecord(&history->loadedTable, &record);
+            }
+            history->loadedEnd = sizeof(HistoryHeader) + recordCount * sizeof(HistoryRecord);
+        } else {
+            printf("[HISTORY] Ignoring %s: unknown format\n", history->path);
+        }
+    }
+    if (data != NULL) {
+        unmapReadOnlyFile(data, size);
+    }
+
+    printf("[HISTORY] Loaded %llu runs of %zu scripts in %.1f ms\n", (unsigned long long)recordCount,
+           history->loadedTable.count, (getMonotonicSeconds() - startTime) * 1000.0);
+    atomic_store_explicit(&history->loadDone, true, memory_order_release);
+    return NULL;
+}
+
+// kOrT's own files live next to the scripts directory, so the watcher never sees them.
+// Returns false with an empty buffer when the path does not fit, rather than a truncated one
+bool getDataFilePath(const char *scriptDir, const char *fileName, char *buffer, size_t bufferSize) {
+    const char *lastSlash = strrchr(scriptDir, '/');
+#ifdef PLATFORM_WINDOWS
+    const char *lastBackslash = strrchr(scriptDir, '\\');
+    if (lastBackslash != NULL && (lastSlash == NULL || lastBackslash > lastSlash)) lastSlash = lastBackslash;
+#endif
+    int parentLength = lastSlash != NULL ? (int)(lastSlash - scriptDir) : 0;
+    int written = lastSlash != NULL ? snprintf(buffer, bufferSize, "%.*s/%s", parentLength, scriptDir, fileName)
+                                    : snprintf(buffer, bufferSize, "%s", fileName);
+    if (written < 0 || (size_t)written >= bufferSize) {
+        printf("[STARTUP] Path of %s next to %s is too long, not using it\n", fileName, scriptDir);
+        buffer[0] = '\0';
+        return false;
+    }
+    return true;
+}
+
+// History file lives next to the scripts directory
+bool getHistoryPath(const char *scriptDir, char *buffer, size_t bufferSize) {
+    return getDataFilePath(scriptDir, HISTORY_FILE_NAME, buffer, bufferSize);
+}
+
+// Point the history at its file and start loading it
+void initRunHistory(RunHistory *history, const char *scriptDir) {
+    memset(history, 0, sizeof(*history));
+    getHistoryPath(scriptDir, history->path, sizeof(history->path));
+
+    history->loaderStarted = startThread(&history->loader, historyLoaderThread, history);
+    if (!history->loaderStarted) {
+        printf("[HISTORY] Could not start loader thread\n");
+    }
+}
+
+// Adopt the loader's aggregates once ready, plus any runs appended while it was busy
+void pollRunHistory(RunHistory *history) {
+    if (history->loaded || !history->loaderStarted) return;
+    if (!atomic_load_explicit(&history->loadDone, memory_order_acquire)) return;
+
+    joinThread(history->loader);
+    history->table = history->loadedTable;
+    memset(&history->loadedTable, 0, sizeof(history->loadedTable));
+    history->loaded = true;
+    history->generation++;
+    history->loadGeneration = history->generation;
+
+    FILE *file = fopen(history->path, "rb");
+    if (file == NULL) return;
+
+    HistoryHeader header;
+    if (fread(&header, sizeof(header), 1, file) == 1 && isHistoryHeaderValid(&header)) {
+        long offset = history->loadedEnd > sizeof(HistoryHeader) ? (long)history->loadedEnd : (long)sizeof(HistoryHeader);
+        HistoryRecord record;
+        if (fseek(file, offset, SEEK_SET) == 0) {
+            while (fread(&record, sizeof(record), 1, file) == 1) {
+                addHistoryRecord(&history->table, &record);
+            }
+        }
+    }
+    fclose(file);
+}
+
+// Append a finished run to the file and, once loaded, to the aggregates
+void appendRunHistory(RunHistory *history, uint64_t scriptKey, const RunResult *result) {
+    HistoryRecord record = {0};
+    record.scriptKey = scriptKey;
+    record.timestamp = (int64_t)time(NULL);
+    record.durationMs = result->wallSeconds <= 0.0 ? 0 :
+                        result->wallSeconds >= 4294967.0 ? UINT32_MAX : (uint32_t)(result->wallSeconds * 1000.0);
+    record.exitCode = result->exitCode;
+    record.maxRssKb = result->maxRssKb > 0 ? (uint32_t)result->maxRssKb : 0;
+
+    // The path is empty when it did not fit, runs then only make it into the aggregates
+    FILE *file = history->path[0] != '\0' ? fopen(history->path, "ab") : NULL;
+    if (file == NULL) {
+        if (history->path[0] != '\0') printf("[HISTORY] Cannot open %s for append\n", history->path);
+    } else {
+        fseek(file, 0, SEEK_END);
+        if (ftell(file) == 0) {
+            HistoryHeader header = { HISTORY_MAGIC, HISTORY_VERSION, sizeof(HistoryRecord), 0 };
+            fwrite(&header, sizeof(header), 1, file);
+        }
+        fwrite(&record, sizeof(record), 1, file);
+        fclose(file);
+    }
+
+    // Before adoption the record is picked up from the file tail instead
+    if (history->loaded) {
+        addHistoryRecord(&history->table, &record);
+        history->generation++;
+        history->changedKeys[history->generation % HISTORY_CHANGED_KEYS] = scriptKey;
+    }
+}
+
+// Aggregate for a script with up-to-date percentiles, NULL while loading or never run
+const ScriptHistory *getScriptHistory(RunHistory *history, uint64_t scriptKey) {
+    if (!history->loaded) return NULL;
+
+    ScriptHistory *entry = findScriptHistory(&history->table, scriptKey, false);
+    if (entry == NULL || !entry->percentilesDirty) return entry;
+
+    // Smallest bucket whose cumulative count reaches each rank
+    uint32_t rank50 = (uint32_t)(((uint64_t)entry->runs * 50 + 99) / 100);
+    uint32_t rank95 = (uint32_t)(((uint64_t)entry->runs * 95 + 99) / 100);
+    uint32_t rank99 = (uint32_t)(((uint64_t)entry->runs * 99 + 99) / 100);
+    uint32_t seen = 0;
+    entry->p50Ms = entry->p95Ms = entry->p99Ms = 0;
+    bool have50 = false, have95 = false;
+    for (int i = 0; i < HISTORY_BUCKETS; i++) {
+        if (entry->buckets[i] == 0) continue;
+        seen += entry->buckets[i];
+        if (!have50 && seen >= rank50) { entry->p50Ms = historyBucketValue(i); have50 = true; }
+        if (!have95 && seen >= rank95) { entry->p95Ms = historyBucketValue(i); have95 = true; }
+        if (seen >= rank99) { entry->p99Ms = historyBucketValue(i); break; }
+    }
+    entry->percentilesDirty = false;
+    return entry;
+}
+
+// Stop the loader and free the aggregates
+void shutdownRunHistory(RunHistory *history) {
+    if (history->loaderStarted && !history->loaded) {
+        joinThread(history->loader);
+    }
+    freeHistoryTable(&history->loadedTable);
+    freeHistoryTable(&history->table);
+}
+
+// Short human duration for the list ("850ms", "1.2s", "3.5m", "2.0h")
+void formatDurationMs(uint32_t ms, char *buffer, size_t bufferSize) {
+    if (ms < 1000) snprintf(buffer, bufferSize, "%ums", ms);
+    else if (ms < 60000) snprintf(buffer, bufferSize, "%.1fs", ms / 1000.0);
+    else if (ms < 3600000) snprintf(buffer, bufferSize, "%.1fm", ms / 60000.0);
+    else snprintf(buffer, bufferSize, "%.1fh", ms / 3600000.0);
+}
+
+// Write an entry's full path into buffer
+void getFilePath(const ScriptIndex *index, const FileItem *file, char *buffer, size_t bufferSize) {
+    snprintf(buffer, bufferSize, "%s/%s", index->scriptDir, file->fileName);
+}
+
+// Compare a full path against an entry without building the entry's path
+bool fileHasPath(const ScriptIndex *index, const FileItem *file, const char *filePath) {
+    size_t dirLength = strlen(index->scriptDir);
+    return strncmp(filePath, index->scriptDir, dirLength) == 0 && filePath[dirLength] == '/' &&
+           strcmp(filePath + dirLength + 1, file->fileName) == 0;
+}
+
+// Find a file entry by path, returns -1 when it is no longer listed
+int findFileByPath(const ScriptIndex *index, const char *filePath, int hint) {
+    const FileItem *files = index->files;
+    int fileCount = index->count;
+    if (hint >= 0 && hint < fileCount && fileHasPath(index, &files[hint], filePath)) {
+        return hint;
+    }
+    for (int i = 0; i < fileCount; i++) {
+        if (fileHasPath(index, &files[i], filePath)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Run state of an entry for reading, an all-zero (idle, never run) one when it has none
+const ScriptRunInfo *peekRunInfo(const ScriptIndex *index, const FileItem *file) {
+    static const ScriptRunInfo neverRun = {0};
+    return file->runInfo >= 0 ? &index->runInfo[file->runInfo] : &neverRun;
+}
+
+// Run state of an entry for writing, created on first use. NULL when out of memory.
+// Creating one can move the table, so earlier pointers into it are stale afterwards
+ScriptRunInfo *takeRunInfo(ScriptIndex *index, FileItem *file) {
+    if (file->runInfo >= 0) {
+        return &index->runInfo[file->runInfo];
+    }
+
+    int slot;
+    if (index->freeRunInfo > 0) {
+        slot = index->freeRunInfo - 1;
+        index->freeRunInfo = index->runInfo[slot].nextFree;
+    } else {
+        if (index->runInfoCount == index->runInfoCapacity) {
+            int newCapacity = index->runInfoCapacity > 0 ? index->runInfoCapacity * 2 : 16;
+            ScriptRunInfo *grown = (ScriptRunInfo*)realloc(index->runInfo, newCapacity * sizeof(ScriptRunInfo));
+            if (grown == NULL) {
+                return NULL;
+            }
+            index->runInfo = grown;
+            index->runInfoCapacity = newCapacity;
+        }
+        slot = index->runInfoCount++;
+    }
+    memset(&index->runInfo[slot], 0, sizeof(ScriptRunInfo));
+    file->runInfo = slot;
+    return &index->runInfo[slot];
+}
+
+// Give an entry's run state back to the table before the entry is dropped
+void releaseRunInfo(ScriptIndex *index, FileItem *file) {
+    if (file->runInfo < 0) {
+        return;
+    }
+    index->runInfo[file->runInfo].nextFree = index->freeRunInfo;
+    index->freeRunInfo = file->runInfo + 1;
+    file->runInfo = -1;
+}
+
+// Find an entry by its historyKey, -1 when it is not listed. Collisions resolve to the first match
+int findIndexedFileByKey(const ScriptIndex *index, uint64_t key) {
+    if (index->lookupCapacity == 0) {
+        return -1;
+    }
+    size_t mask = index->lookupCapacity - 1;
+    for (size_t slot = (size_t)key & mask; index->lookup[slot] != 0; slot = (slot + 1) & mask) {
+        if (index->files[index->lookup[slot] - 1].historyKey == key) {
+            return index->lookup[slot] - 1;
+        }
+    }
+    return -1;
+}
+
+// Find an entry by file name in O(1), returns -1 when it is not listed
+int findIndexedFile(const ScriptIndex *index, const char *fileName) {
+    if (index->lookupCapacity == 0) {
+        return -1;
+    }
+    size_t mask = index->lookupCapacity - 1;
+    uint64_t key = hashScriptName(fileName);
+    for (size_t slot = (size_t)key & mask; index->lookup[slot] != 0; slot = (slot + 1) & mask) {
+        const FileItem *file = &index->files[index->lookup[slot] - 1];
+        if (file->historyKey == key && strcmp(file->fileName, fileName) == 0) {
+            return index->lookup[slot] - 1;
+        }
+    }
+    return -1;
+}
+
+// Find an entry by its full path through the name lookup, -1 when it is not listed
+int findIndexedPath(const ScriptIndex *index, const char *filePath) {
+    size_t dirLength = index->scriptDir != NULL ? strlen(index->scriptDir) : 0;
+    if (dirLength == 0 || strncmp(filePath, index->scriptDir, dirLength) != 0 || filePath[dirLength] != '/') {
+        return -1;
+    }
+    return findIndexedFile(index, filePath + dirLength + 1);
+}
+
+#ifndef PLATFORM_WINDOWS
+// Translate a wait status and its rusage
+void fillRunResult(int status, const struct rusage *usage, RunResult *result) {
+    if (WIFEXITED(status)) result->exitCode = WEXITSTATUS(status);
+    else if (WIFSIGNALED(status)) result->exitCode = 128 + WTERMSIG(status);
+    result->cpuSeconds = (double)usage->ru_utime.tv_sec + (double)usage->ru_utime.tv_usec / 1e6 +
+                         (double)usage->ru_stime.tv_sec + (double)usage->ru_stime.tv_usec / 1e6;
+    result->maxRssKb = usage->ru_maxrss;
+}
+#endif
+
+// Reap a child if it has exited (or wait for it when block is set) and fill in its
+// exit code and resource usage, returns false while it is still running
+bool collectProcessResult(ProcessId pid, void *processHandle, bool block, RunResult *result) {
+    memset(result, 0, sizeof(*result));
+    result->exitCode = -1;
+
+#ifdef PLATFORM_WINDOWS
+    (void)pid;
+    if (processHandle == NULL) {
+        return true;
+    }
+    if (WaitForSingleObject((HANDLE)processHandle, block ? INFINITE : 0) != WAIT_OBJECT_0) {
+        return false;
+    }
+
+    DWORD exitCode = 1;
+    if (GetExitCodeProcess((HANDLE)processHandle, &exitCode)) {
+        result->exitCode = (int)exitCode;
+    }
+
+    FILETIME created, exited, kernelTime, userTime;
+    if (GetProcessTimes((HANDLE)processHandle, &created, &exited, &kernelTime, &userTime)) {
+        ULARGE_INTEGER kernel = { .LowPart = kernelTime.dwLowDateTime, .HighPart = kernelTime.dwHighDateTime };
+        ULARGE_INTEGER user = { .LowPart = userTime.dwLowDateTime, .HighPart = userTime.dwHighDateTime };
+        result->cpuSeconds = (double)(kernel.QuadPart + user.QuadPart) / 1e7;
+    }
+
+    PROCESS_MEMORY_COUNTERS memory;
+    if (K32GetProcessMemoryInfo((HANDLE)processHandle, &memory, sizeof(memory))) {
+        result->maxRssKb = (long)(memory.PeakWorkingSetSize / 1024);
+    }
+    return true;
+#else
+    (void)processHandle;
+    int status = 0;
+    struct rusage usage;
+    pid_t reaped;
+    do {
+        reaped = wait4(pid, &status, block ? 0 : WNOHANG, &usage);
+    } while (reaped == -1 && errno == EINTR);
+
+    if (reaped == 0) {
+        return false;
+    }
+    if (reaped == -1) {
+        // Already reaped elsewhere, nothing left to report
+        return errno == ECHILD;
+    }
+
+    fillRunResult(status, &usage, result);
+    return true;
+#endif
+}
+
+// Recompute an entry's displayed state from its counters and last result
+void refreshRunState(ScriptRunInfo *info) {
+    if (info->activeRuns > 0) {
+        info->runState = info->stoppingRuns >= info->activeRuns ? RUN_STATE_STOPPING : RUN_STATE_RUNNING;
+    } else if (info->queuedRuns > 0) {
+        info->runState = RUN_STATE_QUEUED;
+    } else if (info->hasResult) {
+        info->runState = info->lastResult.exitCode == 0 ? RUN_STATE_SUCCEEDED : RUN_STATE_FAILED;
+    } else {
+        info->runState = RUN_STATE_IDLE;
+    }
+}
+
+// Remember a finished run on its entry and in the run history. A terminal run's status and
+// duration are the terminal's (it waits at the "Press Enter" prompt), so it stays out of the history
+void recordRunResult(RunManager *manager, FileItem *file, ScriptRunInfo *info, const RunResult *result,
+                     RunMode mode) {
+    info->lastResult = *result;
+    info->hasResult = true;
+    if (manager->history != NULL && mode != RUN_MODE_TERMINAL) {
+        appendRunHistory(manager->history, file->historyKey, result);
+    }
+    printf("[RUN] %s exited with %d after %.2fs wall, %.2fs cpu, %ld KB max rss\n",
+           file->displayName, result->exitCode, result->wallSeconds, result->cpuSeconds, result->maxRssKb);
+}
+
+// Initialize run manager
+void initRunManager(RunManager *manager) {
+    memset(manager, 0, sizeof(*manager));
+}
+
+// Register a capture so it is drained every frame, returns false when all slots are taken
+bool addOutputCapture(RunManager *manager, OutputCapture *capture) {
+    for (int i = 0; i < MAX_RUNS; i++) {
+        if (manager->captures[i] == NULL) {
+            manager->captures[i] = capture;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Drain every live capture and free the ones that are finished and not on screen
+void pumpOutputCaptures(RunManager *manager) {
+    for (int i = 0; i < MAX_RUNS; i++) {
+        OutputCapture *capture = manager->captures[i];
+        if (capture == NULL) continue;
+
+        // Check before draining so the bytes written before EOF are included
+        bool readerDone = atomic_load_explicit(&capture->readerDone, memory_order_acquire);
+        drainOutputCapture(capture);
+
+        if (readerDone && capture->processExited && capture != manager->shownCapture) {
+            if (capture->readerStarted) {
+                joinThread(capture->reader);
+            }
+            destroyOutputCapture(capture);
+            manager->captures[i] = NULL;
+        }
+    }
+}
+
+// Switch the console panel to another capture (NULL hides the panel)
+void showOutputCapture(RunManager *manager, OutputCapture *capture) {
+    manager->shownCapture = capture;
+}
+
+// Take a free run slot, returns -1 when the table is full
+int allocateRunSlot(RunManager *manager) {
+    for (int i = 0; i < MAX_RUNS; i++) {
+        if (!manager->runs[i].active) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Launch a script as a new run, returns the run slot (-1 on failure)
+int startScriptRun(RunManager *manager, ScriptIndex *index, int fileIndex, RunMode mode) {
+    FileItem *files = index->files;
+    int slot = allocateRunSlot(manager);
+    if (slot < 0) {
+        printf("[RUN] All %d run slots busy, ignoring launch of %s\n", MAX_RUNS, files[fileIndex].displayName);
+        return -1;
+    }
+
+    ScriptRun *run = &manager->runs[slot];
+    memset(run, 0, sizeof(*run));
+
+    if (mode == RUN_MODE_CAPTURE || mode == RUN_MODE_WARM) {
+        run->capture = createOutputCapture(files[fileIndex].displayName);
+        if (run->capture != NULL && !addOutputCapture(manager, run->capture)) {
+            destroyOutputCapture(run->capture);
+            run->capture = NULL;
+        }
+        if (run->capture == NULL) {
+            printf("[RUN] No capture available for %s\n", files[fileIndex].displayName);
+            return -1;
+        }
+    }
+
+    ScriptRunInfo *info = takeRunInfo(index, &files[fileIndex]);
+    if (info == NULL) {
+        printf("[RUN] Out of memory tracking %s\n", files[fileIndex].displayName);
+        if (run->capture != NULL) {
+            run->capture->processExited = true;
+            atomic_store(&run->capture->readerDone, true);
+        }
+        return -1;
+    }
+
+    double launchTime = getMonotonicSeconds();
+    getFilePath(index, &files[fileIndex], run->filePath, sizeof(run->filePath));
+    run->pid = executeFileContent(run->filePath, mode, &run->processHandle, &run->jobHandle, run->capture);
+    if (run->pid == 0) {
+        if (run->capture != NULL) {
+            // Never spawned, so the capture is dropped on the next pump
+            run->capture->processExited = true;
+            atomic_store(&run->capture->readerDone, true);
+        }
+        return -1;
+    }
+
+    if (run->capture != NULL) {
+        showOutputCapture(manager, run->capture);
+    }
+
+    run->active = true;
+    run->mode = mode;
+    run->fileIndex = fileIndex;
+    run->startTime = launchTime;
+    run->timeoutSeconds = files[fileIndex].timeoutSeconds;
+    info->pid = run->pid;
+    info->activeRuns++;
+    refreshRunState(info);
+
+    printf("[RUN] Started %s as pid %ld in %.2f ms\n", files[fileIndex].displayName, (long)run->pid,
+           (getMonotonicSeconds() - launchTime) * 1000.0);
+    return slot;
+}
+
+// List a child started by a pool worker, the worker keeps waiting for it
+int trackPoolRun(RunManager *manager, ScriptIndex *index, int fileIndex, const RunEvent *event) {
+    FileItem *files = index->files;
+    int fileCount = index->count;
+    int slot = allocateRunSlot(manager);
+    if (slot < 0) {
+        return -1;
+    }
+
+    ScriptRun *run = &manager->runs[slot];
+    memset(run, 0, sizeof(*run));
+    run->active = true;
+    run->ownedByPool = true;
+    run->jobId = event->jobId;
+    run->pid = event->pid;
+    run->capture = event->capture;
+    run->mode = event->mode;
+    run->jobHandle = event->jobHandle;
+    run->fileIndex = fileIndex;
+    run->startTime = getMonotonicSeconds();
+    snprintf(run->filePath, sizeof(run->filePath), "%s", event->filePath);
+
+    ScriptRunInfo *info = fileIndex >= 0 && fileIndex < fileCount ? takeRunInfo(index, &files[fileIndex]) : NULL;
+    if (info != NULL) {
+        run->timeoutSeconds = files[fileIndex].timeoutSeconds;
+        info->pid = run->pid;
+        info->activeRuns++;
+        refreshRunState(info);
+    }
+    return slot;
+}
+
+// Track a helper child (folder opener) only so it gets reaped
+void trackHelperProcess(RunManager *manager, ProcessId pid) {
+    int slot = allocateRunSlot(manager);
+    if (pid == 0 || slot < 0) {
+        return;
+    }
+
+    ScriptRun *run = &manager->runs[slot];
+    memset(run, 0, sizeof(*run));
+    run->active = true;
+    run->pid = pid;
+    run->fileIndex = -1;
+}
+
+// Release a finished run, recording its result on the entry when one is given
+void finishScriptRun(RunManager *manager, int slot, ScriptIndex *index, const RunResult *result) {
+    ScriptRun *run = &manager->runs[slot];
+
+#ifdef PLATFORM_WINDOWS
+    if (run->processHandle != NULL) {
+        CloseHandle(run->processHandle);
+        run->processHandle = NULL;
+    }
+    if (run->jobHandle != NULL) {
+        CloseHandle(run->jobHandle);
+        run->jobHandle = NULL;
+    }
+#endif
+
+    // The file list may have been reloaded since launch, so match on path
+    int fileIndex = run->filePath[0] != '\0' ? findFileByPath(index, run->filePath, run->fileIndex) : -1;
+    ScriptRunInfo *info = fileIndex >= 0 ? takeRunInfo(index, &index->files[fileIndex]) : NULL;
+    if (info != NULL) {
+        if (info->pid == run->pid) {
+            info->pid = 0;
+        }
+        if (info->activeRuns > 0) info->activeRuns--;
+        if (run->cancelRequested && info->stoppingRuns > 0) info->stoppingRuns--;
+        if (result != NULL) {
+            RunResult finalResult = *result;
+            finalResult.cancelled = run->cancelRequested;
+            finalResult.timedOut = run->timedOut;
+            recordRunResult(manager, &index->files[fileIndex], info, &finalResult, run->mode);
+        }
+        refreshRunState(info);
+    }
+
+    // The capture lives on until its reader drains the pipe
+    if (run->capture != NULL) {
+        run->capture->processExited = true;
+        run->capture = NULL;
+    }
+
+#ifndef PLATFORM_WINDOWS
+    // Children that ignored SIGTERM keep the group (and its id) alive, they still get the SIGKILL
+    if (run->cancelRequested && !run->killSent && kill(-run->pid, 0) == 0) {
+        for (int i = 0; i < MAX_RUNS; i++) {
+            if (manager->lingeringGroups[i] == 0) {
+                manager->lingeringGroups[i] = run->pid;
+                manager->lingeringDeadlines[i] = run->cancelTime + CANCEL_GRACE_SECONDS;
+                break;
+            }
+        }
+    }
+#endif
+
+    run->active = false;
+    run->pid = 0;
+}
+
+// Reap finished children the UI owns and clean up their runs
+void pollScriptRuns(RunManager *manager, ScriptIndex *index) {
+    for (int i = 0; i < MAX_RUNS; i++) {
+        ScriptRun *run = &manager->runs[i];
+        // Pool workers block on their own children, reaping those here would steal the exit code
+        if (!run->active || run->ownedByPool) continue;
+
+        RunResult result;
+        if (collectProcessResult(run->pid, run->processHandle, false, &result)) {
+            result.wallSeconds = getMonotonicSeconds() - run->startTime;
+            finishScriptRun(manager, i, index, &result);
+        }
+    }
+}
+
+// Signal a run's whole process tree, Windows has no SIGTERM so its job is terminated outright
+void signalRunTree(ScriptRun *run, bool force) {
+#ifdef PLATFORM_WINDOWS
+    (void)force;
+    if (run->jobHandle != NULL) {
+        TerminateJobObject(run->jobHandle, 1);
+    } else if (run->processHandle != NULL) {
+        TerminateProcess(run->processHandle, 1);
+    } else {
+        HANDLE process = OpenProcess(PROCESS_TERMINATE, FALSE, run->pid);
+        if (process != NULL) {
+            TerminateProcess(process, 1);
+            CloseHandle(process);
+        }
+    }
+#else
+    // The child leads its group, so this reaches everything it started that did not detach
+    if (kill(-run->pid, force ? SIGKILL : SIGTERM) == -1 && errno == ESRCH) {
+        kill(run->pid, force ? SIGKILL : SIGTERM);
+    }
+#endif
+}
+
+// Ask a run to stop: SIGTERM now, SIGKILL once the grace period is over
+void cancelScriptRun(RunManager *manager, int slot, ScriptIndex *index, bool timedOut) {
+    ScriptRun *run = &manager->runs[slot];
+    if (!run->active || run->cancelRequested || run->pid == 0) {
+        return;
+    }
+
+    run->cancelRequested = true;
+    run->timedOut = timedOut;
+    run->cancelTime = getMonotonicSeconds();
+    signalRunTree(run, false);
+    printf("[RUN] %s pid %ld (%s)\n", timedOut ? "Timed out" : "Cancelled", (long)run->pid, run->filePath);
+
+    int fileIndex = run->filePath[0] != '\0' ? findFileByPath(index, run->filePath, run->fileIndex) : -1;
+    ScriptRunInfo *info = fileIndex >= 0 ? takeRunInfo(index, &index->files[fileIndex]) : NULL;
+    if (info != NULL) {
+        info->stoppingRuns++;
+        refreshRunState(info);
+    }
+}
+
+// Cancel every live run started from an entry
+void cancelFileRuns(RunManager *manager, ScriptIndex *index, int fileIndex) {
+    for (int i = 0; i < MAX_RUNS; i++) {
+        ScriptRun *run = &manager->runs[i];
+        if (run->active && fileHasPath(index, &index->files[fileIndex], run->filePath)) {
+            cancelScriptRun(manager, i, index, false);
+        }
+    }
+}
+
+// Cancel runs past their timeout and force-kill cancelled runs that outlived the grace period
+void enforceRunDeadlines(RunManager *manager, ScriptIndex *index) {
+    double now = getMonotonicSeconds();
+    for (int i = 0; i < MAX_RUNS; i++) {
+        ScriptRun *run = &manager->runs[i];
+        if (!run->active) continue;
+
+        if (!run->cancelRequested && run->timeoutSeconds > 0 && now - run->startTime > run->timeoutSeconds) {
+            cancelScriptRun(manager, i, index, true);
+        } else if (run->cancelRequested && !run->killSent && now - run->cancelTime > CANCEL_GRACE_SECONDS) {
+            run->killSent = true;
+            signalRunTree(run, true);
+            printf("[RUN] Killed pid %ld after %.0fs grace\n", (long)run->pid, CANCEL_GRACE_SECONDS);
+        }
+    }
+
+#ifndef PLATFORM_WINDOWS
+    for (int i = 0; i < MAX_RUNS; i++) {
+        if (manager->lingeringGroups[i] != 0 && now > manager->lingeringDeadlines[i]) {
+            kill(-manager->lingeringGroups[i], SIGKILL);
+            printf("[RUN] Killed leftover process group %ld\n", (long)manager->lingeringGroups[i]);
+            manager->lingeringGroups[i] = 0;
+        }
+    }
+#endif
+}
+
+// Release run handles when the app exits (children keep running)
+void shutdownRunManager(RunManager *manager) {
+#ifdef PLATFORM_WINDOWS
+    for (int i = 0; i < MAX_RUNS; i++) {
+        if (manager->runs[i].processHandle != NULL) {
+            CloseHandle(manager->runs[i].processHandle);
+        }
+        if (manager->runs[i].jobHandle != NULL) {
+            CloseHandle(manager->runs[i].jobHandle);
+        }
+    }
+#endif
+    memset(manager, 0, sizeof(*manager));
+}
+
+// Allocate event cells, capacity must be a power of two
+bool initRunEventQueue(RunEventQueue *queue, size_t capacity) {
+    queue->cells = (RunEventCell*)malloc(capacity * sizeof(RunEventCell));
+    if (queue->cells == NULL) {
+        return false;
+    }
+    for (size_t i = 0; i < capacity; i++) {
+        atomic_init(&queue->cells[i].sequence, i);
+    }
+    queue->mask = capacity - 1;
+    atomic_init(&queue->enqueuePos, 0);
+    atomic_init(&queue->dequeuePos, 0);
+    return true;
+}
+
+// Any thread: returns false when the queue is full
+bool tryPushRunEvent(RunEventQueue *queue, const RunEvent *event) {
+    size_t pos = atomic_load_explicit(&queue->enqueuePos, memory_order_relaxed);
+    RunEventCell *cell;
+
+    for (;;) {
+        cell = &queue->cells[pos & queue->mask];
+        size_t sequence = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&queue->enqueuePos, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return false;
+        } else {
+            pos = atomic_load_explicit(&queue->enqueuePos, memory_order_relaxed);
+        }
+    }
+
+    cell->event = *event;
+    atomic_store_explicit(&cell->sequence, pos + 1, memory_order_release);
+    return true;
+}
+
+// Workers never drop events, they wait for the UI to drain the queue
+void pushRunEvent(RunEventQueue *queue, const RunEvent *event) {
+    while (!tryPushRunEvent(queue, event)) {
+        sleepBriefly();
+    }
+}
+
+// UI thread: returns false when the queue is empty
+bool popRunEvent(RunEventQueue *queue, RunEvent *event) {
+    size_t pos = atomic_load_explicit(&queue->dequeuePos, memory_order_relaxed);
+    RunEventCell *cell;
+
+    for (;;) {
+        cell = &queue->cells[pos & queue->mask];
+        size_t sequence = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        intptr_t diff = (intptr_t)sequence - (intptr_t)(pos + 1);
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&queue->dequeuePos, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return false;
+        } else {
+            pos = atomic_load_explicit(&queue->dequeuePos, memory_order_relaxed);
+        }
+    }
+
+    *event = cell->event;
+    atomic_store_explicit(&cell->sequence, pos + queue->mask + 1, memory_order_release);
+    return true;
+}
+
+// Block until the child exits and collect its result, wall time is measured from startTime
+void waitForProcess(ProcessId pid, void *processHandle, double startTime, RunResult *result) {
+    collectProcessResult(pid, processHandle, true, result);
+    result->wallSeconds = getMonotonicSeconds() - startTime;
+#ifdef PLATFORM_WINDOWS
+    CloseHandle((HANDLE)processHandle);
+#endif
+}
+
+// Worker thread: take jobs while under the concurrency cap, run each to completion
+void *poolWorkerThread(void *arg) {
+    WorkerPool *pool = (WorkerPool*)arg;
+
+    for (;;) {
+        lockMutex(&pool->lock);
+        while (!pool->shuttingDown && (pool->jobCount == 0 || pool->running >= pool->concurrencyCap)) {
+            waitCondVar(&pool->wake, &pool->lock);
+        }
+        if (pool->shuttingDown) {
+            unlockMutex(&pool->lock);
+            break;
+        }
+        PoolJob job = pool->jobs[pool->jobHead];
+        pool->jobHead = (pool->jobHead + 1) % pool->jobCapacity;
+        pool->jobCount--;
+        pool->running++;
+        unlockMutex(&pool->lock);
+
+        RunEvent event = {0};
+        event.jobId = job.jobId;
+        event.capture = job.capture;
+        event.mode = job.mode;
+        snprintf(event.filePath, sizeof(event.filePath), "%s", job.filePath);
+
+        void *processHandle = NULL;
+        double startTime = getMonotonicSeconds();
+        ProcessId pid = executeFileContent(job.filePath, job.mode, &processHandle, &event.jobHandle, job.capture);
+
+        if (pid != 0) {
+            event.type = RUN_EVENT_STARTED;
+            event.pid = pid;
+            pushRunEvent(&pool->events, &event);
+            waitForProcess(pid, processHandle, startTime, &event.result);
+        } else {
+            event.result.exitCode = -1;
+        }
+
+        event.type = RUN_EVENT_FINISHED;
+        pushRunEvent(&pool->events, &event);
+
+        lockMutex(&pool->lock);
+        pool->running--;
+        broadcastCondVar(&pool->wake);
+        unlockMutex(&pool->lock);
+    }
+
+    return NULL;
+}
+
+// Initialize worker pool, threads are started lazily as the cap allows
+bool initWorkerPool(WorkerPool *pool, int concurrencyCap) {
+    memset(pool, 0, sizeof(*pool));
+    initMutex(&pool->lock);
+    initCondVar(&pool->wake);
+    pool->concurrencyCap = concurrencyCap;
+    pool->nextJobId = 1;
+    return initRunEventQueue(&pool->events, RUN_EVENT_QUEUE_SIZE);
+}
+
+// Change how many jobs may run at once, extra workers are created on demand
+void setPoolConcurrency(WorkerPool *pool, int concurrencyCap) {
+    if (concurrencyCap < 1) concurrencyCap = 1;
+    if (concurrencyCap > MAX_POOL_WORKERS) concurrencyCap = MAX_POOL_WORKERS;
+
+    lockMutex(&pool->lock);
+    pool->concurrencyCap = concurrencyCap;
+    while (pool->threadCount < concurrencyCap && pool->jobCount > 0) {
+        if (!startThread(&pool->threads[pool->threadCount], poolWorkerThread, pool)) break;
+        pool->threadCount++;
+    }
+    broadcastCondVar(&pool->wake);
+    unlockMutex(&pool->lock);
+}
+
+// Queue a script for the pool, returns the job id (0 on failure)
+int submitPoolJob(WorkerPool *pool, const char *filePath, RunMode mode, OutputCapture *capture) {
+    lockMutex(&pool->lock);
+
+    if (pool->jobCount == pool->jobCapacity) {
+        int newCapacity = pool->jobCapacity ? pool->jobCapacity * 2 : 64;
+        PoolJob *newJobs = (PoolJob*)malloc(newCapacity * sizeof(PoolJob));
+        if (newJobs == NULL) {
+            unlockMutex(&pool->lock);
+            return 0;
+        }
+        for (int i = 0; i < pool->jobCount; i++) {
+            newJobs[i] = pool->jobs[(pool->jobHead + i) % pool->jobCapacity];
+        }
+        free(pool->jobs);
+        pool->jobs = newJobs;
+        pool->jobHead = 0;
+        pool->jobCapacity = newCapacity;
+    }
+
+    PoolJob *job = &pool->jobs[(pool->jobHead + pool->jobCount) % pool->jobCapacity];
+    job->jobId = pool->nextJobId++;
+    job->mode = mode;
+    job->capture = capture;
+    snprintf(job->filePath, sizeof(job->filePath), "%s", filePath);
+    pool->jobCount++;
+
+    if (pool->threadCount < pool->concurrencyCap && pool->threadCount < pool->jobCount + pool->running) {
+        if (startThread(&pool->threads[pool->threadCount], poolWorkerThread, pool)) {
+            pool->threadCount++;
+        }
+    }
+
+    int jobId = job->jobId;
+    broadcastCondVar(&pool->wake);
+    unlockMutex(&pool->lock);
+    return jobId;
+}
+
+// Stop taking jobs; workers still waiting on a child are left to finish with the process
+void shutdownWorkerPool(WorkerPool *pool) {
+    lockMutex(&pool->lock);
+    pool->shuttingDown = true;
+    pool->jobCount = 0;
+    broadcastCondVar(&pool->wake);
+    unlockMutex(&pool->lock);
+}
+
+// Queue every selected script on the worker pool, returns how many were queued
+int runSelectedScripts(WorkerPool *pool, RunManager *manager, ScriptIndex *index, RunMode mode) {
+    FileItem *files = index->files;
+    int fileCount = index->count;
+    int queued = 0;
+
+    for (int i = 0; i < fileCount; i++) {
+        if (!files[i].isSelected) continue;
+
+        OutputCapture *capture = NULL;
+        if (mode == RUN_MODE_CAPTURE || mode == RUN_MODE_WARM) {
+            capture = createOutputCapture(files[i].displayName);
+            if (capture != NULL && !addOutputCapture(manager, capture)) {
+                destroyOutputCapture(capture);
+                capture = NULL;
+            }
+            if (capture == NULL) {
+                printf("[POOL] No capture available for %s, skipping\n", files[i].displayName);
+                continue;
+            }
+        }
+
+        ScriptRunInfo *info = takeRunInfo(index, &files[i]);
+        char filePath[1024];
+        getFilePath(index, &files[i], filePath, sizeof(filePath));
+        if (info == NULL || submitPoolJob(pool, filePath, mode, capture) == 0) {
+            if (capture != NULL) {
+                capture->processExited = true;
+                atomic_store(&capture->readerDone, true);
+            }
+            continue;
+        }
+
+        info->queuedRuns++;
+        refreshRunState(info);
+        queued++;
+    }
+
+    printf("[POOL] Queued %d scripts (max %d at once)\n", queued, pool->concurrencyCap);
+    return queued;
+}
+
+// Apply worker start/finish events to the run table and file states
+void processRunEvents(WorkerPool *pool, RunManager *manager, ScriptIndex *index) {
+    FileItem *files = index->files;
+    RunEvent event;
+
+    while (popRunEvent(&pool->events, &event)) {
+        int fileIndex = findIndexedPath(index, event.filePath);
+        // Taken up front, so trackPoolRun finds it in place instead of growing the table under it
+        ScriptRunInfo *info = fileIndex >= 0 ? takeRunInfo(index, &files[fileIndex]) : NULL;
+
+        if (event.type == RUN_EVENT_STARTED) {
+            if (info != NULL && info->queuedRuns > 0) {
+                info->queuedRuns--;
+            }
+            if (trackPoolRun(manager, index, fileIndex, &event) < 0) {
+                // Table full: the worker still reports the finish, it just isn't listed
+                if (info != NULL) info->activeRuns++;
+#ifdef PLATFORM_WINDOWS
+                if (event.jobHandle != NULL) CloseHandle(event.jobHandle);
+#endif
+            }
+            if (event.capture != NULL) {
+                showOutputCapture(manager, event.capture);
+            }
+            printf("[POOL] Job %d started %s as pid %ld\n", event.jobId, event.filePath, (long)event.pid);
+        } else {
+            int slot = -1;
+            for (int i = 0; i < MAX_RUNS; i++) {
+                if (manager->runs[i].active && manager->runs[i].ownedByPool && manager->runs[i].jobId == event.jobId) {
+                    slot = i;
+                    break;
+                }
+            }
+
+            if (slot >= 0) {
+                finishScriptRun(manager, slot, index, &event.result);
+            } else if (event.pid != 0) {
+                if (info != NULL && info->activeRuns > 0) info->activeRuns--;
+                if (info != NULL) recordRunResult(manager, &files[fileIndex], info, &event.result, event.mode);
+            } else {
+                // Launch failed before STARTED
+                if (info != NULL && info->queuedRuns > 0) info->queuedRuns--;
+                if (event.capture != NULL) {
+                    event.capture->processExited = true;
+                    atomic_store(&event.capture->readerDone, true);
+                }
+            }
+            // finishScriptRun may have grown the table
+            if (fileIndex >= 0 && files[fileIndex].runInfo >= 0) {
+                refreshRunState(&index->runInfo[files[fileIndex].runInfo]);
+            }
+            printf("[POOL] Job %d finished %s with exit code %d\n", event.jobId, event.filePath, event.result.exitCode);
+        }
+    }
+}
+
+// Owner side: push a ready node onto the bottom of a worker's deque
+void pushWork(Pipeline *pipeline, int workerIndex, int node) {
+    WorkDeque *deque = &pipeline->deques[workerIndex];
+    lockMutex(&deque->lock);
+    deque->items[deque->bottom++] = node;
+    unlockMutex(&deque->lock);
+
+    lockMutex(&pipeline->idleLock);
+    atomic_fetch_add(&pipeline->readyCount, 1);
+    broadcastCondVar(&pipeline->idleWake);
+    unlockMutex(&pipeline->idleLock);
+}
+
+// Owner pops the newest node (depth first), thieves take the oldest, -1 when empty
+int takeWork(WorkDeque *deque, bool steal) {
+    int node = -1;
+    lockMutex(&deque->lock);
+    if (deque->bottom > deque->top) {
+        node = steal ? deque->items[deque->top++] : deque->items[--deque->bottom];
+    }
+    unlockMutex(&deque->lock);
+    return node;
+}
+
+// Run one node to completion and release the dependents it was blocking
+void runPipelineNode(Pipeline *pipeline, int workerIndex, int nodeIndex) {
+    PipelineNode *node = &pipeline->nodes[nodeIndex];
+
+    RunEvent event = {0};
+    event.jobId = node->jobId;
+    event.capture = node->capture;
+    event.mode = node->mode;
+    snprintf(event.filePath, sizeof(event.filePath), "%s", node->filePath);
+
+    if (atomic_load(&node->dependencyFailed)) {
+        atomic_store(&node->state, NODE_SKIPPED);
+        node->result.exitCode = -1;
+    } else {
+        // Wait for a run slot of the pool, the same ones batch jobs take
+        WorkerPool *pool = pipeline->pool;
+        lockMutex(&pool->lock);
+        while (!pool->shuttingDown && pool->running >= pool->concurrencyCap) {
+            waitCondVar(&pool->wake, &pool->lock);
+        }
+        pool->running++;
+        unlockMutex(&pool->lock);
+
+        atomic_store(&node->state, NODE_RUNNING);
+        node->startTime = getMonotonicSeconds();
+
+        void *processHandle = NULL;
+        ProcessId pid = executeFileContent(node->filePath, node->mode, &processHandle, &event.jobHandle, node->capture);
+        if (pid != 0) {
+            event.type = RUN_EVENT_STARTED;
+            event.pid = pid;
+            pushRunEvent(pipeline->events, &event);
+            waitForProcess(pid, processHandle, node->startTime, &node->result);
+        } else {
+            node->result.exitCode = -1;
+        }
+
+        node->endTime = getMonotonicSeconds();
+        lockMutex(&pool->lock);
+        pool->running--;
+        broadcastCondVar(&pool->wake);
+        unlockMutex(&pool->lock);
+        atomic_store(&node->state, node->result.exitCode == 0 ? NODE_SUCCEEDED : NODE_FAILED);
+    }
+
+    event.type = RUN_EVENT_FINISHED;
+    event.result = node->result;
+    pushRunEvent(pipeline->events, &event);
+
+    bool succeeded = atomic_load(&node->state) == NODE_SUCCEEDED;
+    for (int i = 0; i < node->dependentCount; i++) {
+        PipelineNode *dependent = &pipeline->nodes[node->dependents[i]];
+        if (!succeeded) {
+            atomic_store(&dependent->dependencyFailed, true);
+        }
+        if (atomic_fetch_sub(&dependent->remaining, 1) == 1) {
+            pushWork(pipeline, workerIndex, node->dependents[i]);
+        }
+    }
+
+    lockMutex(&pipeline->idleLock);
+    if (atomic_fetch_add(&pipeline->doneCount, 1) + 1 == pipeline->nodeCount) {
+        atomic_store(&pipeline->finished, true);
+    }
+    broadcastCondVar(&pipeline->idleWake);
+    unlockMutex(&pipeline->idleLock);
+}
+
+// Pipeline worker: drain own deque, then steal from the others, sleep when nothing is ready
+void *pipelineWorkerThread(void *arg) {
+    PipelineWorker *worker = (PipelineWorker*)arg;
+    Pipeline *pipeline = worker->pipeline;
+
+    for (;;) {
+        int workerCount = atomic_load(&pipeline->workerCount);
+        int node = takeWork(&pipeline->deques[worker->workerIndex], false);
+        for (int k = 1; node < 0 && k < workerCount; k++) {
+            node = takeWork(&pipeline->deques[(worker->workerIndex + k) % workerCount], true);
+        }
+
+        if (node >= 0) {
+            atomic_fetch_sub(&pipeline->readyCount, 1);
+            runPipelineNode(pipeline, worker->workerIndex, node);
+            continue;
+        }
+
+        lockMutex(&pipeline->idleLock);
+        while (atomic_load(&pipeline->readyCount) == 0 && !atomic_load(&pipeline->finished)) {
+            waitCondVar(&pipeline->idleWake, &pipeline->idleLock);
+        }
+        bool finished = atomic_load(&pipeline->finished);
+        unlockMutex(&pipeline->idleLock);
+        if (finished) break;
+    }
+
+    return NULL;
+}
+
+// Modification time of a stat result in nanoseconds (whole seconds on Windows)
+int64_t getModifiedTime(const struct stat *info) {
+#ifdef PLATFORM_WINDOWS
+    return (int64_t)info->st_mtime * 1000000000;
+#else
+    return (int64_t)info->st_mtim.tv_sec * 1000000000 + info->st_mtim.tv_nsec;
+#endif
+}
+
+// Read "kort:key=value" header comments (e.g. "REM kort:after=setup-env") from the top of a script
+// Returns false only when the file no longer exists, an unreadable script is still listed
+bool parseScriptMetadata(const char *filePath, ScriptMetadata *metadata) {
+    metadata->dependsOn[0] = '\0';
+    metadata->timeoutSeconds = 0;
+    metadata->modifiedTime = 0;
+    metadata->fileSize = 0;
+    metadata->isDirectory = false;
+
+    struct stat info;
+    if (stat(filePath, &info) != 0) {
+        return errno != ENOENT;
+    }
+    metadata->modifiedTime = getModifiedTime(&info);
+    metadata->fileSize = (int64_t)info.st_size;
+    if (S_ISDIR(info.st_mode)) {
+        metadata->isDirectory = true;
+        return true;
+    }
+
+    FILE *script = fopen(filePath, "r");
+    if (script == NULL) {
+        return true;
+    }
+
+    char line[512];
+    for (int lineNumber = 0; lineNumber < METADATA_SCAN_LINES && fgets(line, sizeof(line), script); lineNumber++) {
+        // "kort:timeout=90", "kort:timeout=5m" or "kort:timeout=1h"
+        const char *timeout = strstr(line, "kort:timeout=");
+        if (timeout != NULL) {
+            char *unit = NULL;
+            double value = strtod(timeout + strlen("kort:timeout="), &unit);
+            if (*unit == 'm') value *= 60.0;
+            else if (*unit == 'h') value *= 3600.0;
+            metadata->timeoutSeconds = value > 0 ? value : 0;
+        }
+
+        const char *after = strstr(line, "kort:after=");
+        if (after == NULL) continue;
+        after += strlen("kort:after=");
+
+        // Several after= lines accumulate into one comma separated list
+        size_t used = strlen(metadata->dependsOn);
+        if (used > 0 && metadata->dependsOn[used - 1] != ',') {
+            metadata->dependsOn[used++] = ',';
+        }
+        for (const char *c = after; *c != '\0' && *c != '\n' && *c != '\r' && used < sizeof(metadata->dependsOn) - 1; c++) {
+            if (*c != ' ' && *c != '\t') {
+                metadata->dependsOn[used++] = *c;
+            }
+        }
+        metadata->dependsOn[used] = '\0';
+    }
+
+    fclose(script);
+    return true;
+}
+
+// Find a script by display name, -1 when there is none
+int findFileByName(FileItem *files, int fileCount, const char *name) {
+    for (int i = 0; i < fileCount; i++) {
+        if (strcmp(files[i].displayName, name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Find the script a relative name refers to on disk, so folders that are not listed count too:
+// "client/deploy.sh" is that file, "client/deploy" the script with that display name in client/.
+// Writes its relative path into fileName, returns how many scripts match (more than 1 is ambiguous)
+int resolveScriptPath(const char *scriptDir, const char *name, char *fileName, size_t fileNameSize) {
+    const char *slash = strrchr(name, '/');
+    const char *baseName = slash != NULL ? slash + 1 : name;
+    int folderLength = slash != NULL ? (int)(slash - name) : 0;
+    if (baseName[0] == '\0' || name[0] == '/' || strcmp(name, "..") == 0 || strncmp(name, "../", 3) == 0 ||
+        strstr(name, "/../") != NULL || strcmp(baseName, "..") == 0) {
+        return 0;
+    }
+
+    char path[PATH_MAX];
+    struct stat info;
+    if ((size_t)snprintf(path, sizeof(path), "%s/%s", scriptDir, name) >= sizeof(path)) {
+        return 0;
+    }
+    if (stat(path, &info) == 0 && !S_ISDIR(info.st_mode)) {
+        snprintf(fileName, fileNameSize, "%s", name);
+        return 1;
+    }
+    // A display name ends at the first dot, so one with a dot can only be a file name
+    if (strchr(baseName, '.') != NULL) {
+        return 0;
+    }
+
+    snprintf(path, sizeof(path), "%s/%.*s", scriptDir, folderLength, name);
+    DIR *dir = opendir(path);
+    if (dir == NULL) {
+        return 0;
+    }
+    size_t baseLength = strlen(baseName);
+    int matches = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir))) {
+        if (strncmp(entry->d_name, baseName, baseLength) != 0 || entry->d_name[baseLength] != '.') continue;
+        char entryPath[PATH_MAX];
+        if ((size_t)snprintf(entryPath, sizeof(entryPath), "%s/%s", path, entry->d_name) >= sizeof(entryPath) ||
+            stat(entryPath, &info) != 0 || S_ISDIR(info.st_mode)) continue;
+        if (matches++ == 0) {
+            snprintf(fileName, fileNameSize, folderLength > 0 ? "%.*s/%s" : "%.*s%s", folderLength, name, entry->d_name);
+        }
+    }
+    closedir(dir);
+    return matches;
+}
+
+// Find a script by display or file name among the entries of a listed folder, returns how many match
+int findFolderScript(const ScriptIndex *index, int folderId, const char *name, int *fileIndex) {
+    const ScriptFolder *folder = &index->folders[folderId];
+    int matches = 0;
+    for (int i = 0; i < folder->fileCount; i++) {
+        const FileItem *file = &index->files[folder->files[i]];
+        const char *slash = strrchr(file->fileName, '/');
+        if (strcmp(slash != NULL ? slash + 1 : file->fileName, name) == 0) {
+            *fileIndex = folder->files[i];
+            return 1;
+        }
+        if (strcmp(file->displayName, name) == 0 && matches++ == 0) {
+            *fileIndex = folder->files[i];
+        }
+    }
+    return matches;
+}
+
+// Resolve a "kort:after=" name of the script at fromName (a relative path, fromFile its entry or -1) to the
+// dependency's relative path. A bare name is looked up in the script's own folder, then at the top level; a
+// name with a folder in it is a path from the top level. Listed folders are searched in memory and the rest
+// on disk, so the result does not depend on what is expanded. Returns how many scripts match, 1 unless the
+// name is unknown (0) or ambiguous
+int findDependency(const ScriptIndex *index, int fromFile, const char *fromName, const char *name, char *fileName,
+                   size_t fileNameSize) {
+    if (strchr(name, '/') != NULL) {
+        return resolveScriptPath(index->scriptDir, name, fileName, fileNameSize);
+    }
+
+    int fileIndex = -1;
+    int matches = 0;
+    const char *slash = strrchr(fromName, '/');
+    if (fromFile >= 0) {
+        matches = findFolderScript(index, index->files[fromFile].folder, name, &fileIndex);
+    } else if (slash != NULL) {
+        char sibling[PATH_MAX];
+        if ((size_t)snprintf(sibling, sizeof(sibling), "%.*s/%s", (int)(slash - fromName), fromName, name) < sizeof(sibling)) {
+            matches = resolveScriptPath(index->scriptDir, sibling, fileName, fileNameSize);
+        }
+        if (matches > 0) return matches;
+    }
+    if (matches == 0 && (fromFile < 0 || index->files[fromFile].folder != 0)) {
+        matches = findFolderScript(index, 0, name, &fileIndex);
+    }
+    if (matches == 0) {
+        // Not applied to the index yet, e.g. created while the startup scan runs
+        return resolveScriptPath(index->scriptDir, name, fileName, fileNameSize);
+    }
+    snprintf(fileName, fileNameSize, "%s", index->files[fileIndex].fileName);
+    return matches;
+}
+
+// Drop the captures of a pipeline that never started, they go on the next pump
+void releasePipelineCaptures(Pipeline *pipeline) {
+    for (int i = 0; pipeline->nodes != NULL && i < pipeline->nodeCount; i++) {
+        OutputCapture *capture = pipeline->nodes[i].capture;
+        if (capture != NULL) {
+            capture->processExited = true;
+            atomic_store(&capture->readerDone, true);
+            pipeline->nodes[i].capture = NULL;
+        }
+    }
+}
+
+// Free pipeline nodes and deques (threads must already be joined)
+void freePipeline(Pipeline *pipeline) {
+    for (int i = 0; pipeline->nodes != NULL && i < pipeline->nodeCount; i++) {
+        free(pipeline->nodes[i].dependencies);
+        free(pipeline->nodes[i].dependents);
+    }
+    // Deques of workers that failed to start are allocated too
+    for (int i = 0; i < MAX_POOL_WORKERS; i++) {
+        free(pipeline->deques[i].items);
+        pipeline->deques[i].items = NULL;
+    }
+    free(pipeline->nodes);
+    free(pipeline->topoOrder);
+    pipeline->nodes = NULL;
+    pipeline->topoOrder = NULL;
+    pipeline->nodeCount = 0;
+    atomic_store(&pipeline->workerCount, 0);
+    pipeline->active = false;
+}
+
+// Append a value to a growable int list, returns false when out of memory
+bool appendIntList(int **list, int *count, int *capacity, int value) {
+    if (*count == *capacity) {
+        int newCapacity = *capacity ? *capacity * 2 : 8;
+        int *newList = (int*)realloc(*list, newCapacity * sizeof(int));
+        if (newList == NULL) {
+            return false;
+        }
+        *list = newList;
+        *capacity = newCapacity;
+    }
+    (*list)[(*count)++] = value;
+    return true;
+}
+
+// Append a node for the script at a relative path, returns its index or -1 when out of memory
+int addPipelineNode(Pipeline *pipeline, int *capacity, const char *scriptDir, const char *fileName) {
+    if (pipeline->nodeCount == *capacity) {
+        int newCapacity = *capacity ? *capacity * 2 : 16;
+        PipelineNode *newNodes = (PipelineNode*)realloc(pipeline->nodes, newCapacity * sizeof(PipelineNode));
+        if (newNodes == NULL) {
+            return -1;
+        }
+        pipeline->nodes = newNodes;
+        *capacity = newCapacity;
+    }
+
+    PipelineNode *node = &pipeline->nodes[pipeline->nodeCount];
+    memset(node, 0, sizeof(*node));
+    snprintf(node->filePath, sizeof(node->filePath), "%s/%s", scriptDir, fileName);
+    const char *slash = strrchr(fileName, '/');
+    const char *baseName = slash != NULL ? slash + 1 : fileName;
+    snprintf(node->displayName, sizeof(node->displayName), "%.*s", (int)strcspn(baseName, "."), baseName);
+    return pipeline->nodeCount++;
+}
+
+// Start the selected scripts and everything they depend on as a DAG.
+// Returns false (with a reason in message) on unknown dependencies or cycles
+bool startPipeline(Pipeline *pipeline, WorkerPool *pool, RunManager *manager, ScriptIndex *index, RunMode mode,
+                   char *message, size_t messageSize) {
+    FileItem *files = index->files;
+    int fileCount = index->count;
+    if (pipeline->active) {
+        snprintf(message, messageSize, "Pipeline already running");
+        return false;
+    }
+
+    // Collect targets plus their transitive dependencies. A dependency in a folder that is not listed has
+    // no entry (fileOfNode -1), its header is read from disk
+    memset(pipeline, 0, sizeof(*pipeline));
+    int *nodeOfFile = (int*)malloc((fileCount > 0 ? fileCount : 1) * sizeof(int));
+    int *fileOfNode = NULL;
+    int fileOfNodeCount = 0;
+    int fileOfNodeCapacity = 0;
+    int nodeCapacity = 0;
+    bool allocated = nodeOfFile != NULL;
+    for (int i = 0; allocated && i < fileCount; i++) {
+        nodeOfFile[i] = -1;
+        if (files[i].isSelected) {
+            nodeOfFile[i] = addPipelineNode(pipeline, &nodeCapacity, index->scriptDir, files[i].fileName);
+            allocated = nodeOfFile[i] >= 0 && appendIntList(&fileOfNode, &fileOfNodeCount, &fileOfNodeCapacity, i);
+        }
+    }
+
+    // The nodes double as the work list: every added node is expanded once
+    int edgeCount = 0;
+    bool resolved = true;
+    size_t dirLength = strlen(index->scriptDir);
+    for (int n = 0; allocated && resolved && n < pipeline->nodeCount; n++) {
+        char fromName[PATH_MAX];
+        char names[256];
+        snprintf(fromName, sizeof(fromName), "%s", pipeline->nodes[n].filePath + dirLength + 1);
+        if (fileOfNode[n] >= 0) {
+            snprintf(names, sizeof(names), "%s", files[fileOfNode[n]].dependsOn);
+        } else {
+            ScriptMetadata metadata;
+            parseScriptMetadata(pipeline->nodes[n].filePath, &metadata);
+            snprintf(names, sizeof(names), "%s", metadata.dependsOn);
+        }
+
+        int dependencyCapacity = 0;
+        for (char *name = strtok(names, ","); allocated && name != NULL; name = strtok(NULL, ",")) {
+            char fileName[PATH_MAX];
+            int matches = findDependency(index, fileOfNode[n], fromName, name, fileName, sizeof(fileName));
+            if (matches != 1) {
+                snprintf(message, messageSize, "%s depends on %s script '%s'", pipeline->nodes[n].displayName,
+                         matches > 1 ? "ambiguous" : "unknown", name);
+                resolved = false;
+                break;
+            }
+
+            int fileIndex = findIndexedFile(index, fileName);
+            int dependency = fileIndex >= 0 ? nodeOfFile[fileIndex] : -1;
+            char filePath[sizeof(pipeline->nodes[0].filePath)];
+            if (fileIndex < 0 && (size_t)snprintf(filePath, sizeof(filePath), "%s/%s", index->scriptDir, fileName) < sizeof(filePath)) {
+                for (int m = 0; m < pipeline->nodeCount && dependency < 0; m++) {
+                    if (fileOfNode[m] < 0 && strcmp(pipeline->nodes[m].filePath, filePath) == 0) dependency = m;
+                }
+            }
+            if (dependency < 0) {
+                dependency = addPipelineNode(pipeline, &nodeCapacity, index->scriptDir, fileName);
+                allocated = dependency >= 0 &&
+                            appendIntList(&fileOfNode, &fileOfNodeCount, &fileOfNodeCapacity, fileIndex);
+                if (!allocated) break;
+                if (fileIndex >= 0) nodeOfFile[fileIndex] = dependency;
+            }
+
+            PipelineNode *node = &pipeline->nodes[n];
+            bool duplicate = false;
+            for (int d = 0; d < node->dependencyCount; d++) {
+                if (node->dependencies[d] == dependency) duplicate = true;
+            }
+            if (!duplicate) {
+                allocated = appendIntList(&node->dependencies, &node->dependencyCount, &dependencyCapacity, dependency);
+                edgeCount++;
+            }
+        }
+    }
+
+    int nodeCount = pipeline->nodeCount;
+    if (allocated && resolved && nodeCount == 0) {
+        snprintf(message, messageSize, "Select scripts to run as a pipeline");
+        resolved = false;
+    }
+    pipeline->topoOrder = allocated && resolved ? (int*)malloc((size_t)nodeCount * sizeof(int)) : NULL;
+    if (!allocated || (resolved && pipeline->topoOrder == NULL)) {
+        snprintf(message, messageSize, "Out of memory");
+    }
+    if (pipeline->topoOrder == NULL) {
+        freePipeline(pipeline);
+        free(nodeOfFile);
+        free(fileOfNode);
+        return false;
+    }
+
+    // Reverse edges, then Kahn's algorithm both orders the DAG and detects cycles
+    int *inDegree = (int*)calloc(nodeCount, sizeof(int));
+    allocated = inDegree != NULL;
+    for (int n = 0; n < nodeCount; n++) {
+        pipeline->nodes[n].dependents = (int*)malloc((size_t)(edgeCount > 0 ? edgeCount : 1) * sizeof(int));
+        if (pipeline->nodes[n].dependents == NULL) allocated = false;
+    }
+    if (!allocated) {
+        snprintf(message, messageSize, "Out of memory");
+        free(inDegree);
+        freePipeline(pipeline);
+        free(nodeOfFile);
+        free(fileOfNode);
+        return false;
+    }
+    for (int n = 0; n < nodeCount; n++) {
+        PipelineNode *node = &pipeline->nodes[n];
+        inDegree[n] = node->dependencyCount;
+        for (int d = 0; d < node->dependencyCount; d++) {
+            PipelineNode *dependency = &pipeline->nodes[node->dependencies[d]];
+            dependency->dependents[dependency->dependentCount++] = n;
+        }
+    }
+
+    int ordered = 0;
+    for (int n = 0; n < nodeCount; n++) {
+        if (inDegree[n] == 0) pipeline->topoOrder[ordered++] = n;
+    }
+    for (int i = 0; i < ordered; i++) {
+        PipelineNode *node = &pipeline->nodes[pipeline->topoOrder[i]];
+        for (int d = 0; d < node->dependentCount; d++) {
+            if (--inDegree[node->dependents[d]] == 0) {
+                pipeline->topoOrder[ordered++] = node->dependents[d];
+            }
+        }
+    }
+
+    if (ordered < nodeCount) {
+        // Nodes Kahn's algorithm never released sit on (or behind) a cycle
+        for (int n = 0; n < nodeCount; n++) {
+            if (inDegree[n] > 0) {
+                snprintf(message, messageSize, "Dependency cycle through '%s'", pipeline->nodes[n].displayName);
+                break;
+            }
+        }
+        free(inDegree);
+        freePipeline(pipeline);
+        free(nodeOfFile);
+        free(fileOfNode);
+        return false;
+    }
+    free(inDegree);
+
+    // Nodes always run captured: a terminal run only ends when its prompt is closed, and its exit
+    // code is the terminal's. Without a console slot for every node the pipeline does not start
+    RunMode nodeMode = mode == RUN_MODE_WARM ? RUN_MODE_WARM : RUN_MODE_CAPTURE;
+    for (int n = 0; n < nodeCount; n++) {
+        PipelineNode *node = &pipeline->nodes[n];
+        node->mode = nodeMode;
+        node->capture = createOutputCapture(node->displayName);
+        if (node->capture != NULL && !addOutputCapture(manager, node->capture)) {
+            destroyOutputCapture(node->capture);
+            node->capture = NULL;
+        }
+        if (node->capture == NULL) {
+            snprintf(message, messageSize, "No free console for '%s', a pipeline of %d scripts needs %d",
+                     node->displayName, nodeCount, nodeCount);
+            releasePipelineCaptures(pipeline);
+            freePipeline(pipeline);
+            free(nodeOfFile);
+            free(fileOfNode);
+            return false;
+        }
+    }
+
+    lockMutex(&pool->lock);
+    for (int n = 0; n < nodeCount; n++) {
+        pipeline->nodes[n].jobId = pool->nextJobId++;
+    }
+    int workerCount = pool->concurrencyCap < nodeCount ? pool->concurrencyCap : nodeCount;
+    unlockMutex(&pool->lock);
+
+    pipeline->pool = pool;
+    pipeline->events = &pool->events;
+    initMutex(&pipeline->idleLock);
+    initCondVar(&pipeline->idleWake);
+    atomic_init(&pipeline->readyCount, 0);
+    atomic_init(&pipeline->doneCount, 0);
+    atomic_init(&pipeline->finished, false);
+    for (int w = 0; w < workerCount; w++) {
+        initMutex(&pipeline->deques[w].lock);
+        pipeline->deques[w].items = (int*)malloc((size_t)nodeCount * sizeof(int));
+        if (pipeline->deques[w].items == NULL) {
+            snprintf(message, messageSize, "Out of memory");
+            releasePipelineCaptures(pipeline);
+            freePipeline(pipeline);
+            free(nodeOfFile);
+            free(fileOfNode);
+            return false;
+        }
+    }
+
+    // Workers start before anything is seeded: they sleep until work arrives, and the roots only go
+    // to workers that really run
+    atomic_init(&pipeline->workerCount, workerCount);
+    int started = 0;
+    for (int w = 0; w < workerCount; w++) {
+        pipeline->workerArgs[w].pipeline = pipeline;
+        pipeline->workerArgs[w].workerIndex = w;
+        if (!startThread(&pipeline->threads[w], pipelineWorkerThread, &pipeline->workerArgs[w])) {
+            break;
+        }
+        started++;
+    }
+    if (started == 0) {
+        snprintf(message, messageSize, "Could not start pipeline workers");
+        releasePipelineCaptures(pipeline);
+        freePipeline(pipeline);
+        free(nodeOfFile);
+        free(fileOfNode);
+        return false;
+    }
+    if (started < workerCount) {
+        printf("[PIPELINE] Only %d of %d workers started\n", started, workerCount);
+        atomic_store(&pipeline->workerCount, started);
+    }
+
+    for (int n = 0; n < nodeCount; n++) {
+        PipelineNode *node = &pipeline->nodes[n];
+        atomic_init(&node->remaining, node->dependencyCount);
+        atomic_init(&node->dependencyFailed, false);
+        atomic_init(&node->state, NODE_PENDING);
+        ScriptRunInfo *info = fileOfNode[n] >= 0 ? takeRunInfo(index, &files[fileOfNode[n]]) : NULL;
+        if (info != NULL) {
+            info->queuedRuns++;
+            refreshRunState(info);
+        }
+    }
+    free(nodeOfFile);
+    free(fileOfNode);
+
+    // Seed the roots round robin so every worker starts with its own work
+    pipeline->active = true;
+    pipeline->startTime = getMonotonicSeconds();
+    int seeded = 0;
+    for (int n = 0; n < nodeCount; n++) {
+        if (pipeline->nodes[n].dependencyCount == 0) {
+            pushWork(pipeline, seeded++ % started, n);
+        }
+    }
+
+    snprintf(message, messageSize, "Pipeline: %d scripts on %d workers", nodeCount, started);
+    printf("[PIPELINE] Started %d scripts (%d edges) on %d workers\n", nodeCount, edgeCount, started);
+    return true;
+}
+
+// Once every node is done, join the workers and summarize wall time and critical path
+void pollPipeline(Pipeline *pipeline, char *summary, size_t summarySize) {
+    if (!pipeline->active) {
+        return;
+    }
+    if (!atomic_load(&pipeline->finished)) {
+        snprintf(summary, summarySize, "Pipeline: %d/%d done", atomic_load(&pipeline->doneCount), pipeline->nodeCount);
+        return;
+    }
+
+    for (int w = 0; w < atomic_load(&pipeline->workerCount); w++) {
+        joinThread(pipeline->threads[w]);
+    }
+
+    // Longest chain of actual durations through the DAG, walked in topological order
+    int nodeCount = pipeline->nodeCount;
+    double *finishAt = (double*)calloc(nodeCount, sizeof(double));
+    int *previous = (int*)malloc(nodeCount * sizeof(int));
+    double wallEnd = pipeline->startTime;
+    int failed = 0;
+    int last = -1;
+
+    for (int i = 0; i < nodeCount; i++) {
+        int n = pipeline->topoOrder[i];
+        PipelineNode *node = &pipeline->nodes[n];
+        int state = atomic_load(&node->state);
+        double duration = (state == NODE_SKIPPED) ? 0 : node->endTime - node->startTime;
+        if (state != NODE_SUCCEEDED) failed++;
+        if (state != NODE_SKIPPED && node->endTime > wallEnd) wallEnd = node->endTime;
+
+        previous[n] = -1;
+        double longest = 0;
+        for (int d = 0; d < node->dependencyCount; d++) {
+            if (finishAt[node->dependencies[d]] > longest || previous[n] < 0) {
+                longest = finishAt[node->dependencies[d]];
+                previous[n] = node->dependencies[d];
+            }
+        }
+        finishAt[n] = longest + duration;
+        if (last < 0 || finishAt[n] > finishAt[last]) last = n;
+    }
+
+    // Walk back from the latest finisher to name the blocking chain
+    char path[256] = "";
+    int chain[64];
+    int chainLength = 0;
+    for (int n = last; n >= 0 && chainLength < 64; n = previous[n]) {
+        chain[chainLength++] = n;
+    }
+    for (int i = chainLength - 1; i >= 0; i--) {
+        size_t used = strlen(path);
+        snprintf(path + used, sizeof(path) - used, "%s%s", pipeline->nodes[chain[i]].displayName, i > 0 ? " > " : "");
+    }
+
+    char failures[48] = "";
+    if (failed > 0) {
+        snprintf(failures, sizeof(failures), " | %d failed/skipped", failed);
+    }
+    snprintf(summary, summarySize, "Pipeline: wall %.1fs | critical path %.1fs: %s%s",
+             wallEnd - pipeline->startTime, last >= 0 ? finishAt[last] : 0.0, path, failures);
+    printf("[PIPELINE] %s\n", summary);
+
+    free(finishAt);
+    free(previous);
+    freePipeline(pipeline);
+}
+
+// Open scripts folder in file explorer, returns the opener's PID where there is one
+ProcessId openScriptsFolder(const char *scriptDir) {
+#ifdef PLATFORM_WINDOWS
+    // Use ShellExecuteA instead of system() for better performance
+    ShellExecuteA(NULL, "open", scriptDir, NULL, NULL, SW_SHOW);
+#else
+    static const char *openers[] = { "xdg-open", "nautilus", "dolphin" };
+
+    char openerPath[512];
+    for (int i = 0; i < (int)(sizeof(openers) / sizeof(openers[0])); i++) {
+        if (findExecutable(openers[i], openerPath, sizeof(openerPath))) {
+            char *argv[] = { openerPath, (char*)scriptDir, NULL };
+            return spawnProcess(argv, -1);
+        }
+    }
+#endif
+    return 0;
+}
+
+// Save script
+bool saveNewScript(const char *scriptDir, const char *filename, const char *command) {
+    if (strlen(filename) == 0 || strlen(command) == 0) {
+        return false;
+    }
+
+    char filepath[512];
+
+#ifdef PLATFORM_WINDOWS
+    if (strstr(filename, ".bat") == NULL && strstr(filename, ".cmd") == NULL) {
+        snprintf(filepath, sizeof(filepath), "%s/%s.bat", scriptDir, filename);
+    } else {
+        snprintf(filepath, sizeof(filepath), "%s/%s", scriptDir, filename);
+    }
+#else
+    if (strstr(filename, ".sh") == NULL) {
+        snprintf(filepath, sizeof(filepath), "%s/%s.sh", scriptDir, filename);
+    } else {
+        snprintf(filepath, sizeof(filepath), "%s/%s", scriptDir, filename);
+    }
+#endif
+
+    FILE *file = fopen(filepath, "w");
+    if (file == NULL) {
+        return false;
+    }
+
+#ifdef PLATFORM_WINDOWS
+    fprintf(file, "@echo off\n");
+    fprintf(file, "%s\n", command);
+#else
+    fprintf(file, "#!/bin/bash\n");
+    fprintf(file, "%s\n", command);
+#endif
+
+    fclose(file);
+
+#ifndef PLATFORM_WINDOWS
+    chmod(filepath, 0755);
+#endif
+
+    return true;
+}
+
+// Delete script file
+bool deleteScript(const char *filepath) {
+    if (remove(filepath) == 0) {
+        return true;
+    } else {
+        return false;
+    }
+}
+
+// Copy length bytes of text into the arena as a terminated string, NULL when out of memory
+const char *internString(StringArena *arena, const char *text, size_t length) {
+    if (arena->head == NULL || arena->head->capacity - arena->head->used < length + 1) {
+        size_t capacity = length + 1 > STRING_ARENA_BLOCK_SIZE ? length + 1 : STRING_ARENA_BLOCK_SIZE;
+        ArenaBlock *block = (ArenaBlock*)malloc(sizeof(ArenaBlock) + capacity);
+        if (block == NULL) {
+            return NULL;
+        }
+        block->next = arena->head;
+        block->used = 0;
+        block->capacity = capacity;
+        arena->head = block;
+        arena->bytes += sizeof(ArenaBlock) + capacity;
+    }
+
+    char *copy = arena->head->data + arena->head->used;
+    memcpy(copy, text, length);
+    copy[length] = '\0';
+    arena->head->used += length + 1;
+    return copy;
+}
+
+// Release every string of the arena at once
+void freeStringArena(StringArena *arena) {
+    while (arena->head != NULL) {
+        ArenaBlock *next = arena->head->next;
+        free(arena->head);
+        arena->head = next;
+    }
+    arena->bytes = 0;
+}
+
+// qsort order for trigrams
+int compareTrigrams(const void *a, const void *b) {
+    uint32_t left = *(const uint32_t*)a, right = *(const uint32_t*)b;
+    return left < right ? -1 : left > right;
+}
+
+// Lowercased trigrams of text, sorted and unique. out needs room for length entries, returns how many
+int collectTrigrams(const char *text, size_t length, uint32_t *out) {
+    int count = 0;
+    uint32_t window = 0;
+    for (size_t i = 0; i < length; i++) {
+        unsigned char c = (unsigned char)text[i];
+        if (c >= 'A' && c <= 'Z') c += 'a' - 'A';
+        else if (c == '\t' || c == '\r' || c == '\n') c = ' ';
+        window = ((window << 8) | c) & 0xFFFFFF;
+        if (i >= 2) out[count++] = window;
+    }
+    if (count < 2) return count;
+
+    qsort(out, count, sizeof(uint32_t), compareTrigrams);
+    int unique = 1;
+    for (int i = 1; i < count; i++) {
+        if (out[i] != out[unique - 1]) out[unique++] = out[i];
+    }
+    return unique;
+}
+
+// Posting list of a trigram, added when create is set. NULL when there is none (or no memory for it)
+SearchPosting *findSearchPosting(SearchIndex *search, uint32_t trigram, bool create) {
+    if (create && (search->postingCount + 1) * 2 > search->postingCapacity) {
+        size_t capacity = search->postingCapacity ? search->postingCapacity * 2 : 4096;
+        SearchPosting *postings = (SearchPosting*)calloc(capacity, sizeof(SearchPosting));
+        if (postings == NULL) return NULL;
+        for (size_t i = 0; i < search->postingCapacity; i++) {
+            if (search->postings[i].key == 0) continue;
+            size_t slot = (search->postings[i].key * 2654435761u) & (capacity - 1);
+            while (postings[slot].key != 0) slot = (slot + 1) & (capacity - 1);
+            postings[slot] = search->postings[i];
+        }
+        free(search->postings);
+        search->postings = postings;
+        search->postingCapacity = capacity;
+    }
+    if (search->postingCapacity == 0) {
+        return NULL;
+    }
+
+    size_t mask = search->postingCapacity - 1;
+    size_t slot = ((trigram + 1) * 2654435761u) & mask;
+    while (search->postings[slot].key != 0) {
+        if (search->postings[slot].key == trigram + 1) return &search->postings[slot];
+        slot = (slot + 1) & mask;
+    }
+    if (!create) {
+        return NULL;
+    }
+    search->postings[slot].key = trigram + 1;
+    search->postingCount++;
+    return &search->postings[slot];
+}
+
+// Record that a document contains a trigram
+bool addSearchPosting(SearchIndex *search, uint32_t trigram, uint32_t entry) {
+    SearchPosting *posting = findSearchPosting(search, trigram, true);
+    if (posting == NULL) {
+        return false;
+    }
+    if (posting->count == posting->capacity) {
+        uint32_t capacity = posting->capacity ? posting->capacity * 2 : 4;
+        uint32_t *entries = (uint32_t*)realloc(posting->entries, capacity * sizeof(uint32_t));
+        if (entries == NULL) return false;
+        posting->entries = entries;
+        posting->capacity = capacity;
+    }
+    posting->entries[posting->count++] = entry;
+    search->entryCount++;
+    return true;
+}
+
+// Indexer thread: reduce script paths and bodies to their trigrams
+void *searchIndexerThread(void *arg) {
+    SearchIndex *search = (SearchIndex*)arg;
+    char *body = (char*)malloc(SEARCH_BODY_BYTES);
+    uint32_t *trigrams = (uint32_t*)malloc(SEARCH_BODY_BYTES * sizeof(uint32_t));
+    if (body == NULL || trigrams == NULL) {
+        printf("[SEARCH] Out of memory, scripts are not searchable\n");
+        free(body);
+        free(trigrams);
+        return NULL;
+    }
+
+    for (;;) {
+        lockMutex(&search->lock);
+        while (search->jobCount == 0 && !atomic_load(&search->stopping)) {
+            waitCondVar(&search->wake, &search->lock);
+        }
+        if (atomic_load(&search->stopping)) {
+            unlockMutex(&search->lock);
+            break;
+        }
+        SearchBodyJob job = search->jobs[--search->jobCount];
+        unlockMutex(&search->lock);
+
+        char filePath[1024];
+        snprintf(filePath, sizeof(filePath), "%s/%s", search->scriptDir, job.fileName);
+        size_t length = 0;
+        FILE *file = fopen(filePath, "rb");
+        if (file != NULL) {
+            length = fread(body, 1, SEARCH_BODY_BYTES, file);
+            fclose(file);
+        }
+
+        uint32_t pathTrigrams[512];
+        size_t nameLength = strlen(job.fileName);
+        int pathCount = collectTrigrams(job.fileName, nameLength < 512 ? nameLength : 512, pathTrigrams);
+        int count = collectTrigrams(body, length, trigrams);
+
+        // Both lists are sorted, a trigram in the path is only recorded once, as a path trigram
+        int kept = 0;
+        for (int i = 0, p = 0; i < count; i++) {
+            while (p < pathCount && pathTrigrams[p] < trigrams[i]) p++;
+            if (p < pathCount && pathTrigrams[p] == trigrams[i]) continue;
+            trigrams[kept++] = trigrams[i];
+        }
+        for (int p = 0; p < pathCount && kept < SEARCH_BODY_BYTES; p++) {
+            trigrams[kept++] = pathTrigrams[p] | SEARCH_PATH_TRIGRAM;
+        }
+
+        SearchBodyResult result = { job.doc, NULL, kept, 0, NULL };
+        if (kept > 0) {
+            result.trigrams = (uint32_t*)malloc(kept * sizeof(uint32_t));
+            if (result.trigrams == NULL) result.count = 0;
+            else memcpy(result.trigrams, trigrams, kept * sizeof(uint32_t));
+        }
+        if (job.doc == SEARCH_TREE_DOC) {
+            result.fileName = job.fileName;
+        } else {
+            free(job.fileName);
+        }
+
+        lockMutex(&search->lock);
+        if (search->resultCount == search->resultCapacity) {
+            int capacity = search->resultCapacity ? search->resultCapacity * 2 : 256;
+            SearchBodyResult *results = (SearchBodyResult*)realloc(search->results, capacity * sizeof(SearchBodyResult));
+            if (results != NULL) {
+                search->results = results;
+                search->resultCapacity = capacity;
+            }
+        }
+        if (search->resultCount < search->resultCapacity) {
+            search->results[search->resultCount++] = result;
+        } else {
+            free(result.trigrams);
+            free(result.fileName);
+        }
+        unlockMutex(&search->lock);
+    }
+
+    free(body);
+    free(trigrams);
+    return NULL;
+}
+
+// Prepare an empty search index for scripts under scriptDir and start its indexer thread
+void initSearchIndex(SearchIndex *search, const char *scriptDir) {
+    memset(search, 0, sizeof(*search));
+    snprintf(search->scriptDir, sizeof(search->scriptDir), "%s", scriptDir);
+    initMutex(&search->lock);
+    initCondVar(&search->wake);
+    search->threadStarted = startThread(&search->thread, searchIndexerThread, search);
+    if (!search->threadStarted) {
+        printf("[SEARCH] Could not start the indexer thread, only paths are searchable\n");
+    }
+}
+
+// Newest live document of a script, UINT32_MAX when it has none
+uint32_t findSearchDocByKey(const SearchIndex *search, uint64_t fileKey) {
+    if (search->docLookupCapacity == 0) {
+        return UINT32_MAX;
+    }
+    size_t mask = search->docLookupCapacity - 1;
+    for (size_t slot = (size_t)fileKey & mask; search->docLookup[slot] != 0; slot = (slot + 1) & mask) {
+        uint32_t doc = search->docLookup[slot] - 1;
+        if (search->docs[doc].fileKey == fileKey) {
+            return search->docs[doc].live ? doc : UINT32_MAX;
+        }
+    }
+    return UINT32_MAX;
+}
+
+// Make doc the one its script's key finds, returns false when out of memory
+bool setSearchDocLookup(SearchIndex *search, uint32_t doc) {
+    if ((search->docLookupCount + 1) * 2 > search->docLookupCapacity) {
+        size_t capacity = search->docLookupCapacity ? search->docLookupCapacity * 2 : 2048;
+        uint32_t *lookup = (uint32_t*)calloc(capacity, sizeof(uint32_t));
+        if (lookup == NULL) return false;
+        for (size_t i = 0; i < search->docLookupCapacity; i++) {
+            if (search->docLookup[i] == 0) continue;
+            size_t slot = (size_t)search->docs[search->docLookup[i] - 1].fileKey & (capacity - 1);
+            while (lookup[slot] != 0) slot = (slot + 1) & (capacity - 1);
+            lookup[slot] = search->docLookup[i];
+        }
+        free(search->docLookup);
+        search->docLookup = lookup;
+        search->docLookupCapacity = capacity;
+    }
+
+    size_t mask = search->docLookupCapacity - 1;
+    uint64_t fileKey = search->docs[doc].fileKey;
+    size_t slot = (size_t)fileKey & mask;
+    while (search->docLookup[slot] != 0 && search->docs[search->docLookup[slot] - 1].fileKey != fileKey) {
+        slot = (slot + 1) & mask;
+    }
+    if (search->docLookup[slot] == 0) search->docLookupCount++;
+    search->docLookup[slot] = doc + 1;
+    return true;
+}
+
+// Start a live document for a script, treeName (may be NULL) is owned by it from then on. UINT32_MAX when out of memory
+uint32_t newSearchDoc(SearchIndex *search, uint64_t fileKey, char *treeName) {
+    if (search->docCount == search->docCapacity) {
+        uint32_t capacity = search->docCapacity ? search->docCapacity * 2 : 1024;
+        SearchDoc *docs = (SearchDoc*)realloc(search->docs, capacity * sizeof(SearchDoc));
+        if (docs != NULL) search->docs = docs;
+        uint32_t *scores = (uint32_t*)realloc(search->scores, capacity * sizeof(uint32_t));
+        if (scores != NULL) search->scores = scores;
+        uint32_t *touched = (uint32_t*)realloc(search->touched, capacity * sizeof(uint32_t));
+        if (touched != NULL) search->touched = touched;
+        if (docs == NULL || scores == NULL || touched == NULL) {
+            return UINT32_MAX;
+        }
+        memset(search->scores + search->docCapacity, 0, (capacity - search->docCapacity) * sizeof(uint32_t));
+        search->docCapacity = capacity;
+    }
+
+    uint32_t doc = search->docCount;
+    search->docs[doc].fileKey = fileKey;
+    search->docs[doc].treeName = NULL;
+    search->docs[doc].live = true;
+    if (!setSearchDocLookup(search, doc)) {
+        return UINT32_MAX;
+    }
+    search->docs[doc].treeName = treeName;
+    search->docCount++;
+    search->liveDocs++;
+    search->generation++;
+    return doc;
+}
+
+// Hand a script to the indexer thread
+void queueSearchJob(SearchIndex *search, uint32_t doc, const char *fileName) {
+    char *name = strdup(fileName);
+    lockMutex(&search->lock);
+    if (name != NULL && search->jobCount == search->jobCapacity) {
+        int capacity = search->jobCapacity ? search->jobCapacity * 2 : 256;
+        SearchBodyJob *jobs = (SearchBodyJob*)realloc(search->jobs, capacity * sizeof(SearchBodyJob));
+        if (jobs != NULL) {
+            search->jobs = jobs;
+            search->jobCapacity = capacity;
+        }
+    }
+    if (name != NULL && search->jobCount < search->jobCapacity) {
+        search->jobs[search->jobCount++] = (SearchBodyJob){ doc, name };
+        broadcastCondVar(&search->wake);
+    } else {
+        free(name);
+    }
+    unlockMutex(&search->lock);
+}
+
+// Drop the postings of retired documents, once they outnumber the live ones
+void compactSearchIndex(SearchIndex *search) {
+    search->entryCount = 0;
+    for (size_t i = 0; i < search->postingCapacity; i++) {
+        SearchPosting *posting = &search->postings[i];
+        uint32_t kept = 0;
+        for (uint32_t e = 0; e < posting->count; e++) {
+            if (search->docs[posting->entries[e] >> 1].live) posting->entries[kept++] = posting->entries[e];
+        }
+        posting->count = kept;
+        search->entryCount += kept;
+    }
+    search->deadDocs = 0;
+}
+
+// Retire a document when its script is deleted or rewritten
+void removeSearchDoc(SearchIndex *search, uint32_t doc) {
+    if (doc >= search->docCount || !search->docs[doc].live) {
+        return;
+    }
+    search->docs[doc].live = false;
+    free(search->docs[doc].treeName);
+    search->docs[doc].treeName = NULL;
+    search->liveDocs--;
+    search->deadDocs++;
+    search->generation++;
+    if (search->deadDocs > 4096 && search->deadDocs > search->liveDocs) {
+        compactSearchIndex(search);
+    }
+}
+
+// Queue a listed script for the indexer thread, returns its document id. Without the thread only its path is indexed, right away
+uint32_t addSearchDoc(SearchIndex *search, const FileItem *file) {
+    // Listed from now on, so the entry's own document takes over from the tree walk's
+    uint32_t treeDoc = findSearchDocByKey(search, file->historyKey);
+    if (treeDoc != UINT32_MAX && search->docs[treeDoc].treeName != NULL) {
+        removeSearchDoc(search, treeDoc);
+    }
+
+    uint32_t doc = newSearchDoc(search, file->historyKey, NULL);
+    if (doc == UINT32_MAX) {
+        return doc;
+    }
+    if (!search->threadStarted) {
+        uint32_t trigrams[512];
+        size_t nameLength = strlen(file->fileName);
+        int count = collectTrigrams(file->fileName, nameLength < 512 ? nameLength : 512, trigrams);
+        for (int i = 0; i < count; i++) {
+            addSearchPosting(search, trigrams[i], doc << 1 | 1);
+        }
+    } else {
+        queueSearchJob(search, doc, file->fileName);
+    }
+    return doc;
+}
+
+// Queue a script the scan thread found anywhere in the tree, listed or not. Its document is made
+// when the result is merged, unless the script is listed by then
+void addSearchTreeScript(SearchIndex *search, const char *fileName) {
+    if (search->threadStarted) {
+        queueSearchJob(search, SEARCH_TREE_DOC, fileName);
+    }
+}
+
+// Jobs and results the indexer and the UI have yet to get through
+int getSearchBacklog(SearchIndex *search) {
+    lockMutex(&search->lock);
+    int backlog = search->jobCount + search->resultCount;
+    unlockMutex(&search->lock);
+    return backlog;
+}
+
+// Retire the documents of listed scripts, e.g. before the scripts are listed again; those of the tree
+// walk stay. Ids keep counting up, so body results still on their way for the old documents are dropped when they arrive
+void clearSearchIndex(SearchIndex *search) {
+    for (uint32_t doc = 0; doc < search->docCount; doc++) {
+        if (search->docs[doc].live && search->docs[doc].treeName == NULL) {
+            search->docs[doc].live = false;
+            search->liveDocs--;
+        }
+    }
+    compactSearchIndex(search);
+    search->generation++;
+
+    lockMutex(&search->lock);
+    int kept = 0;
+    for (int i = 0; i < search->jobCount; i++) {
+        if (search->jobs[i].doc == SEARCH_TREE_DOC) {
+            search->jobs[kept++] = search->jobs[i];
+        } else {
+            free(search->jobs[i].fileName);
+        }
+    }
+    search->jobCount = kept;
+    unlockMutex(&search->lock);
+}
+
+// Merge trigrams from the indexer, at most SEARCH_MERGE_BUDGET postings per call
+void pollSearchIndex(SearchIndex *search) {
+    if (search->mergingNext == search->mergingCount) {
+        free(search->merging);
+        lockMutex(&search->lock);
+        search->merging = search->results;
+        search->mergingCount = search->resultCount;
+        search->results = NULL;
+        search->resultCount = 0;
+        search->resultCapacity = 0;
+        unlockMutex(&search->lock);
+        search->mergingNext = 0;
+    }
+
+    int budget = SEARCH_MERGE_BUDGET;
+    bool changed = false;
+    while (search->mergingNext < search->mergingCount && budget > 0) {
+        SearchBodyResult *result = &search->merging[search->mergingNext];
+        if (result->doc == SEARCH_TREE_DOC && result->fileName != NULL &&
+            findSearchDocByKey(search, hashScriptName(result->fileName)) == UINT32_MAX) {
+            result->doc = newSearchDoc(search, hashScriptName(result->fileName), result->fileName);
+            if (result->doc != UINT32_MAX) result->fileName = NULL;
+        }
+        if (result->doc < search->docCount && search->docs[result->doc].live) {
+            while (result->merged < result->count && budget > 0) {
+                uint32_t trigram = result->trigrams[result->merged++];
+                addSearchPosting(search, trigram & ~SEARCH_PATH_TRIGRAM, result->doc << 1 | (trigram >> 31));
+                budget--;
+            }
+            changed = true;
+        }
+        if (result->merged < result->count && result->doc < search->docCount && search->docs[result->doc].live) {
+            break;
+        }
+        free(result->trigrams);
+        free(result->fileName);
+        search->mergingNext++;
+    }
+    if (changed) {
+        search->generation++;
+    }
+}
+
+// Stop the indexer thread and free everything
+void freeSearchIndex(SearchIndex *search) {
+    if (search->threadStarted) {
+        atomic_store(&search->stopping, true);
+        lockMutex(&search->lock);
+        broadcastCondVar(&search->wake);
+        unlockMutex(&search->lock);
+        joinThread(search->thread);
+    }
+    for (size_t i = 0; i < search->postingCapacity; i++) {
+        free(search->postings[i].entries);
+    }
+    for (int i = 0; i < search->jobCount; i++) {
+        free(search->jobs[i].fileName);
+    }
+    for (int i = 0; i < search->resultCount; i++) {
+        free(search->results[i].trigrams);
+        free(search->results[i].fileName);
+    }
+    for (int i = search->mergingNext; i < search->mergingCount; i++) {
+        free(search->merging[i].trigrams);
+        free(search->merging[i].fileName);
+    }
+    for (uint32_t doc = 0; doc < search->docCount; doc++) {
+        free(search->docs[doc].treeName);
+    }
+    free(search->postings);
+    free(search->docs);
+    free(search->docLookup);
+    free(search->scores);
+    free(search->touched);
+    free(search->jobs);
+    free(search->results);
+    free(search->merging);
+    memset(search, 0, sizeof(*search));
+}
+
+// Keep the best maxResults in a min-heap on score
+void pushSearchResult(SearchResult *results, int *count, int maxResults, uint64_t fileKey, uint32_t score) {
+    int i;
+    if (*count < maxResults) {
+        i = (*count)++;
+        while (i > 0 && results[(i - 1) / 2].score > score) {
+            results[i] = results[(i - 1) / 2];
+            i = (i - 1) / 2;
+        }
+    } else if (score > results[0].score) {
+        // Sift the new result down from the root
+        i = 0;
+        for (;;) {
+            int child = 2 * i + 1;
+            if (child >= *count) break;
+            if (child + 1 < *count && results[child + 1].score < results[child].score) child++;
+            if (results[child].score >= score) break;
+            results[i] = results[child];
+            i = child;
+        }
+    } else {
+        return;
+    }
+    results[i].fileKey = fileKey;
+    results[i].score = score;
+}
+
+// qsort order for results, best first
+int compareSearchResults(const void *a, const void *b) {
+    const SearchResult *left = (const SearchResult*)a, *right = (const SearchResult*)b;
+    if (left->score != right->score) return left->score < right->score ? 1 : -1;
+    return left->fileKey < right->fileKey ? -1 : left->fileKey > right->fileKey;
+}
+
+// ASCII lowercase, other bytes unchanged
+char lowerAscii(char c) {
+    return (c >= 'A' && c <= 'Z') ? (char)(c + 'a' - 'A') : c;
+}
+
+// Case-insensitive strstr for ASCII
+bool containsIgnoringCase(const char *text, const char *needle, size_t needleLength) {
+    for (; *text != '\0'; text++) {
+        size_t i = 0;
+        while (i < needleLength && text[i] != '\0' && lowerAscii(text[i]) == lowerAscii(needle[i])) {
+            i++;
+        }
+        if (i == needleLength) return true;
+    }
+    return false;
+}
+
+// Score of a path that contains a short query: names starting with the query first, then shorter paths
+uint32_t scoreShortQuery(const char *fileName, const char *name, const char *query, size_t queryLength) {
+    bool prefix = lowerAscii(name[0]) == lowerAscii(query[0]) &&
+                  (queryLength == 1 || lowerAscii(name[1]) == lowerAscii(query[1]));
+    return (prefix ? 1u << 16 : 0) + (uint32_t)(0xFFFF - (strlen(fileName) & 0xFFFF));
+}
+
+// Rank the scripts against a query, best first. Queries of three characters or more go through the
+// trigram index: a script qualifies with two thirds of the query's trigrams (so typos still match),
+// ranks by how many it has, then by path hits over body hits. Shorter ones match paths as substrings
+int searchScripts(SearchIndex *search, const ScriptIndex *index, const char *query, SearchResult *results, int maxResults) {
+    int count = 0;
+    size_t queryLength = strlen(query);
+    if (queryLength == 0) {
+        return 0;
+    }
+
+    if (queryLength < 3) {
+        for (int i = 0; i < index->count; i++) {
+            const FileItem *file = &index->files[i];
+            if (!containsIgnoringCase(file->fileName, query, queryLength)) continue;
+            pushSearchResult(results, &count, maxResults, file->historyKey,
+                             scoreShortQuery(file->fileName, file->displayName, query, queryLength));
+        }
+        // Scripts in folders that were never listed
+        for (uint32_t doc = 0; doc < search->docCount; doc++) {
+            const char *treeName = search->docs[doc].treeName;
+            if (treeName == NULL || !containsIgnoringCase(treeName, query, queryLength)) continue;
+            const char *slash = strrchr(treeName, '/');
+            pushSearchResult(results, &count, maxResults, search->docs[doc].fileKey,
+                             scoreShortQuery(treeName, slash != NULL ? slash + 1 : treeName, query, queryLength));
+        }
+    } else {
+        uint32_t trigrams[SEARCH_MAX_QUERY + 1];
+        int trigramCount = collectTrigrams(query, queryLength <= SEARCH_MAX_QUERY ? queryLength : SEARCH_MAX_QUERY, trigrams);
+        int needed = trigramCount - trigramCount / 3;
+        uint32_t touchedCount = 0;
+
+        // The score is the hit count in the high half and the weighted hits in the low half, which
+        // stays far below 1 << 16 with at most SEARCH_MAX_QUERY trigrams. Retired documents are
+        // only filtered once per candidate, not once per posting
+        for (int t = 0; t < trigramCount; t++) {
+            const SearchPosting *posting = findSearchPosting(search, trigrams[t], false);
+            if (posting == NULL) continue;
+            for (uint32_t e = 0; e < posting->count; e++) {
+                uint32_t entry = posting->entries[e];
+                uint32_t doc = entry >> 1;
+                if (search->scores[doc] == 0) search->touched[touchedCount++] = doc;
+                search->scores[doc] += (entry & 1) ? (1u << 16 | SEARCH_NAME_WEIGHT) : (1u << 16 | 1);
+            }
+        }
+
+        for (uint32_t i = 0; i < touchedCount; i++) {
+            uint32_t doc = search->touched[i];
+            uint32_t score = search->scores[doc];
+            if ((int)(score >> 16) >= needed && search->docs[doc].live) {
+                pushSearchResult(results, &count, maxResults, search->docs[doc].fileKey, score);
+            }
+            search->scores[doc] = 0;
+        }
+    }
+
+    qsort(results, count, sizeof(SearchResult), compareSearchResults);
+    return count;
+}
+
+// First occurrence of needle in haystack, NULL when there is none. Candidates are found 16 bytes at a
+// time by comparing against the first and the last byte of the needle together, which rules out almost
+// every position without looking at it again; only those left are compared in full
+const char *findSubstring(const char *haystack, size_t length, const char *needle, size_t needleLength) {
+    if (needleLength == 0 || needleLength > length) {
+        return needleLength == 0 ? haystack : NULL;
+    }
+    if (needleLength == 1) {
+        return (const char*)memchr(haystack, needle[0], length);
+    }
+
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128i first = _mm_set1_epi8(needle[0]);
+    const __m128i last = _mm_set1_epi8(needle[needleLength - 1]);
+    for (; i + needleLength - 1 + 16 <= length; i += 16) {
+        __m128i blockFirst = _mm_loadu_si128((const __m128i*)(haystack + i));
+        __m128i blockLast = _mm_loadu_si128((const __m128i*)(haystack + i + needleLength - 1));
+        unsigned mask = (unsigned)_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(blockFirst, first),
+                                                                  _mm_cmpeq_epi8(blockLast, last)));
+        while (mask != 0) {
+            int bit = __builtin_ctz(mask);
+            if (memcmp(haystack + i + bit + 1, needle + 1, needleLength - 2) == 0) {
+                return haystack + i + bit;
+            }
+            mask &= mask - 1;
+        }
+    }
+#endif
+
+    // Remainder, or everything without SSE2: memchr is vectorized by the C library
+    while (i + needleLength <= length) {
+        const char *candidate = (const char*)memchr(haystack + i, needle[0], length - needleLength + 1 - i);
+        if (candidate == NULL) return NULL;
+        if (memcmp(candidate + 1, needle + 1, needleLength - 1) == 0) return candidate;
+        i = (size_t)(candidate - haystack) + 1;
+    }
+    return NULL;
+}
+
+// Queue paths for the grep workers, unless the grep they belong to has been replaced
+void queueGrepPaths(ContentGrep *grep, char **paths, int count, uint32_t generation) {
+    lockMutex(&grep->lock);
+    bool current = atomic_load(&grep->generation) == generation;
+    if (current && grep->pathCount + count > grep->pathCapacity) {
+        int capacity = grep->pathCapacity ? grep->pathCapacity : 256;
+        while (capacity < grep->pathCount + count) capacity *= 2;
+        char **newPaths = (char**)realloc(grep->paths, capacity * sizeof(char*));
+        if (newPaths != NULL) {
+            grep->paths = newPaths;
+            grep->pathCapacity = capacity;
+        }
+    }
+    int queued = 0;
+    if (current && grep->pathCount + count <= grep->pathCapacity) {
+        memcpy(grep->paths + grep->pathCount, paths, count * sizeof(char*));
+        grep->pathCount += count;
+        queued = count;
+        broadcastCondVar(&grep->wake);
+    }
+    unlockMutex(&grep->lock);
+    for (int i = queued; i < count; i++) {
+        free(paths[i]);
+    }
+}
+
+// Queue the entries of one folder, subfolders marked by a trailing '/'
+void listGrepFolder(ContentGrep *grep, const char *folderPath, uint32_t generation) {
+    char dirPath[PATH_MAX];
+    int dirLength = snprintf(dirPath, sizeof(dirPath), folderPath[0] != '\0' ? "%s/%s" : "%s", grep->scriptDir, folderPath);
+    if (dirLength < 0 || (size_t)dirLength >= sizeof(dirPath)) {
+        return;
+    }
+    DIR *dir = opendir(dirPath);
+    if (dir == NULL) {
+        return;
+    }
+
+    char *batch[64];
+    int batchCount = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL && atomic_load(&grep->generation) == generation) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+
+        // Entries whose path does not fit are skipped rather than scanned under a truncated name
+        char filePath[PATH_MAX];
+        struct stat info;
+        int pathLength = snprintf(filePath, sizeof(filePath), "%s/%s", dirPath, entry->d_name);
+        if (pathLength < 0 || (size_t)pathLength >= sizeof(filePath)) continue;
+        if (stat(filePath, &info) != 0 || (!S_ISDIR(info.st_mode) && !S_ISREG(info.st_mode))) continue;
+
+        char relativePath[PATH_MAX];
+        int relativeLength = snprintf(relativePath, sizeof(relativePath), "%s%s%s", folderPath, entry->d_name,
+                                      S_ISDIR(info.st_mode) ? "/" : "");
+        if (relativeLength < 0 || (size_t)relativeLength >= sizeof(relativePath)) continue;
+        batch[batchCount] = strdup(relativePath);
+        if (batch[batchCount] != NULL) batchCount++;
+        if (batchCount == 64) {
+            queueGrepPaths(grep, batch, batchCount, generation);
+            batchCount = 0;
+        }
+    }
+    closedir(dir);
+    queueGrepPaths(grep, batch, batchCount, generation);
+}
+
+// Read one file in chunks and record each line holding the pattern. Returns how many bytes were scanned.
+// Plain reads instead of a mapping, so a file truncated while it is scanned just ends early (a mapping
+// would raise SIGBUS). Only whole lines are searched, the unfinished one is carried into the next chunk.
+// buffer/bufferCapacity belong to the calling worker and grow for lines longer than a chunk
+size_t scanGrepFile(ContentGrep *grep, const char *fileName, const char *pattern, size_t patternLength, uint32_t generation,
+                    char **buffer, size_t *bufferCapacity) {
+    char filePath[PATH_MAX];
+    int pathLength = snprintf(filePath, sizeof(filePath), "%s/%s", grep->scriptDir, fileName);
+    if (pathLength < 0 || (size_t)pathLength >= sizeof(filePath)) {
+        return 0;
+    }
+    FILE *file = fopen(filePath, "rb");
+    if (file == NULL) {
+        return 0;
+    }
+
+    size_t size = 0;
+    size_t carried = 0;
+    int line = 1;
+    GrepMatch *matches = NULL;
+    int matchCount = 0;
+    int matchCapacity = 0;
+    int lineMatches = 0;
+    bool replaced = false;
+
+    while (!replaced) {
+        if (carried == *bufferCapacity) {
+            size_t capacity = *bufferCapacity ? *bufferCapacity * 2 : GREP_CHUNK_BYTES;
+            char *grown = (char*)realloc(*buffer, capacity);
+            if (grown == NULL) break;
+            *buffer = grown;
+            *bufferCapacity = capacity;
+        }
+        size_t got = fread(*buffer + carried, 1, *bufferCapacity - carried, file);
+        size += got;
+        size_t filled = carried + got;
+        bool atEnd = got < *bufferCapacity - carried;
+
+        // Up to the last newline, everything once the file ended
+        size_t usable = filled;
+        if (!atEnd) {
+            while (usable > 0 && (*buffer)[usable - 1] != '\n') usable--;
+            if (usable == 0) {
+                carried = filled;
+                continue;
+            }
+        }
+
+        const char *text = *buffer;
+        const char *end = text + usable;
+        const char *lineStart = text;
+        const char *hit = findSubstring(text, usable, pattern, patternLength);
+        while (hit != NULL) {
+            // Newlines are only counted up to each match, the rest of the chunk is counted once below
+            for (const char *newline; (newline = (const char*)memchr(lineStart, '\n', hit - lineStart)) != NULL; ) {
+                line++;
+                lineStart = newline + 1;
+            }
+            const char *lineEnd = (const char*)memchr(hit, '\n', end - hit);
+            if (lineEnd == NULL) lineEnd = end;
+            lineMatches++;
+
+            if (matchCount == matchCapacity && matchCount < GREP_MAX_MATCHES) {
+                int capacity = matchCapacity ? matchCapacity * 2 : 8;
+                GrepMatch *newMatches = (GrepMatch*)realloc(matches, capacity * sizeof(GrepMatch));
+                if (newMatches != NULL) {
+                    matches = newMatches;
+                    matchCapacity = capacity;
+                }
+            }
+            if (matchCount < matchCapacity) {
+                GrepMatch *match = &matches[matchCount++];
+                match->fileName = NULL;
+                match->line = line;
+                match->column = (int)(hit - lineStart);
+
+                // Start the preview a little before the match when the line is long
+                const char *from = lineStart;
+                if (hit - from > GREP_PREVIEW_CHARS / 2) from = hit - GREP_PREVIEW_CHARS / 4;
+                int previewLength = 0;
+                for (const char *p = from; p < lineEnd && previewLength < GREP_PREVIEW_CHARS; p++) {
+                    unsigned char c = (unsigned char)*p;
+                    if (c == '\r') continue;
+                    match->preview[previewLength++] = (c == '\t' || c < 32) ? ' ' : (char)c;
+                }
+                match->preview[previewLength] = '\0';
+            }
+
+            if (atomic_load(&grep->generation) != generation) {
+                replaced = true;
+                break;
+            }
+            if (lineEnd == end) {
+                lineStart = end;
+                break;
+            }
+            line++;
+            lineStart = lineEnd + 1;
+            hit = findSubstring(lineStart, end - lineStart, pattern, patternLength);
+        }
+        for (const char *newline; (newline = (const char*)memchr(lineStart, '\n', end - lineStart)) != NULL; ) {
+            line++;
+            lineStart = newline + 1;
+        }
+
+        if (atEnd) break;
+        carried = filled - usable;
+        memmove(*buffer, *buffer + usable, carried);
+    }
+    fclose(file);
+
+    lockMutex(&grep->lock);
+    if (atomic_load(&grep->generation) == generation) {
+        grep->filesScanned++;
+        grep->bytesScanned += size;
+        grep->matchTotal += lineMatches;
+        if (lineMatches > 0) grep->matchedFiles++;
+        if (matchCount > GREP_MAX_MATCHES - grep->keptTotal) matchCount = GREP_MAX_MATCHES - grep->keptTotal;
+        // One copy of the name for all of the file's matches, dropped together with the grep
+        const char *name = matchCount > 0 ? internString(&grep->names, fileName, strlen(fileName)) : NULL;
+        if (name == NULL) matchCount = 0;
+        if (matchCount > 0 && grep->foundCount + matchCount > grep->foundCapacity) {
+            int capacity = grep->foundCapacity ? grep->foundCapacity : 64;
+            while (capacity < grep->foundCount + matchCount) capacity *= 2;
+            GrepMatch *found = (GrepMatch*)realloc(grep->found, capacity * sizeof(GrepMatch));
+            if (found != NULL) {
+                grep->found = found;
+                grep->foundCapacity = capacity;
+            } else {
+                matchCount = 0;
+            }
+        }
+        for (int i = 0; i < matchCount; i++) {
+            matches[i].fileName = name;
+        }
+        if (matchCount > 0) {
+            memcpy(grep->found + grep->foundCount, matches, matchCount * sizeof(GrepMatch));
+            grep->foundCount += matchCount;
+            grep->keptTotal += matchCount;
+        }
+    }
+    unlockMutex(&grep->lock);
+    free(matches);
+    return size;
+}
+
+// Grep worker: visit queued paths until the grep is shut down
+void *contentGrepThread(void *arg) {
+    ContentGrep *grep = (ContentGrep*)arg;
+    char *buffer = NULL;
+    size_t bufferCapacity = 0;
+    for (;;) {
+        lockMutex(&grep->lock);
+        while (grep->pathCount == 0 && !atomic_load(&grep->stopping)) {
+            waitCondVar(&grep->wake, &grep->lock);
+        }
+        if (atomic_load(&grep->stopping)) {
+            unlockMutex(&grep->lock);
+            break;
+        }
+        // Newest first keeps the walk depth-first, so the queue stays about one folder deep
+        char *path = grep->paths[--grep->pathCount];
+        uint32_t generation = atomic_load(&grep->generation);
+        char pattern[SEARCH_MAX_QUERY + 1];
+        memcpy(pattern, grep->pattern, sizeof(pattern));
+        size_t patternLength = grep->patternLength;
+        grep->busy++;
+        unlockMutex(&grep->lock);
+
+        size_t pathLength = strlen(path);
+        if (pathLength == 0 || path[pathLength - 1] == '/') {
+            listGrepFolder(grep, path, generation);
+        } else {
+            scanGrepFile(grep, path, pattern, patternLength, generation, &buffer, &bufferCapacity);
+        }
+        free(path);
+
+        lockMutex(&grep->lock);
+        grep->busy--;
+        unlockMutex(&grep->lock);
+    }
+    free(buffer);
+    return NULL;
+}
+
+// Prepare a content grep over scriptDir, its threads are started by the first search
+void initContentGrep(ContentGrep *grep, const char *scriptDir) {
+    memset(grep, 0, sizeof(*grep));
+    snprintf(grep->scriptDir, sizeof(grep->scriptDir), "%s", scriptDir);
+    initMutex(&grep->lock);
+    initCondVar(&grep->wake);
+}
+
+// Drop the queued paths and undelivered matches of the running grep, if any
+void cancelContentGrep(ContentGrep *grep) {
+    lockMutex(&grep->lock);
+    atomic_fetch_add(&grep->generation, 1);
+    for (int i = 0; i < grep->pathCount; i++) {
+        free(grep->paths[i]);
+    }
+    grep->pathCount = 0;
+    grep->foundCount = 0;
+    freeStringArena(&grep->names);
+    unlockMutex(&grep->lock);
+    grep->matchCount = 0;
+    grep->active = false;
+}
+
+// Start grepping for a literal pattern, replacing the grep in progress
+void startContentGrep(ContentGrep *grep, const char *pattern) {
+    cancelContentGrep(grep);
+    if (grep->threadCount == 0) {
+        int threadCount = getCpuCount();
+        if (threadCount > GREP_MAX_THREADS) threadCount = GREP_MAX_THREADS;
+        for (int i = 0; i < threadCount; i++) {
+            if (startThread(&grep->threads[grep->threadCount], contentGrepThread, grep)) grep->threadCount++;
+        }
+        if (grep->threadCount == 0) {
+            printf("[GREP] Could not start any grep thread\n");
+            return;
+        }
+    }
+
+    char *root = strdup("");
+    if (root == NULL) {
+        return;
+    }
+    lockMutex(&grep->lock);
+    snprintf(grep->pattern, sizeof(grep->pattern), "%s", pattern);
+    grep->patternLength = strlen(grep->pattern);
+    grep->keptTotal = 0;
+    grep->matchTotal = 0;
+    grep->matchedFiles = 0;
+    grep->filesScanned = 0;
+    grep->bytesScanned = 0;
+    uint32_t generation = atomic_load(&grep->generation);
+    unlockMutex(&grep->lock);
+    queueGrepPaths(grep, &root, 1, generation);
+
+    grep->active = true;
+    grep->startTime = getMonotonicSeconds();
+}
+
+// Take the matches found since the last call, returns true when there were any or the grep finished
+bool pollContentGrep(ContentGrep *grep) {
+    if (!grep->active) {
+        return false;
+    }
+
+    lockMutex(&grep->lock);
+    int count = grep->foundCount;
+    if (count > 0 && grep->matchCount + count > grep->matchCapacity) {
+        int capacity = grep->matchCapacity ? grep->matchCapacity : 256;
+        while (capacity < grep->matchCount + count) capacity *= 2;
+        GrepMatch *matches = (GrepMatch*)realloc(grep->matches, capacity * sizeof(GrepMatch));
+        if (matches != NULL) {
+            grep->matches = matches;
+            grep->matchCapacity = capacity;
+        } else {
+            count = 0;
+        }
+    }
+    if (count > 0) {
+        memcpy(grep->matches + grep->matchCount, grep->found, count * sizeof(GrepMatch));
+        grep->matchCount += count;
+    }
+    grep->foundCount = 0;
+    bool finished = grep->pathCount == 0 && grep->busy == 0;
+    unlockMutex(&grep->lock);
+
+    grep->elapsedMs = (getMonotonicSeconds() - grep->startTime) * 1000.0;
+    if (finished) {
+        grep->active = false;
+        printf("[GREP] \"%s\": %d lines in %d of %d files, %.1f MB in %.1f ms (%.2f GB/s)\n",
+               grep->pattern, grep->matchTotal, grep->matchedFiles, grep->filesScanned,
+               grep->bytesScanned / (1024.0 * 1024.0), grep->elapsedMs,
+               grep->elapsedMs > 0 ? grep->bytesScanned / (grep->elapsedMs * 1e6) : 0.0);
+    }
+    return count > 0 || finished;
+}
+
+// Stop the grep threads and free everything
+void freeContentGrep(ContentGrep *grep) {
+    cancelContentGrep(grep);
+    atomic_store(&grep->stopping, true);
+    lockMutex(&grep->lock);
+    broadcastCondVar(&grep->wake);
+    unlockMutex(&grep->lock);
+    for (int i = 0; i < grep->threadCount; i++) {
+        joinThread(grep->threads[i]);
+    }
+    free(grep->paths);
+    free(grep->found);
+    free(grep->matches);
+    memset(grep, 0, sizeof(*grep));
+}
+
+// Case-insensitive ASCII order of two names
+int compareNamesIgnoringCase(const char *a, const char *b) {
+    while (*a != '\0' && lowerAscii(*a) == lowerAscii(*b)) {
+        a++;
+        b++;
+    }
+    return (unsigned char)lowerAscii(*a) - (unsigned char)lowerAscii(*b);
+}
+
+// Negative when file a is listed before file b, equal keys fall back to the name
+int compareFileOrder(const ScriptIndex *index, SortMode mode, int a, int b) {
+    const FileItem *left = &index->files[a], *right = &index->files[b];
+    const ScriptRunInfo *leftRuns = peekRunInfo(index, left), *rightRuns = peekRunInfo(index, right);
+    switch (mode) {
+        case SORT_BY_MODIFIED:
+            if (left->modifiedTime != right->modifiedTime) return left->modifiedTime > right->modifiedTime ? -1 : 1;
+            break;
+        case SORT_BY_LAST_RUN:
+            if (leftRuns->lastRunTime != rightRuns->lastRunTime) return leftRuns->lastRunTime > rightRuns->lastRunTime ? -1 : 1;
+            break;
+        case SORT_BY_RUN_COUNT:
+            if (leftRuns->runCount != rightRuns->runCount) return leftRuns->runCount > rightRuns->runCount ? -1 : 1;
+            break;
+        case SORT_BY_AVERAGE_TIME:
+            if (leftRuns->averageMs != rightRuns->averageMs) return leftRuns->averageMs > rightRuns->averageMs ? -1 : 1;
+            break;
+        default:
+            break;
+    }
+    if (left->nameKey != right->nameKey) {
+        return left->nameKey < right->nameKey ? -1 : 1;
+    }
+    int order = compareNamesIgnoringCase(left->displayName, right->displayName);
+    return order != 0 ? order : strcmp(left->fileName, right->fileName);
+}
+
+// Merge the sorted runs list[0, middle) and list[middle, count), scratch holds middle entries
+void mergeFileOrder(const ScriptIndex *index, SortMode mode, int *list, int middle, int count, int *scratch) {
+    if (middle == 0 || middle == count || compareFileOrder(index, mode, list[middle - 1], list[middle]) <= 0) {
+        return;
+    }
+    memcpy(scratch, list, middle * sizeof(int));
+    int i = 0, j = middle, k = 0;
+    while (i < middle && j < count) {
+        list[k++] = compareFileOrder(index, mode, list[j], scratch[i]) < 0 ? list[j++] : scratch[i++];
+    }
+    while (i < middle) {
+        list[k++] = scratch[i++];
+    }
+}
+
+// Stable merge sort of file indices, scratch holds count / 2 entries
+void sortFileOrder(const ScriptIndex *index, SortMode mode, int *list, int count, int *scratch) {
+    if (count <= 16) {
+        for (int i = 1; i < count; i++) {
+            int value = list[i];
+            int j = i;
+            for (; j > 0 && compareFileOrder(index, mode, value, list[j - 1]) < 0; j--) {
+                list[j] = list[j - 1];
+            }
+            list[j] = value;
+        }
+        return;
+    }
+    int middle = count / 2;
+    sortFileOrder(index, mode, list, middle, scratch);
+    sortFileOrder(index, mode, list + middle, count - middle, scratch);
+    mergeFileOrder(index, mode, list, middle, count, scratch);
+}
+
+// Copy a file's sort keys from the run history (may be NULL), returns true when any of them changed.
+// Files the history does not know keep no run state for it
+bool setRunSortKeys(ScriptIndex *index, FileItem *file, RunHistory *history) {
+    const ScriptHistory *entry = history != NULL && history->loaded ?
+                                 findScriptHistory(&history->table, file->historyKey, false) : NULL;
+    int64_t lastRunTime = entry != NULL ? entry->lastRunTime : 0;
+    uint32_t runCount = entry != NULL ? entry->runs : 0;
+    uint32_t averageMs = entry != NULL && entry->runs > 0 ? (uint32_t)(entry->totalMs / entry->runs) : 0;
+    const ScriptRunInfo *current = peekRunInfo(index, file);
+    if (current->lastRunTime == lastRunTime && current->runCount == runCount && current->averageMs == averageMs) {
+        return false;
+    }
+    ScriptRunInfo *info = takeRunInfo(index, file);
+    if (info == NULL) {
+        return false;
+    }
+    info->lastRunTime = lastRunTime;
+    info->runCount = runCount;
+    info->averageMs = averageMs;
+    return true;
+}
+
+// Take a file whose key changed out of the settled part of one order, refreshScriptOrders puts it back
+void unsettleFileOrder(ScriptIndex *index, int fileIndex, SortMode mode) {
+    ScriptFolder *folder = &index->folders[index->files[fileIndex].folder];
+    int *order = folder->orders[mode];
+    for (int i = 0; i < folder->sortedCounts[mode]; i++) {
+        if (order[i] == fileIndex) {
+            memmove(&order[i], &order[i + 1], (folder->fileCount - i - 1) * sizeof(int));
+            order[folder->fileCount - 1] = fileIndex;
+            folder->sortedCounts[mode]--;
+            index->dirtyOrders |= 1u << mode;
+            return;
+        }
+    }
+}
+
+// Catch the run sort keys up with the history. Finished runs name their script, so only those files
+// move; after the history was adopted (or too many runs to tell) every key is read and the run orders re-sorted
+void updateRunSortKeys(ScriptIndex *index) {
+    RunHistory *history = index->history;
+    uint64_t seen = index->historyGeneration;
+    index->historyGeneration = history->generation;
+
+    if (history->loadGeneration <= seen && history->generation - seen <= HISTORY_CHANGED_KEYS) {
+        for (uint64_t generation = seen + 1; generation <= history->generation; generation++) {
+            int fileIndex = findIndexedFileByKey(index, history->changedKeys[generation % HISTORY_CHANGED_KEYS]);
+            if (fileIndex < 0 || !setRunSortKeys(index, &index->files[fileIndex], history)) continue;
+            for (int mode = SORT_BY_LAST_RUN; mode <= SORT_BY_AVERAGE_TIME; mode++) {
+                unsettleFileOrder(index, fileIndex, (SortMode)mode);
+            }
+        }
+        return;
+    }
+
+    for (int i = 0; i < index->count; i++) {
+        setRunSortKeys(index, &index->files[i], history);
+    }
+    for (int mode = SORT_BY_LAST_RUN; mode <= SORT_BY_AVERAGE_TIME; mode++) {
+        for (int f = 0; f < index->folderCount; f++) {
+            index->folders[f].sortedCounts[mode] = 0;
+        }
+        index->dirtyOrders |= 1u << mode;
+    }
+}
+
+// Put the entries of the shown order added or moved since the last call in place. Nothing to do on most
+// frames, otherwise a few entries are binary inserted and larger batches sorted and merged in, O(n + k log k).
+// The other orders catch up the same way once they are picked
+void refreshScriptOrders(ScriptIndex *index) {
+    if (index->history != NULL && index->history->generation != index->historyGeneration) {
+        updateRunSortKeys(index);
+    }
+    SortMode mode = index->sortMode;
+    if ((index->dirtyOrders & (1u << mode)) == 0) {
+        return;
+    }
+
+    int *scratch = NULL;
+    int scratchCapacity = 0;
+    for (int f = 0; f < index->folderCount; f++) {
+        ScriptFolder *folder = &index->folders[f];
+        int settled = folder->sortedCounts[mode];
+        int *order = folder->orders[mode];
+        if (settled >= folder->fileCount) {
+            folder->sortedCounts[mode] = folder->fileCount;
+            continue;
+        }
+
+        if (folder->fileCount - settled <= 8) {
+            for (int i = settled; i < folder->fileCount; i++) {
+                int value = order[i];
+                int low = 0, high = i;
+                while (low < high) {
+                    int middle = low + (high - low) / 2;
+                    if (compareFileOrder(index, mode, order[middle], value) <= 0) low = middle + 1;
+                    else high = middle;
+                }
+                memmove(&order[low + 1], &order[low], (i - low) * sizeof(int));
+                order[low] = value;
+            }
+        } else {
+            if (scratchCapacity < folder->fileCount) {
+                int *newScratch = (int*)realloc(scratch, folder->fileCount * sizeof(int));
+                if (newScratch == NULL) {
+                    free(scratch);
+                    return;
+                }
+                scratch = newScratch;
+                scratchCapacity = folder->fileCount;
+            }
+            sortFileOrder(index, mode, order + settled, folder->fileCount - settled, scratch);
+            mergeFileOrder(index, mode, order, settled, folder->fileCount, scratch);
+        }
+        folder->sortedCounts[mode] = folder->fileCount;
+    }
+    free(scratch);
+    index->dirtyOrders &= ~(1u << mode);
+}
+
+// Double a folder's file list together with its orders
+bool growFolderFiles(ScriptFolder *folder) {
+    int capacity = folder->fileCapacity ? folder->fileCapacity * 2 : 16;
+    int *files = (int*)realloc(folder->files, capacity * sizeof(int));
+    if (files == NULL) {
+        return false;
+    }
+    folder->files = files;
+    for (int mode = 0; mode < SORT_MODE_COUNT; mode++) {
+        int *order = (int*)realloc(folder->orders[mode], capacity * sizeof(int));
+        if (order == NULL) return false;
+        folder->orders[mode] = order;
+    }
+    folder->fileCapacity = capacity;
+    return true;
+}
+
+// Remove the first occurrence of value from a list of count entries, returns where it was or -1
+int removeIntListValue(int *list, int count, int value) {
+    for (int i = 0; i < count; i++) {
+        if (list[i] == value) {
+            memmove(&list[i], &list[i + 1], (count - i - 1) * sizeof(int));
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Free every folder's lists, keeping the folder array for reuse
+void clearScriptFolders(ScriptIndex *index) {
+    for (int i = 0; i < index->folderCount; i++) {
+        free(index->folders[i].children);
+        free(index->folders[i].files);
+        for (int mode = 0; mode < SORT_MODE_COUNT; mode++) {
+            free(index->folders[i].orders[mode]);
+        }
+    }
+    index->folderCount = 0;
+    index->lastFolder = 0;
+}
+
+// Append a collapsed folder that has not been listed yet, returns its id or -1 when out of memory
+int appendScriptFolder(ScriptIndex *index, const char *path, int parent) {
+    if (index->folderCount == index->folderCapacity) {
+        int newCapacity = index->folderCapacity ? index->folderCapacity * 2 : 16;
+        ScriptFolder *newFolders = (ScriptFolder*)realloc(index->folders, newCapacity * sizeof(ScriptFolder));
+        if (newFolders == NULL) {
+            return -1;
+        }
+        index->folders = newFolders;
+        index->folderCapacity = newCapacity;
+    }
+
+    const char *interned = internString(&index->strings, path, strlen(path));
+    if (interned == NULL) {
+        return -1;
+    }
+    ScriptFolder *folder = &index->folders[index->folderCount];
+    memset(folder, 0, sizeof(*folder));
+    folder->path = interned;
+    const char *slash = strrchr(interned, '/');
+    folder->name = slash != NULL ? slash + 1 : interned;
+    folder->parent = parent;
+    folder->depth = parent >= 0 ? index->folders[parent].depth + 1 : -1;
+    return index->folderCount++;
+}
+
+// Empty an index and point it at scriptDir, keeping the file array for reuse
+bool resetScriptIndex(ScriptIndex *index, const char *scriptDir) {
+    freeStringArena(&index->strings);
+    index->count = 0;
+    if (index->search != NULL) {
+        clearSearchIndex(index->search);
+    }
+    if (index->lookup != NULL) {
+        memset(index->lookup, 0, index->lookupCapacity * sizeof(int));
+    }
+    clearScriptFolders(index);
+    index->runInfoCount = 0;
+    index->freeRunInfo = 0;
+    index->scriptDir = internString(&index->strings, scriptDir, strlen(scriptDir));
+    if (index->scriptDir == NULL || appendScriptFolder(index, "", -1) < 0) {
+        return false;
+    }
+    index->folders[0].expanded = true;
+    index->folders[0].loaded = true;
+    return true;
+}
+
+// Free the file array, the folder tree and every string of an index
+void freeScriptIndex(ScriptIndex *index) {
+    freeStringArena(&index->strings);
+    free(index->files);
+    free(index->lookup);
+    free(index->runInfo);
+    clearScriptFolders(index);
+    free(index->folders);
+    memset(index, 0, sizeof(*index));
+}
+
+// Grow or shrink a folder's contents by delta rows and carry that up through expanded ancestors.
+// Only the path to the root is touched, so list updates never depend on the size of the tree
+void adjustFolderRows(ScriptIndex *index, int folderId, int delta) {
+    while (folderId >= 0 && delta != 0) {
+        ScriptFolder *folder = &index->folders[folderId];
+        folder->contentRows += delta;
+        if (!folder->expanded) break;
+        folderId = folder->parent;
+    }
+}
+
+// Show or hide a folder's contents, O(depth)
+void setFolderExpanded(ScriptIndex *index, int folderId, bool expanded) {
+    ScriptFolder *folder = &index->folders[folderId];
+    if (folderId == 0 || folder->expanded == expanded) {
+        return;
+    }
+    folder->expanded = expanded;
+    adjustFolderRows(index, folder->parent, expanded ? folder->contentRows : -folder->contentRows);
+}
+
+// Id of the live folder at a relative path ("" is the root), -1 when it is not in the index
+int findScriptFolder(ScriptIndex *index, const char *path, size_t length) {
+    if (length == 0) {
+        return 0;
+    }
+    for (int n = 0; n < index->folderCount; n++) {
+        int i = (index->lastFolder + n) % index->folderCount;
+        const ScriptFolder *folder = &index->folders[i];
+        if (!folder->removed && strncmp(folder->path, path, length) == 0 && folder->path[length] == '\0') {
+            index->lastFolder = i;
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Folder an entry at a relative path is listed in, -1 when that folder has not been listed
+int findParentFolder(ScriptIndex *index, const char *relativePath) {
+    const char *slash = strrchr(relativePath, '/');
+    int folderId = findScriptFolder(index, relativePath, slash != NULL ? (size_t)(slash - relativePath) : 0);
+    return folderId >= 0 && index->folders[folderId].loaded ? folderId : -1;
+}
+
+// List a subfolder, collapsed and unlisted, under its parent. Returns its id (also when it
+// was already there), or -1 when the parent is not listed or memory ran out
+int addScriptFolder(ScriptIndex *index, const char *relativePath) {
+    int parent = findParentFolder(index, relativePath);
+    if (parent < 0) {
+        return -1;
+    }
+    int existing = findScriptFolder(index, relativePath, strlen(relativePath));
+    if (existing >= 0) {
+        return existing;
+    }
+
+    int folderId = appendScriptFolder(index, relativePath, parent);
+    if (folderId < 0) {
+        return -1;
+    }
+    ScriptFolder *parentFolder = &index->folders[parent];
+    if (!appendIntList(&parentFolder->children, &parentFolder->childCount, &parentFolder->childCapacity, folderId)) {
+        index->folderCount--;
+        return -1;
+    }
+    adjustFolderRows(index, parent, 1);
+    return folderId;
+}
+
+// Resolve a list row (0 is the top line) to a folder or a file, O(depth * subfolders per level)
+bool getScriptRow(const ScriptIndex *index, int row, ScriptRow *out) {
+    if (index->folderCount == 0 || row < 0 || row >= index->folders[0].contentRows) {
+        return false;
+    }
+
+    int folderId = 0;
+    for (;;) {
+        const ScriptFolder *folder = &index->folders[folderId];
+        int next = -1;
+        for (int c = 0; c < folder->childCount && next < 0; c++) {
+            const ScriptFolder *child = &index->folders[folder->children[c]];
+            int childRows = 1 + (child->expanded ? child->contentRows : 0);
+            if (row < childRows) {
+                next = folder->children[c];
+            } else {
+                row -= childRows;
+            }
+        }
+
+        if (next < 0) {
+            if (row >= folder->fileCount) return false;
+            out->folder = folderId;
+            out->file = folder->orders[index->sortMode][row];
+            out->depth = folder->depth + 1;
+            return true;
+        }
+        if (row == 0) {
+            out->folder = next;
+            out->file = -1;
+            out->depth = index->folders[next].depth;
+            return true;
+        }
+        folderId = next;
+        row--;
+    }
+}
+
+// Add one entry to the name lookup, which must have a free slot
+void insertIndexLookup(ScriptIndex *index, int fileIndex) {
+    size_t mask = index->lookupCapacity - 1;
+    size_t slot = (size_t)index->files[fileIndex].historyKey & mask;
+    while (index->lookup[slot] != 0) {
+        slot = (slot + 1) & mask;
+    }
+    index->lookup[slot] = fileIndex + 1;
+}
+
+// Rebuild the name lookup from scratch with room for expected entries
+bool rebuildIndexLookupFor(ScriptIndex *index, int expected) {
+    size_t capacity = index->lookupCapacity ? index->lookupCapacity : 256;
+    while (capacity < (size_t)expected * 2 + 2) {
+        capacity *= 2;
+    }
+    if (capacity != index->lookupCapacity) {
+        int *lookup = (int*)realloc(index->lookup, capacity * sizeof(int));
+        if (lookup == NULL) {
+            return false;
+        }
+        index->lookup = lookup;
+        index->lookupCapacity = capacity;
+    }
+
+    memset(index->lookup, 0, index->lookupCapacity * sizeof(int));
+    for (int i = 0; i < index->count; i++) {
+        insertIndexLookup(index, i);
+    }
+    return true;
+}
+
+// Delete one entry from the name lookup. Later entries of its probe run whose home slot is at or
+// before the gap shift back into it, so no tombstones are left and probes stay short
+void removeIndexLookup(ScriptIndex *index, int fileIndex) {
+    size_t mask = index->lookupCapacity - 1;
+    size_t gap = (size_t)index->files[fileIndex].historyKey & mask;
+    while (index->lookup[gap] != fileIndex + 1) {
+        if (index->lookup[gap] == 0) return;
+        gap = (gap + 1) & mask;
+    }
+    for (size_t slot = (gap + 1) & mask; index->lookup[slot] != 0; slot = (slot + 1) & mask) {
+        size_t home = (size_t)index->files[index->lookup[slot] - 1].historyKey & mask;
+        if (((slot - home) & mask) >= ((slot - gap) & mask)) {
+            index->lookup[gap] = index->lookup[slot];
+            gap = slot;
+        }
+    }
+    index->lookup[gap] = 0;
+}
+
+// Point the lookup entry of a file that moved from index `from` to `to` (files[to] already holds it)
+void moveIndexLookup(ScriptIndex *index, int from, int to) {
+    size_t mask = index->lookupCapacity - 1;
+    for (size_t slot = (size_t)index->files[to].historyKey & mask; index->lookup[slot] != 0; slot = (slot + 1) & mask) {
+        if (index->lookup[slot] == from + 1) {
+            index->lookup[slot] = to + 1;
+            return;
+        }
+    }
+}
+
+// Rebuild the name lookup from scratch (after entries were compacted), growing it when needed
+bool rebuildIndexLookup(ScriptIndex *index) {
+    return rebuildIndexLookupFor(index, index->count);
+}
+
+// Resolve a row of the list as shown: the folder tree, or flat ranked matches while a search is entered
+bool getListRow(const ScriptIndex *index, const SearchResult *results, int resultCount, int row, ScriptRow *out) {
+    if (results == NULL) {
+        return getScriptRow(index, row, out);
+    }
+    if (row < 0 || row >= resultCount) {
+        return false;
+    }
+    out->file = findIndexedFileByKey(index, results[row].fileKey);
+    if (out->file < 0) {
+        return false;
+    }
+    out->folder = index->files[out->file].folder;
+    out->depth = 0;
+    return true;
+}
+
+// Replace the first occurrence of value in a list of count entries
+void replaceIntListValue(int *list, int count, int value, int replacement) {
+    for (int i = 0; i < count; i++) {
+        if (list[i] == value) {
+            list[i] = replacement;
+            return;
+        }
+    }
+}
+
+// Drop one entry in O(its folder's size): the last entry moves into its place, so only that one's
+// folder lists and lookup slot are patched
+void removeFileItem(ScriptIndex *index, int fileIndex) {
+    int folderId = index->files[fileIndex].folder;
+    ScriptFolder *folder = &index->folders[folderId];
+    if (removeIntListValue(folder->files, folder->fileCount, fileIndex) >= 0) {
+        for (int mode = 0; mode < SORT_MODE_COUNT; mode++) {
+            int position = removeIntListValue(folder->orders[mode], folder->fileCount, fileIndex);
+            if (position >= 0 && position < folder->sortedCounts[mode]) folder->sortedCounts[mode]--;
+        }
+        folder->fileCount--;
+    }
+    adjustFolderRows(index, folderId, -1);
+    if (index->search != NULL) {
+        removeSearchDoc(index->search, index->files[fileIndex].searchDoc);
+    }
+    removeIndexLookup(index, fileIndex);
+    releaseRunInfo(index, &index->files[fileIndex]);
+
+    int last = index->count - 1;
+    if (fileIndex != last) {
+        index->files[fileIndex] = index->files[last];
+        ScriptFolder *moved = &index->folders[index->files[fileIndex].folder];
+        replaceIntListValue(moved->files, moved->fileCount, last, fileIndex);
+        for (int mode = 0; mode < SORT_MODE_COUNT; mode++) {
+            replaceIntListValue(moved->orders[mode], moved->fileCount, last, fileIndex);
+        }
+        moveIndexLookup(index, last, fileIndex);
+    }
+    index->count--;
+}
+
+// Drop the entries of removed folders and those marked -1 in remap (count + 1 entries, the rest 0),
+// keeping the order of everything else. One O(n) pass, remap ends up holding each kept entry's new index
+void compactScriptIndex(ScriptIndex *index, int *remap) {
+    int kept = 0;
+    for (int i = 0; i < index->count; i++) {
+        if (remap[i] < 0 || index->folders[index->files[i].folder].removed) {
+            remap[i] = -1;
+            if (index->search != NULL) removeSearchDoc(index->search, index->files[i].searchDoc);
+            releaseRunInfo(index, &index->files[i]);
+        } else {
+            remap[i] = kept;
+            index->files[kept++] = index->files[i];
+        }
+    }
+    index->count = kept;
+
+    for (int f = 0; f < index->folderCount; f++) {
+        ScriptFolder *other = &index->folders[f];
+        if (other->removed) {
+            other->fileCount = 0;
+            other->childCount = 0;
+            memset(other->sortedCounts, 0, sizeof(other->sortedCounts));
+            continue;
+        }
+        int keptFiles = 0;
+        for (int i = 0; i < other->fileCount; i++) {
+            if (remap[other->files[i]] >= 0) other->files[keptFiles++] = remap[other->files[i]];
+        }
+        for (int mode = 0; mode < SORT_MODE_COUNT; mode++) {
+            int *order = other->orders[mode];
+            int settled = other->sortedCounts[mode];
+            int keptOrder = 0;
+            for (int i = 0; i < other->fileCount; i++) {
+                if (remap[order[i]] >= 0) {
+                    order[keptOrder++] = remap[order[i]];
+                } else if (i < settled) {
+                    other->sortedCounts[mode]--;
+                }
+            }
+        }
+        other->fileCount = keptFiles;
+    }
+    rebuildIndexLookup(index);
+}
+
+// qsort order for file indices, highest first
+int compareFileIndicesDescending(const void *a, const void *b) {
+    int left = *(const int*)a, right = *(const int*)b;
+    return (left < right) - (left > right);
+}
+
+// Drop the files removed by one batch of changes, which may already be out of the name lookup (the list is
+// reordered, duplicates are fine). A few are removed one by one, a larger batch such as a deleted tree of
+// files is marked and compacted in one pass
+void removeFileItems(ScriptIndex *index, int *fileIndices, int count) {
+    // Highest first, so the last entry that moves into a freed slot is never one still to remove
+    qsort(fileIndices, count, sizeof(int), compareFileIndicesDescending);
+    int *remap = count > 8 ? (int*)calloc(index->count + 1, sizeof(int)) : NULL;
+    for (int i = 0; i < count; i++) {
+        if (i > 0 && fileIndices[i] == fileIndices[i - 1]) continue;
+        if (remap == NULL) {
+            removeFileItem(index, fileIndices[i]);
+            continue;
+        }
+        remap[fileIndices[i]] = -1;
+        adjustFolderRows(index, index->files[fileIndices[i]].folder, -1);
+    }
+    if (remap != NULL) {
+        compactScriptIndex(index, remap);
+        free(remap);
+    }
+}
+
+// Drop a deleted folder together with every folder and file listed under it
+void removeScriptFolder(ScriptIndex *index, int folderId) {
+    ScriptFolder *folder = &index->folders[folderId];
+    if (folderId == 0 || folder->removed) {
+        return;
+    }
+
+    ScriptFolder *parent = &index->folders[folder->parent];
+    adjustFolderRows(index, folder->parent, -(1 + (folder->expanded ? folder->contentRows : 0)));
+    for (int c = 0; c < parent->childCount; c++) {
+        if (parent->children[c] == folderId) {
+            memmove(&parent->children[c], &parent->children[c + 1], (parent->childCount - c - 1) * sizeof(int));
+            parent->childCount--;
+            break;
+        }
+    }
+
+    // A folder's id is always above its parent's, so one pass marks the whole subtree
+    folder->removed = true;
+    for (int f = folderId + 1; f < index->folderCount; f++) {
+        if (!index->folders[f].removed && index->folders[index->folders[f].parent].removed) {
+            index->folders[f].removed = true;
+        }
+    }
+
+    int *remap = (int*)calloc(index->count + 1, sizeof(int));
+    if (remap == NULL) {
+        return;
+    }
+    compactScriptIndex(index, remap);
+    free(remap);
+}
+
+// Point an entry's kort:after list at an interned copy ("" needs none)
+void setFileDependencies(ScriptIndex *index, FileItem *file, const char *dependsOn) {
+    const char *interned = dependsOn[0] != '\0' ? internString(&index->strings, dependsOn, strlen(dependsOn)) : NULL;
+    file->dependsOn = interned != NULL ? interned : "";
+}
+
+// Make room for count entries in one allocation, when the final size is known up front
+bool reserveScriptIndex(ScriptIndex *index, int count) {
+    if (count > index->capacity) {
+        FileItem *newFiles = (FileItem*)realloc(index->files, count * sizeof(FileItem));
+        if (newFiles == NULL) {
+            return false;
+        }
+        index->files = newFiles;
+        index->capacity = count;
+    }
+    return (size_t)count * 2 <= index->lookupCapacity || rebuildIndexLookupFor(index, count);
+}
+
+// Append an idle entry for the file at relative path name, listed in folderId. Returns NULL when out of memory
+FileItem *addFileItem(ScriptIndex *index, int folderId, const char *name, const ScriptMetadata *metadata) {
+    if (index->count == index->capacity) {
+        int newCapacity = index->capacity ? index->capacity * 2 : 64;
+        FileItem *newFiles = (FileItem*)realloc(index->files, newCapacity * sizeof(FileItem));
+        if (newFiles == NULL) {
+            return NULL;
+        }
+        index->files = newFiles;
+        index->capacity = newCapacity;
+    }
+
+    ScriptFolder *folder = &index->folders[folderId];
+    if (folder->fileCount == folder->fileCapacity && !growFolderFiles(folder)) {
+        return NULL;
+    }
+
+    const char *slash = strrchr(name, '/');
+    const char *baseName = slash != NULL ? slash + 1 : name;
+    const char *dot = strchr(baseName, '.');
+    size_t nameLength = strlen(name);
+    const char *fileName = internString(&index->strings, name, nameLength);
+    const char *displayName = internString(&index->strings, baseName, dot != NULL ? (size_t)(dot - baseName) : strlen(baseName));
+    if (fileName == NULL || displayName == NULL) {
+        return NULL;
+    }
+    if ((size_t)(index->count + 1) * 2 > index->lookupCapacity && !rebuildIndexLookup(index)) {
+        return NULL;
+    }
+
+    FileItem *file = &index->files[index->count++];
+    memset(file, 0, sizeof(*file));
+    file->fileName = fileName;
+    file->displayName = displayName;
+    const char *ext = strrchr(fileName + (baseName - name), '.');
+    file->fileExtension = ext != NULL ? ext : fileName + nameLength;
+    file->runInfo = -1;
+    file->historyKey = hashScriptName(name);
+    file->timeoutSeconds = metadata->timeoutSeconds;
+    file->modifiedTime = metadata->modifiedTime;
+    file->fileSize = metadata->fileSize;
+    file->folder = folderId;
+    file->searchDoc = index->search != NULL ? addSearchDoc(index->search, file) : UINT32_MAX;
+    setRunSortKeys(index, file, index->history);
+    for (int i = 0; i < 8; i++) {
+        file->nameKey = file->nameKey << 8 | (unsigned char)lowerAscii(displayName[i]);
+        if (displayName[i] == '\0') {
+            file->nameKey <<= 8 * (7 - i);
+            break;
+        }
+    }
+    setFileDependencies(index, file, metadata->dependsOn);
+    insertIndexLookup(index, index->count - 1);
+
+    // Appended to every order, refreshScriptOrders puts it in place
+    for (int mode = 0; mode < SORT_MODE_COUNT; mode++) {
+        folder->orders[mode][folder->fileCount] = index->count - 1;
+    }
+    folder->files[folder->fileCount++] = index->count - 1;
+    index->dirtyOrders = (1u << SORT_MODE_COUNT) - 1;
+    adjustFolderRows(index, folderId, 1);
+    return file;
+}
+
+// List one folder's directory into the index, its subfolders stay unlisted
+int loadScriptFolder(ScriptIndex *index, int folderId) {
+    index->folders[folderId].loaded = true;
+    const char *folderPath = index->folders[folderId].path;
+
+    char dirPath[1024];
+    snprintf(dirPath, sizeof(dirPath), folderPath[0] != '\0' ? "%s/%s" : "%s", index->scriptDir, folderPath);
+    DIR *dir = opendir(dirPath);
+    if (dir == NULL) {
+        return 0;
+    }
+
+    struct dirent *entry;
+    char relativePath[1024];
+    char filePath[1536];
+    ScriptMetadata metadata;
+    int added = 0;
+
+    while ((entry = readdir(dir))) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+            continue;
+
+        snprintf(relativePath, sizeof(relativePath), folderPath[0] != '\0' ? "%s/%s" : "%s%s", folderPath, entry->d_name);
+        snprintf(filePath, sizeof(filePath), "%s/%s", index->scriptDir, relativePath);
+        if (!parseScriptMetadata(filePath, &metadata)) {
+            continue;
+        }
+        bool ok = metadata.isDirectory ? addScriptFolder(index, relativePath) >= 0 :
+                                         addFileItem(index, folderId, relativePath, &metadata) != NULL;
+        if (!ok) {
+            printf("[INDEX] Out of memory after %d scripts\n", index->count);
+            break;
+        }
+        added++;
+    }
+    closedir(dir);
+
+    return added;
+}
+
+// Reload files from directory, only its top level is listed
+int loadFiles(ScriptIndex *index, const char *scriptDir) {
+    if (!resetScriptIndex(index, scriptDir)) {
+        return 0;
+    }
+    loadScriptFolder(index, 0);
+    return index->count;
+}
+
+// Reload files and carry selection, last results and run state over to the new entries
+void reloadFiles(ScriptIndex *index, RunManager *manager, WorkerPool *pool) {
+    // The old entries (and the strings they point at) stay alive until they have been matched
+    ScriptIndex previous = *index;
+    memset(index, 0, sizeof(*index));
+    index->search = previous.search;
+    index->history = previous.history;
+    index->sortMode = previous.sortMode;
+    char scriptDir[512];
+    snprintf(scriptDir, sizeof(scriptDir), "%s", previous.scriptDir);
+    loadFiles(index, scriptDir);
+
+    // Parents come before their subfolders, so each folder is found once its parent is listed
+    for (int i = 1; i < previous.folderCount; i++) {
+        const ScriptFolder *old = &previous.folders[i];
+        if (old->removed || !old->loaded) continue;
+        int folderId = findScriptFolder(index, old->path, strlen(old->path));
+        if (folderId < 0) continue;
+        loadScriptFolder(index, folderId);
+        setFolderExpanded(index, folderId, old->expanded);
+    }
+
+    FileItem *files = index->files;
+    int fileCount = index->count;
+    for (int i = 0; i < previous.count; i++) {
+        int fileIndex = findIndexedFile(index, previous.files[i].fileName);
+        if (fileIndex < 0) continue;
+        files[fileIndex].isSelected = previous.files[i].isSelected;
+        const ScriptRunInfo *old = peekRunInfo(&previous, &previous.files[i]);
+        ScriptRunInfo *info = old->hasResult ? takeRunInfo(index, &files[fileIndex]) : NULL;
+        if (info != NULL) {
+            info->hasResult = true;
+            info->lastResult = old->lastResult;
+        }
+    }
+    freeScriptIndex(&previous);
+
+    for (int i = 0; i < MAX_RUNS; i++) {
+        ScriptRun *run = &manager->runs[i];
+        if (!run->active || run->filePath[0] == '\0') continue;
+        int fileIndex = findIndexedPath(index, run->filePath);
+        run->fileIndex = fileIndex;
+        ScriptRunInfo *info = fileIndex >= 0 ? takeRunInfo(index, &files[fileIndex]) : NULL;
+        if (info != NULL) {
+            info->activeRuns++;
+            if (run->cancelRequested) info->stoppingRuns++;
+            info->pid = run->pid;
+        }
+    }
+
+    lockMutex(&pool->lock);
+    for (int i = 0; i < pool->jobCount; i++) {
+        int fileIndex = findIndexedPath(index, pool->jobs[(pool->jobHead + i) % pool->jobCapacity].filePath);
+        ScriptRunInfo *info = fileIndex >= 0 ? takeRunInfo(index, &files[fileIndex]) : NULL;
+        if (info != NULL) info->queuedRuns++;
+    }
+    unlockMutex(&pool->lock);
+
+    for (int i = 0; i < fileCount; i++) {
+        if (files[i].runInfo >= 0) refreshRunState(&index->runInfo[files[i].runInfo]);
+    }
+}
+
+// Map the index cache of scriptDir, returns false (header NULL) when there is no usable one
+bool openIndexCache(IndexCache *cache, const char *scriptDir) {
+    memset(cache, 0, sizeof(*cache));
+    if (!getDataFilePath(scriptDir, INDEX_CACHE_FILE_NAME, cache->path, sizeof(cache->path))) {
+        return false;
+    }
+
+    cache->data = mapReadOnlyFile(cache->path, &cache->size);
+    if (cache->data == NULL) {
+        return false;
+    }
+
+    // Every offset must land inside the blob and the blob must end in a terminator,
+    // then no string can run past the mapping whatever the file contains
+    const IndexCacheHeader *header = (const IndexCacheHeader*)cache->data;
+    bool valid = cache->size >= sizeof(IndexCacheHeader) &&
+                 header->magic == INDEX_CACHE_MAGIC && header->version == INDEX_CACHE_VERSION &&
+                 header->entrySize == sizeof(IndexCacheEntry) &&
+                 cache->size == sizeof(IndexCacheHeader) + (size_t)header->entryCount * sizeof(IndexCacheEntry) + header->stringBytes &&
+                 header->stringBytes > 0 && cache->data[cache->size - 1] == '\0' &&
+                 header->scriptDirOffset < header->stringBytes;
+    if (valid) {
+        cache->entries = (const IndexCacheEntry*)(cache->data + sizeof(IndexCacheHeader));
+        cache->strings = (const char*)(cache->entries + header->entryCount);
+        valid = strcmp(cache->strings + header->scriptDirOffset, scriptDir) == 0;
+        for (uint32_t i = 0; valid && i < header->entryCount; i++) {
+            valid = cache->entries[i].nameOffset < header->stringBytes && cache->entries[i].dependsOnOffset < header->stringBytes;
+        }
+    }
+
+    if (!valid) {
+        printf("[STARTUP] Ignoring %s: unknown format or another directory\n", cache->path);
+        unmapReadOnlyFile(cache->data, cache->size);
+        cache->data = NULL;
+        cache->entries = NULL;
+        cache->strings = NULL;
+        return false;
+    }
+    cache->header = header;
+    return true;
+}
+
+// Unmap the cache, its path stays set for saveIndexCache
+void closeIndexCache(IndexCache *cache) {
+    if (cache->data != NULL) {
+        unmapReadOnlyFile(cache->data, cache->size);
+    }
+    cache->data = NULL;
+    cache->header = NULL;
+    cache->entries = NULL;
+    cache->strings = NULL;
+}
+
+// Fill an empty index with the cached top-level listing, no file in the directory is touched
+int loadIndexCache(const IndexCache *cache, ScriptIndex *index) {
+    if (cache->header == NULL) {
+        return 0;
+    }
+
+    if (!reserveScriptIndex(index, (int)cache->header->entryCount)) {
+        return 0;
+    }
+
+    ScriptMetadata metadata;
+    for (uint32_t i = 0; i < cache->header->entryCount; i++) {
+        const IndexCacheEntry *entry = &cache->entries[i];
+        const char *dependsOn = cache->strings + entry->dependsOnOffset;
+        size_t dependsLength = strlen(dependsOn);
+        if (dependsLength >= sizeof(metadata.dependsOn)) dependsLength = sizeof(metadata.dependsOn) - 1;
+        memcpy(metadata.dependsOn, dependsOn, dependsLength);
+        metadata.dependsOn[dependsLength] = '\0';
+        metadata.timeoutSeconds = entry->timeoutSeconds;
+        metadata.modifiedTime = entry->modifiedTime;
+        metadata.fileSize = entry->fileSize;
+        const char *name = cache->strings + entry->nameOffset;
+        bool ok = (entry->flags & INDEX_CACHE_DIRECTORY) ? addScriptFolder(index, name) >= 0 :
+                                                           addFileItem(index, 0, name, &metadata) != NULL;
+        if (!ok) {
+            break;
+        }
+    }
+    return index->count;
+}
+
+// Write the top level of the index to the cache file, through a temporary file so a crash never
+// leaves half a cache. Subfolders are stored as names only, they are listed again when expanded
+bool saveIndexCache(const char *path, const ScriptIndex *index, int64_t dirModifiedTime) {
+    const ScriptFolder *root = &index->folders[0];
+    // In name order, so the next start sorts them in a single pass
+    const int *files = root->orders[SORT_BY_NAME];
+
+    // Strings are laid out as scriptDir, then name and dependsOn of each subfolder and file
+    size_t stringBytes = strlen(index->scriptDir) + 1;
+    for (int c = 0; c < root->childCount; c++) {
+        stringBytes += strlen(index->folders[root->children[c]].path) + 2;
+    }
+    for (int i = 0; i < root->fileCount; i++) {
+        const FileItem *item = &index->files[files[i]];
+        stringBytes += strlen(item->fileName) + strlen(item->dependsOn) + 2;
+    }
+    if (stringBytes > UINT32_MAX) {
+        return false;
+    }
+
+    char tempPath[600];
+    snprintf(tempPath, sizeof(tempPath), "%s.tmp", path);
+    FILE *file = fopen(tempPath, "wb");
+    if (file == NULL) {
+        printf("[STARTUP] Cannot write %s\n", tempPath);
+        return false;
+    }
+
+    IndexCacheHeader header = { INDEX_CACHE_MAGIC, INDEX_CACHE_VERSION, sizeof(IndexCacheEntry),
+                                (uint32_t)(root->childCount + root->fileCount), dirModifiedTime, (uint32_t)stringBytes, 0 };
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+
+    uint32_t offset = (uint32_t)strlen(index->scriptDir) + 1;
+    for (int c = 0; ok && c < root->childCount; c++) {
+        const ScriptFolder *folder = &index->folders[root->children[c]];
+        IndexCacheEntry entry = {0};
+        entry.nameKey = hashScriptName(folder->path);
+        entry.flags = INDEX_CACHE_DIRECTORY;
+        entry.nameOffset = offset;
+        offset += (uint32_t)strlen(folder->path) + 1;
+        entry.dependsOnOffset = offset;
+        offset += 1;
+        ok = fwrite(&entry, sizeof(entry), 1, file) == 1;
+    }
+    for (int i = 0; ok && i < root->fileCount; i++) {
+        const FileItem *item = &index->files[files[i]];
+        IndexCacheEntry entry = {0};
+        entry.nameKey = item->historyKey;
+        entry.modifiedTime = item->modifiedTime;
+        entry.fileSize = item->fileSize;
+        entry.timeoutSeconds = item->timeoutSeconds;
+        entry.nameOffset = offset;
+        offset += (uint32_t)strlen(item->fileName) + 1;
+        entry.dependsOnOffset = offset;
+        offset += (uint32_t)strlen(item->dependsOn) + 1;
+        ok = fwrite(&entry, sizeof(entry), 1, file) == 1;
+    }
+
+    ok = ok && fwrite(index->scriptDir, strlen(index->scriptDir) + 1, 1, file) == 1;
+    for (int c = 0; ok && c < root->childCount; c++) {
+        const char *folderPath = index->folders[root->children[c]].path;
+        // The folder's dependsOn is the empty string after its name
+        ok = fwrite(folderPath, strlen(folderPath) + 1, 1, file) == 1 && fwrite("", 1, 1, file) == 1;
+    }
+    for (int i = 0; ok && i < root->fileCount; i++) {
+        const FileItem *item = &index->files[files[i]];
+        ok = fwrite(item->fileName, strlen(item->fileName) + 1, 1, file) == 1 &&
+             fwrite(item->dependsOn, strlen(item->dependsOn) + 1, 1, file) == 1;
+    }
+
+    if (fclose(file) != 0) ok = false;
+#ifdef PLATFORM_WINDOWS
+    if (ok) remove(path);
+#endif
+    if (!ok || rename(tempPath, path) != 0) {
+        printf("[STARTUP] Could not save %s\n", path);
+        remove(tempPath);
+        return false;
+    }
+    return true;
+}
+
+// Hand a change to the UI
+void queueScriptChange(ScriptWatcher *watcher, const ScriptChange *change) {
+    lockMutex(&watcher->lock);
+    if (watcher->changeCount == watcher->changeCapacity) {
+        int newCapacity = watcher->changeCapacity ? watcher->changeCapacity * 2 : 16;
+        ScriptChange *newChanges = (ScriptChange*)realloc(watcher->changes, newCapacity * sizeof(ScriptChange));
+        if (newChanges == NULL) {
+            unlockMutex(&watcher->lock);
+            return;
+        }
+        watcher->changes = newChanges;
+        watcher->changeCapacity = newCapacity;
+    }
+    watcher->changes[watcher->changeCount++] = *change;
+    unlockMutex(&watcher->lock);
+}
+
+// Join a directory and a name below it (either may be ""), false when the result does not fit
+bool joinWatchPath(char *buffer, size_t bufferSize, const char *directory, const char *name) {
+    int length = snprintf(buffer, bufferSize, directory[0] != '\0' && name[0] != '\0' ? "%s/%s" : "%s%s", directory, name);
+    if (length < 0 || (size_t)length >= bufferSize) {
+        printf("[WATCH] Skipping %s%s%s: path too long\n", directory, directory[0] != '\0' ? "/" : "", name);
+        return false;
+    }
+    return true;
+}
+
+// Queue a change for the UI, an upsert parses the file here so the UI thread never touches the disk.
+// A name that does not fit is skipped, truncated it could name a different file
+void postScriptChange(ScriptWatcher *watcher, ScriptChangeType type, const char *name) {
+    ScriptChange change;
+    change.type = type;
+    if (!joinWatchPath(change.fileName, sizeof(change.fileName), "", name != NULL ? name : "")) {
+        return;
+    }
+    if (type == SCRIPT_CHANGE_UPSERT) {
+        char filePath[PATH_MAX];
+        if (!joinWatchPath(filePath, sizeof(filePath), watcher->scriptDir, name)) {
+            return;
+        }
+        // Already gone again, its remove event follows (or the scan raced a delete)
+        if (!parseScriptMetadata(filePath, &change.metadata)) {
+            return;
+        }
+    }
+    queueScriptChange(watcher, &change);
+}
+
+#ifdef PLATFORM_WINDOWS
+// Watcher thread: block in ReadDirectoryChangesW until stopping is set and the read is cancelled
+void *scriptWatcherThread(void *arg) {
+    ScriptWatcher *watcher = (ScriptWatcher*)arg;
+    DWORD buffer[4096];
+    DWORD bytesReturned = 0;
+    DWORD filter = FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME | FILE_NOTIFY_CHANGE_LAST_WRITE;
+
+    // The whole tree is watched, changes inside folders that are not listed are dropped when applied
+    while (!atomic_load(&watcher->stopping) &&
+           ReadDirectoryChangesW(watcher->dirHandle, buffer, sizeof(buffer), TRUE, filter, &bytesReturned, NULL, NULL)) {
+        // Zero bytes means the system buffer overflowed and events were dropped
+        if (bytesReturned == 0) {
+            postScriptChange(watcher, SCRIPT_CHANGE_RESCAN, NULL);
+            continue;
+        }
+
+        FILE_NOTIFY_INFORMATION *info = (FILE_NOTIFY_INFORMATION*)buffer;
+        for (;;) {
+            char name[MAX_PATH];
+            int nameLength = WideCharToMultiByte(CP_ACP, 0, info->FileName, (int)(info->FileNameLength / sizeof(WCHAR)),
+                                                 name, sizeof(name) - 1, NULL, NULL);
+            name[nameLength] = '\0';
+            for (char *c = name; *c != '\0'; c++) {
+                if (*c == '\\') *c = '/';
+            }
+
+            if (nameLength > 0) {
+                if (info->Action == FILE_ACTION_REMOVED || info->Action == FILE_ACTION_RENAMED_OLD_NAME) {
+                    postScriptChange(watcher, SCRIPT_CHANGE_REMOVE, name);
+                } else {
+                    postScriptChange(watcher, SCRIPT_CHANGE_UPSERT, name);
+                }
+            }
+
+            if (info->NextEntryOffset == 0) break;
+            info = (FILE_NOTIFY_INFORMATION*)((char*)info + info->NextEntryOffset);
+        }
+    }
+    return NULL;
+}
+#else
+// Watch one listed folder of the tree ("" for the root), returns false when inotify refuses
+bool addScriptWatch(ScriptWatcher *watcher, const char *folderPath) {
+    char dirPath[PATH_MAX];
+    if (!joinWatchPath(dirPath, sizeof(dirPath), watcher->scriptDir, folderPath)) {
+        return false;
+    }
+    uint32_t mask = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_CLOSE_WRITE |
+                    IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR;
+    int wd = inotify_add_watch(watcher->inotifyFd, dirPath, mask);
+    if (wd < 0) {
+        printf("[WATCH] Could not watch %s: %s\n", dirPath, strerror(errno));
+        return false;
+    }
+
+    // Watching the same directory again hands back the same wd
+    lockMutex(&watcher->lock);
+    int slot = 0;
+    while (slot < watcher->watchedCount && watcher->watchedFolders[slot].wd != wd) slot++;
+    if (slot == watcher->watchedCount && watcher->watchedCount == watcher->watchedCapacity) {
+        int newCapacity = watcher->watchedCapacity ? watcher->watchedCapacity * 2 : 16;
+        WatchedFolder *newFolders = (WatchedFolder*)realloc(watcher->watchedFolders, newCapacity * sizeof(WatchedFolder));
+        if (newFolders == NULL) {
+            unlockMutex(&watcher->lock);
+            inotify_rm_watch(watcher->inotifyFd, wd);
+            return false;
+        }
+        watcher->watchedFolders = newFolders;
+        watcher->watchedCapacity = newCapacity;
+    }
+    if (slot == watcher->watchedCount) watcher->watchedCount++;
+    watcher->watchedFolders[slot].wd = wd;
+    snprintf(watcher->watchedFolders[slot].path, sizeof(watcher->watchedFolders[slot].path), "%s", folderPath);
+    unlockMutex(&watcher->lock);
+    return true;
+}
+
+// Relative path of the folder behind a wd, forgetting it once the kernel dropped the watch
+bool findWatchedFolder(ScriptWatcher *watcher, int wd, char *path, size_t pathSize, bool forget) {
+    bool found = false;
+    lockMutex(&watcher->lock);
+    for (int i = 0; i < watcher->watchedCount; i++) {
+        if (watcher->watchedFolders[i].wd != wd) continue;
+        snprintf(path, pathSize, "%s", watcher->watchedFolders[i].path);
+        if (forget) {
+            watcher->watchedFolders[i] = watcher->watchedFolders[--watcher->watchedCount];
+        }
+        found = true;
+        break;
+    }
+    unlockMutex(&watcher->lock);
+    return found;
+}
+
+// Watcher thread: turn inotify events into changes until the stop pipe is written
+void *scriptWatcherThread(void *arg) {
+    ScriptWatcher *watcher = (ScriptWatcher*)arg;
+    char buffer[16384] __attribute__((aligned(__alignof__(struct inotify_event))));
+    struct pollfd pfds[2] = {
+        { watcher->inotifyFd, POLLIN, 0 },
+        { watcher->stopPipe[0], POLLIN, 0 },
+    };
+
+    for (;;) {
+        if (poll(pfds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (pfds[1].revents != 0) {
+            break;
+        }
+
+        ssize_t length = read(watcher->inotifyFd, buffer, sizeof(buffer));
+        if (length <= 0) {
+            if (length < 0 && (errno == EINTR || errno == EAGAIN)) continue;
+            break;
+        }
+
+        for (char *cursor = buffer; cursor < buffer + length; ) {
+            const struct inotify_event *event = (const struct inotify_event*)cursor;
+            cursor += sizeof(struct inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                postScriptChange(watcher, SCRIPT_CHANGE_RESCAN, NULL);
+                continue;
+            }
+            char folderPath[PATH_MAX];
+            if (!findWatchedFolder(watcher, event->wd, folderPath, sizeof(folderPath), (event->mask & IN_IGNORED) != 0)) {
+                continue;
+            }
+            // A subfolder going away is reported as an entry of its parent
+            if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF)) {
+                if (folderPath[0] == '\0') postScriptChange(watcher, SCRIPT_CHANGE_RESCAN, NULL);
+                continue;
+            }
+            if (event->len == 0) {
+                continue;
+            }
+
+            char name[PATH_MAX];
+            if (!joinWatchPath(name, sizeof(name), folderPath, event->name)) {
+                continue;
+            }
+            if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                postScriptChange(watcher, SCRIPT_CHANGE_REMOVE, name);
+            } else if (event->mask & (IN_CREATE | IN_MOVED_TO | IN_CLOSE_WRITE)) {
+                postScriptChange(watcher, SCRIPT_CHANGE_UPSERT, name);
+            }
+        }
+    }
+    return NULL;
+}
+#endif
+
+// Start watching scriptDir, returns false when the platform can't (callers then rescan after their own edits)
+bool startScriptWatcher(ScriptWatcher *watcher, const char *scriptDir) {
+    memset(watcher, 0, sizeof(*watcher));
+    snprintf(watcher->scriptDir, sizeof(watcher->scriptDir), "%s", scriptDir);
+    initMutex(&watcher->lock);
+    initCondVar(&watcher->scanWake);
+
+#ifdef PLATFORM_WINDOWS
+    watcher->dirHandle = CreateFileA(scriptDir, FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                     NULL, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, NULL);
+    if (watcher->dirHandle == INVALID_HANDLE_VALUE) {
+        printf("[WATCH] Could not open %s, the list refreshes only after in-app edits\n", scriptDir);
+        return false;
+    }
+    if (!startThread(&watcher->thread, scriptWatcherThread, watcher)) {
+        CloseHandle(watcher->dirHandle);
+        return false;
+    }
+#else
+    watcher->inotifyFd = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+    if (watcher->inotifyFd < 0) {
+        printf("[WATCH] inotify unavailable (%s), the list refreshes only after in-app edits\n", strerror(errno));
+        return false;
+    }
+
+    if (!addScriptWatch(watcher, "")) {
+        close(watcher->inotifyFd);
+        free(watcher->watchedFolders);
+        watcher->watchedFolders = NULL;
+        return false;
+    }
+    if (pipe2(watcher->stopPipe, O_CLOEXEC) != 0) {
+        printf("[WATCH] Could not create the stop pipe: %s\n", strerror(errno));
+        close(watcher->inotifyFd);
+        free(watcher->watchedFolders);
+        watcher->watchedFolders = NULL;
+        return false;
+    }
+
+    if (!startThread(&watcher->thread, scriptWatcherThread, watcher)) {
+        close(watcher->inotifyFd);
+        close(watcher->stopPipe[0]);
+        close(watcher->stopPipe[1]);
+        free(watcher->watchedFolders);
+        watcher->watchedFolders = NULL;
+        return false;
+    }
+#endif
+
+    watcher->running = true;
+    return true;
+}
+
+// True when a stat result still matches what the cache recorded for an entry
+bool isCacheEntryCurrent(const IndexCacheEntry *entry, const struct stat *info) {
+    if (entry->flags & INDEX_CACHE_DIRECTORY) {
+        return S_ISDIR(info->st_mode);
+    }
+    return !S_ISDIR(info->st_mode) && getModifiedTime(info) == entry->modifiedTime && (int64_t)info->st_size == entry->fileSize;
+}
+
+// The directory did not change since the cache was written, so only the cached files themselves
+// can be stale: stat each one and reparse or drop those that differ. No directory listing is read
+void validateCachedScripts(ScriptWatcher *watcher, const IndexCache *cache) {
+    char filePath[PATH_MAX];
+    struct stat info;
+    for (uint32_t i = 0; i < cache->header->entryCount && !atomic_load(&watcher->stopping); i++) {
+        const IndexCacheEntry *entry = &cache->entries[i];
+        const char *name = cache->strings + entry->nameOffset;
+        if (!joinWatchPath(filePath, sizeof(filePath), watcher->scriptDir, name)) {
+            continue;
+        }
+
+        if (stat(filePath, &info) != 0) {
+            if (errno != ENOENT) continue;
+            postScriptChange(watcher, SCRIPT_CHANGE_REMOVE, name);
+            watcher->scanChangedIndex = true;
+        } else if (!isCacheEntryCurrent(entry, &info)) {
+            postScriptChange(watcher, SCRIPT_CHANGE_UPSERT, name);
+            watcher->scanChangedIndex = true;
+        }
+    }
+}
+
+// List the directory and post what differs from the cache (everything when there is none):
+// new or modified files are parsed, unchanged ones are skipped, cached ones not seen are removed
+void scanScriptDirectory(ScriptWatcher *watcher, const IndexCache *cache) {
+    uint32_t cachedCount = cache != NULL && cache->header != NULL ? cache->header->entryCount : 0;
+
+    // Open addressing over the cached entries, holds entry index + 1 (0 is free)
+    size_t slotCount = 16;
+    while (slotCount < (size_t)cachedCount * 2) slotCount *= 2;
+    uint32_t *slots = (uint32_t*)calloc(slotCount, sizeof(uint32_t));
+    bool *seen = (bool*)calloc(cachedCount + 1, sizeof(bool));
+    if (slots == NULL || seen == NULL) {
+        cachedCount = 0;
+    }
+    for (uint32_t i = 0; i < cachedCount; i++) {
+        size_t slot = (size_t)cache->entries[i].nameKey & (slotCount - 1);
+        while (slots[slot] != 0) slot = (slot + 1) & (slotCount - 1);
+        slots[slot] = i + 1;
+    }
+
+    DIR *dir = opendir(watcher->scriptDir);
+    if (dir == NULL) {
+        printf("[STARTUP] Could not open %s: %s\n", watcher->scriptDir, strerror(errno));
+        free(slots);
+        free(seen);
+        return;
+    }
+
+    struct dirent *dirEntry;
+    char filePath[PATH_MAX];
+    struct stat info;
+    while (!atomic_load(&watcher->stopping) && (dirEntry = readdir(dir))) {
+        const char *name = dirEntry->d_name;
+        if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0)
+            continue;
+
+        const IndexCacheEntry *cached = NULL;
+        if (cachedCount > 0) {
+            uint64_t key = hashScriptName(name);
+            for (size_t slot = (size_t)key & (slotCount - 1); slots[slot] != 0; slot = (slot + 1) & (slotCount - 1)) {
+                const IndexCacheEntry *entry = &cache->entries[slots[slot] - 1];
+                if (entry->nameKey == key && strcmp(cache->strings + entry->nameOffset, name) == 0) {
+                    cached = entry;
+                    seen[slots[slot] - 1] = true;
+                    break;
+                }
+            }
+        }
+
+        if (cached != NULL && joinWatchPath(filePath, sizeof(filePath), watcher->scriptDir, name)) {
+            if (stat(filePath, &info) == 0 && isCacheEntryCurrent(cached, &info)) {
+                continue;
+            }
+        }
+        postScriptChange(watcher, SCRIPT_CHANGE_UPSERT, name);
+    }
+    closedir(dir);
+
+    // An aborted scan has not seen everything, so it must not remove anything
+    for (uint32_t i = 0; i < cachedCount && !atomic_load(&watcher->stopping); i++) {
+        if (!seen[i]) {
+            postScriptChange(watcher, SCRIPT_CHANGE_REMOVE, cache->strings + cache->entries[i].nameOffset);
+        }
+    }
+    watcher->scanChangedIndex = true;
+    free(slots);
+    free(seen);
+}
+
+// Post every entry of a folder that was just expanded, watching it first so nothing created meanwhile is missed
+void listScriptFolder(ScriptWatcher *watcher, const char *folderPath) {
+#ifndef PLATFORM_WINDOWS
+    if (watcher->running) {
+        addScriptWatch(watcher, folderPath);
+    }
+#endif
+
+    char dirPath[PATH_MAX];
+    if (!joinWatchPath(dirPath, sizeof(dirPath), watcher->scriptDir, folderPath)) {
+        return;
+    }
+    DIR *dir = opendir(dirPath);
+    if (dir == NULL) {
+        printf("[INDEX] Could not open %s: %s\n", dirPath, strerror(errno));
+        return;
+    }
+
+    struct dirent *entry;
+    char name[PATH_MAX];
+    while (!atomic_load(&watcher->stopping) && (entry = readdir(dir))) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+            continue;
+        if (joinWatchPath(name, sizeof(name), folderPath, entry->d_name)) {
+            postScriptChange(watcher, SCRIPT_CHANGE_UPSERT, name);
+        }
+    }
+    closedir(dir);
+}
+
+// List the oldest folder an expand asked for, waiting for one when wait is set. False once stopping, or when none is pending
+bool serveFolderRequest(ScriptWatcher *watcher, bool wait) {
+    lockMutex(&watcher->lock);
+    while (wait && watcher->folderRequestCount == 0 && !atomic_load(&watcher->stopping)) {
+        waitCondVar(&watcher->scanWake, &watcher->lock);
+    }
+    if (watcher->folderRequestCount == 0 || atomic_load(&watcher->stopping)) {
+        unlockMutex(&watcher->lock);
+        return false;
+    }
+    char folderPath[PATH_MAX];
+    memcpy(folderPath, watcher->folderRequests[0], sizeof(folderPath));
+    watcher->folderRequestCount--;
+    memmove(watcher->folderRequests[0], watcher->folderRequests[1], watcher->folderRequestCount * sizeof(watcher->folderRequests[0]));
+    unlockMutex(&watcher->lock);
+
+    listScriptFolder(watcher, folderPath);
+    return true;
+}
+
+// Push a copy of a relative path onto the tree walk's stack, returns false when out of memory
+bool pushTreePath(char ***stack, int *count, int *capacity, const char *path) {
+    if (*count == *capacity) {
+        int newCapacity = *capacity ? *capacity * 2 : 64;
+        char **newStack = (char**)realloc(*stack, newCapacity * sizeof(char*));
+        if (newStack == NULL) {
+            return false;
+        }
+        *stack = newStack;
+        *capacity = newCapacity;
+    }
+    char *copy = strdup(path);
+    if (copy == NULL) {
+        return false;
+    }
+    (*stack)[(*count)++] = copy;
+    return true;
+}
+
+// Queue every script in the subfolders for name search, expanded or not. Expands are served between
+// folders, and the walk waits while the indexer is behind, so it never holds up the list or floods memory
+void feedScriptTree(ScriptWatcher *watcher) {
+    if (watcher->search == NULL || !watcher->search->threadStarted) {
+        return;
+    }
+    // Relative paths still to read, the root's own scripts were listed by the scan
+    char **stack = NULL;
+    int stackCount = 0;
+    int stackCapacity = 0;
+    if (!pushTreePath(&stack, &stackCount, &stackCapacity, "")) {
+        return;
+    }
+
+    int queued = 0;
+    char dirPath[PATH_MAX];
+    char name[PATH_MAX];
+    char entryPath[PATH_MAX];
+    struct stat info;
+    while (stackCount > 0 && !atomic_load(&watcher->stopping)) {
+        char *folderPath = stack[--stackCount];
+        while (serveFolderRequest(watcher, false)) {
+        }
+
+        DIR *dir = joinWatchPath(dirPath, sizeof(dirPath), watcher->scriptDir, folderPath) ? opendir(dirPath) : NULL;
+        struct dirent *entry;
+        while (dir != NULL && !atomic_load(&watcher->stopping) && (entry = readdir(dir))) {
+            if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+                continue;
+            if (!joinWatchPath(name, sizeof(name), folderPath, entry->d_name) ||
+                !joinWatchPath(entryPath, sizeof(entryPath), watcher->scriptDir, name)) {
+                continue;
+            }
+            // Symlinked folders are not followed, so a link back up cannot loop the walk
+#ifdef PLATFORM_WINDOWS
+            if (stat(entryPath, &info) != 0) continue;
+#else
+            if (lstat(entryPath, &info) != 0 || (S_ISLNK(info.st_mode) && (stat(entryPath, &info) != 0 || S_ISDIR(info.st_mode)))) {
+                continue;
+            }
+#endif
+            if (S_ISDIR(info.st_mode)) {
+                pushTreePath(&stack, &stackCount, &stackCapacity, name);
+            } else if (S_ISREG(info.st_mode) && folderPath[0] != '\0') {
+                addSearchTreeScript(watcher->search, name);
+                queued++;
+                while (getSearchBacklog(watcher->search) > SEARCH_TREE_BACKLOG && !atomic_load(&watcher->stopping)) {
+                    if (!serveFolderRequest(watcher, false)) sleepBriefly();
+                }
+            }
+        }
+        if (dir != NULL) {
+            closedir(dir);
+        }
+        free(folderPath);
+    }
+    for (int i = 0; i < stackCount; i++) {
+        free(stack[i]);
+    }
+    free(stack);
+    printf("[SEARCH] Queued %d scripts from subfolders for name search\n", queued);
+}
+
+// Scan thread: bring the index (already filled from the cache, if any) in line with the directory, then SCAN_DONE
+void *scriptScanThread(void *arg) {
+    ScriptWatcher *watcher = (ScriptWatcher*)arg;
+    IndexCache *cache = watcher->cache;
+
+    // Read before the listing, so anything changing during the scan makes the next start rescan
+    struct stat info;
+    watcher->scanDirTime = stat(watcher->scriptDir, &info) == 0 ? getModifiedTime(&info) : 0;
+
+    if (cache != NULL && cache->header != NULL && watcher->scanDirTime != 0 &&
+        cache->header->dirModifiedTime == watcher->scanDirTime) {
+        validateCachedScripts(watcher, cache);
+    } else {
+        scanScriptDirectory(watcher, cache);
+    }
+    if (cache != NULL) {
+        closeIndexCache(cache);
+    }
+
+    postScriptChange(watcher, SCRIPT_CHANGE_SCAN_DONE, NULL);
+
+    // From then on, list folders as they are first expanded
+    feedScriptTree(watcher);
+    while (serveFolderRequest(watcher, true)) {
+    }
+    return NULL;
+}
+
+// Bring the index up to date from a background scan so a slow or network-mounted folder never delays
+// the window. cache (may be NULL) is what the index was filled from and is unmapped by the scan.
+// Call after startScriptWatcher so nothing created mid-scan is missed; falls back to a synchronous load
+void startScriptScan(ScriptWatcher *watcher, ScriptIndex *index, IndexCache *cache, double startTime) {
+    watcher->scanStartTime = startTime;
+    watcher->cache = cache;
+    watcher->search = index->search;
+    if (startThread(&watcher->scanThread, scriptScanThread, watcher)) {
+        watcher->scanning = true;
+        return;
+    }
+
+    if (cache != NULL) {
+        closeIndexCache(cache);
+    }
+    loadFiles(index, watcher->scriptDir);
+    printf("[STARTUP] Index complete after %.1f ms (%d scripts, loaded synchronously)\n",
+           (getMonotonicSeconds() - startTime) * 1000.0, index->count);
+}
+
+// List a folder the first time it is expanded, on the scan thread when there is one
+void listFolderOnExpand(ScriptWatcher *watcher, ScriptIndex *index, int folderId) {
+    ScriptFolder *folder = &index->folders[folderId];
+    if (folder->loaded) {
+        return;
+    }
+
+    lockMutex(&watcher->lock);
+    bool queued = watcher->scanning && watcher->folderRequestCount < WATCH_FOLDER_REQUESTS;
+    if (queued) {
+        snprintf(watcher->folderRequests[watcher->folderRequestCount++], sizeof(watcher->folderRequests[0]), "%s", folder->path);
+        broadcastCondVar(&watcher->scanWake);
+    }
+    unlockMutex(&watcher->lock);
+
+    if (queued) {
+        // Its entries are applied as they arrive from now on
+        folder->loaded = true;
+        return;
+    }
+#ifndef PLATFORM_WINDOWS
+    if (watcher->running) {
+        addScriptWatch(watcher, folder->path);
+    }
+#endif
+    loadScriptFolder(index, folderId);
+}
+
+// List the folders of shown search matches that only the tree walk found, one level per call, so their rows
+// resolve once the entries arrive. A match whose folder is listed but which is gone from disk is dropped
+void listSearchMatchFolders(ScriptWatcher *watcher, ScriptIndex *index, SearchIndex *search,
+                            const SearchResult *results, int first, int last) {
+    for (int r = first; r < last; r++) {
+        if (findIndexedFileByKey(index, results[r].fileKey) >= 0) continue;
+        uint32_t doc = findSearchDocByKey(search, results[r].fileKey);
+        if (doc == UINT32_MAX || search->docs[doc].treeName == NULL) continue;
+
+        const char *treeName = search->docs[doc].treeName;
+        bool pending = false;
+        for (const char *slash = strchr(treeName, '/'); slash != NULL && !pending; slash = strchr(slash + 1, '/')) {
+            // A folder missing here is still on its way from its parent's listing
+            int folderId = findScriptFolder(index, treeName, (size_t)(slash - treeName));
+            pending = folderId < 0 || !index->folders[folderId].loaded;
+            if (folderId >= 0 && !index->folders[folderId].loaded) {
+                listFolderOnExpand(watcher, index, folderId);
+            }
+        }
+
+        char filePath[PATH_MAX];
+        struct stat info;
+        if (!pending && joinWatchPath(filePath, sizeof(filePath), watcher->scriptDir, treeName) && stat(filePath, &info) != 0) {
+            removeSearchDoc(search, doc);
+        }
+    }
+}
+
+// Count the live runs and queued jobs of an entry that just appeared, e.g. a script re-saved while running
+void attachRunState(ScriptIndex *index, int fileIndex, RunManager *manager, WorkerPool *pool) {
+    FileItem *file = &index->files[fileIndex];
+    for (int i = 0; i < MAX_RUNS; i++) {
+        ScriptRun *run = &manager->runs[i];
+        if (!run->active || !fileHasPath(index, file, run->filePath)) continue;
+        ScriptRunInfo *info = takeRunInfo(index, file);
+        if (info == NULL) break;
+        run->fileIndex = fileIndex;
+        info->activeRuns++;
+        if (run->cancelRequested) info->stoppingRuns++;
+        info->pid = run->pid;
+    }
+
+    lockMutex(&pool->lock);
+    for (int i = 0; i < pool->jobCount; i++) {
+        if (fileHasPath(index, file, pool->jobs[(pool->jobHead + i) % pool->jobCapacity].filePath)) {
+            ScriptRunInfo *info = takeRunInfo(index, file);
+            if (info != NULL) info->queuedRuns++;
+        }
+    }
+    unlockMutex(&pool->lock);
+
+    if (file->runInfo >= 0) {
+        refreshRunState(&index->runInfo[file->runInfo]);
+    }
+}
+
+// Apply the watcher's and the startup scan's pending changes to the index.
+// Costs O(changes) lookups, the directory itself is only rescanned after lost events
+void applyScriptChanges(ScriptWatcher *watcher, ScriptIndex *index, RunManager *manager, WorkerPool *pool) {
+    lockMutex(&watcher->lock);
+    ScriptChange *changes = watcher->changes;
+    int changeCount = watcher->changeCount;
+    watcher->changes = NULL;
+    watcher->changeCount = 0;
+    watcher->changeCapacity = 0;
+    unlockMutex(&watcher->lock);
+
+    // Files removed by consecutive changes are dropped together, before any other kind of change applies
+    int *dropped = changeCount > 0 ? (int*)malloc(changeCount * sizeof(int)) : NULL;
+    int droppedCount = 0;
+    for (int c = 0; c < changeCount; c++) {
+        ScriptChange *change = &changes[c];
+
+        int fileIndex = change->type == SCRIPT_CHANGE_REMOVE ? findIndexedFile(index, change->fileName) : -1;
+        if (fileIndex >= 0) {
+            // Kept so an edit (saved as delete + create) comes back selected with its last result
+            FileItem *file = &index->files[fileIndex];
+            RemovedScript *removed = &watcher->removed[watcher->removedNext];
+            snprintf(removed->fileName, sizeof(removed->fileName), "%s", change->fileName);
+            removed->isSelected = file->isSelected;
+            removed->hasResult = peekRunInfo(index, file)->hasResult;
+            removed->lastResult = peekRunInfo(index, file)->lastResult;
+            watcher->removedNext = (watcher->removedNext + 1) % WATCH_REMOVED_SLOTS;
+            if (dropped != NULL) {
+                // Unlisted by name right away, so a repeated remove finds nothing
+                removeIndexLookup(index, fileIndex);
+                dropped[droppedCount++] = fileIndex;
+            } else {
+                removeFileItem(index, fileIndex);
+            }
+            continue;
+        }
+        if (droppedCount > 0) {
+            removeFileItems(index, dropped, droppedCount);
+            droppedCount = 0;
+        }
+
+        if (change->type == SCRIPT_CHANGE_RESCAN) {
+            printf("[WATCH] Events were dropped, rescanning %s\n", watcher->scriptDir);
+            reloadFiles(index, manager, pool);
+            continue;
+        }
+
+        if (change->type == SCRIPT_CHANGE_SCAN_DONE) {
+            printf("[STARTUP] Index complete after %.1f ms (%d scripts%s)\n",
+                   (getMonotonicSeconds() - watcher->scanStartTime) * 1000.0, index->count,
+                   watcher->scanChangedIndex ? "" : ", cache was current");
+            if (watcher->scanChangedIndex && watcher->scanDirTime != 0 && watcher->cache != NULL &&
+                watcher->cache->path[0] != '\0' && !atomic_load(&watcher->stopping)) {
+                saveIndexCache(watcher->cache->path, index, watcher->scanDirTime);
+            }
+            continue;
+        }
+
+        // Not a listed file, maybe a folder
+        if (change->type == SCRIPT_CHANGE_REMOVE) {
+            int folderId = findScriptFolder(index, change->fileName, strlen(change->fileName));
+            if (folderId > 0) removeScriptFolder(index, folderId);
+            continue;
+        }
+
+        fileIndex = findIndexedFile(index, change->fileName);
+
+        if (change->metadata.isDirectory) {
+            // Also replaces a file of the same name, seen when the cache was older than the directory
+            if (fileIndex >= 0) removeFileItem(index, fileIndex);
+            addScriptFolder(index, change->fileName);
+            continue;
+        }
+
+        if (fileIndex >= 0) {
+            // Rewritten in place: only the header metadata can have changed
+            FileItem *file = &index->files[fileIndex];
+            if (strcmp(file->dependsOn, change->metadata.dependsOn) != 0) {
+                setFileDependencies(index, file, change->metadata.dependsOn);
+            }
+            file->timeoutSeconds = change->metadata.timeoutSeconds;
+            bool contentChanged = file->modifiedTime != change->metadata.modifiedTime ||
+                                  file->fileSize != change->metadata.fileSize;
+            file->modifiedTime = change->metadata.modifiedTime;
+            file->fileSize = change->metadata.fileSize;
+            if (contentChanged) {
+                unsettleFileOrder(index, fileIndex, SORT_BY_MODIFIED);
+            }
+            if (contentChanged && index->search != NULL) {
+                removeSearchDoc(index->search, file->searchDoc);
+                file->searchDoc = addSearchDoc(index->search, file);
+            }
+            continue;
+        }
+
+        // Inside a folder that has not been expanded yet, it is listed along with the folder
+        int folderId = findParentFolder(index, change->fileName);
+        if (folderId < 0) continue;
+
+        FileItem *file = addFileItem(index, folderId, change->fileName, &change->metadata);
+        if (file == NULL) {
+            printf("[WATCH] Out of memory, ignoring %s\n", change->fileName);
+            continue;
+        }
+        for (int i = 0; i < WATCH_REMOVED_SLOTS; i++) {
+            RemovedScript *removed = &watcher->removed[i];
+            if (removed->fileName[0] != '\0' && strcmp(removed->fileName, change->fileName) == 0) {
+                file->isSelected = removed->isSelected;
+                ScriptRunInfo *info = removed->hasResult ? takeRunInfo(index, file) : NULL;
+                if (info != NULL) {
+                    info->hasResult = true;
+                    info->lastResult = removed->lastResult;
+                }
+                removed->fileName[0] = '\0';
+                break;
+            }
+        }
+        attachRunState(index, index->count - 1, manager, pool);
+    }
+    if (droppedCount > 0) {
+        removeFileItems(index, dropped, droppedCount);
+    }
+
+    free(dropped);
+    free(changes);
+}
+
+// Stop the watcher and scan threads and drop anything not yet applied
+void stopScriptWatcher(ScriptWatcher *watcher) {
+    atomic_store(&watcher->stopping, true);
+    lockMutex(&watcher->lock);
+    broadcastCondVar(&watcher->scanWake);
+    unlockMutex(&watcher->lock);
+    if (watcher->scanning) {
+        joinThread(watcher->scanThread);
+        watcher->scanning = false;
+    }
+    if (!watcher->running) {
+        free(watcher->changes);
+        watcher->changes = NULL;
+        watcher->changeCount = 0;
+        return;
+    }
+
+#ifdef PLATFORM_WINDOWS
+    // The cancel only lands while the thread is inside the read, so keep trying until it leaves
+    while (WaitForSingleObject(watcher->thread, 10) == WAIT_TIMEOUT) {
+        CancelSynchronousIo(watcher->thread);
+    }
+    joinThread(watcher->thread);
+    CloseHandle(watcher->dirHandle);
+#else
+    char byte = 0;
+    if (write(watcher->stopPipe[1], &byte, 1) != 1) {
+        printf("[WATCH] Could not signal the watcher thread\n");
+    }
+    joinThread(watcher->thread);
+    close(watcher->inotifyFd);
+    close(watcher->stopPipe[0]);
+    close(watcher->stopPipe[1]);
+    free(watcher->watchedFolders);
+    watcher->watchedFolders = NULL;
+    watcher->watchedCount = 0;
+#endif
+
+    free(watcher->changes);
+    watcher->changes = NULL;
+    watcher->changeCount = 0;
+    watcher->running = false;
+}
+
+// Number of characters in the buffer
+int getTextLength(const TextBuffer *buffer) {
+    return buffer->capacity - (buffer->gapEnd - buffer->gapStart);
+}
+
+// Character at a position below the length
+char getTextChar(const TextBuffer *buffer, int pos) {
+    return pos < buffer->gapStart ? buffer->data[pos] : buffer->data[pos + buffer->gapEnd - buffer->gapStart];
+}
+
+// Move the gap to a text position, costs the distance moved
+void moveTextGap(TextBuffer *buffer, int pos) {
+    // A buffer that never allocated is empty, there is nothing to move and no data to point into
+    if (buffer->capacity == 0) return;
+
+    // Line starts move between the halves together with their newlines
+    int length = getTextLength(buffer);
+    while (buffer->lineGapStart > 0 && buffer->lineStarts[buffer->lineGapStart - 1] > pos) {
+        buffer->lineStarts[--buffer->lineGapEnd] = length - buffer->lineStarts[--buffer->lineGapStart];
+    }
+    while (buffer->lineGapEnd < buffer->lineCapacity && length - buffer->lineStarts[buffer->lineGapEnd] <= pos) {
+        buffer->lineStarts[buffer->lineGapStart++] = length - buffer->lineStarts[buffer->lineGapEnd++];
+    }
+
+    if (pos < buffer->gapStart) {
+        int count = buffer->gapStart - pos;
+        memmove(buffer->data + buffer->gapEnd - count, buffer->data + pos, count);
+        buffer->gapStart -= count;
+        buffer->gapEnd -= count;
+    } else if (pos > buffer->gapStart) {
+        int count = pos - buffer->gapStart;
+        memmove(buffer->data + buffer->gapStart, buffer->data + buffer->gapEnd, count);
+        buffer->gapStart += count;
+        buffer->gapEnd += count;
+    }
+}
+
+// Grow the gap to more than `needed` characters, doubling so typing stays amortized O(1)
+bool reserveTextGap(TextBuffer *buffer, int needed) {
+    if (buffer->gapEnd - buffer->gapStart > needed) return true;
+
+    int length = getTextLength(buffer);
+    if (needed > INT_MAX / 2 - length) return false;
+    int capacity = buffer->capacity < 256 ? 256 : buffer->capacity;
+    while (capacity - length <= needed) capacity *= 2;
+
+    // One byte past the capacity, so getTextRange's views can always be terminated in place
+    char *data = realloc(buffer->data, capacity + 1);
+    if (data == NULL) return false;
+    int tail = buffer->capacity - buffer->gapEnd;
+    memmove(data + capacity - tail, data + buffer->gapEnd, tail);
+    buffer->data = data;
+    buffer->gapEnd = capacity - tail;
+    buffer->capacity = capacity;
+    return true;
+}
+
+// Grow the line start gap to at least `needed` entries
+bool reserveLineGap(TextBuffer *buffer, int needed) {
+    if (buffer->lineGapEnd - buffer->lineGapStart >= needed) return true;
+
+    int lines = buffer->lineCapacity - (buffer->lineGapEnd - buffer->lineGapStart);
+    if (needed > INT_MAX / 8 - lines) return false;
+    int capacity = buffer->lineCapacity < 64 ? 64 : buffer->lineCapacity;
+    while (capacity - lines < needed) capacity *= 2;
+
+    int *lineStarts = realloc(buffer->lineStarts, capacity * sizeof(int));
+    if (lineStarts == NULL) return false;
+    int tail = buffer->lineCapacity - buffer->lineGapEnd;
+    memmove(lineStarts + capacity - tail, lineStarts + buffer->lineGapEnd, tail * sizeof(int));
+    buffer->lineStarts = lineStarts;
+    buffer->lineGapEnd = capacity - tail;
+    buffer->lineCapacity = capacity;
+    return true;
+}
+
+// Insert characters at a position. Returns false when out of memory
+bool insertText(TextBuffer *buffer, int pos, const char *text, int length) {
+    int newlines = 0;
+    for (const char *c = text; (c = memchr(c, '\n', text + length - c)) != NULL; c++) newlines++;
+    if (!reserveTextGap(buffer, length) || !reserveLineGap(buffer, newlines)) return false;
+
+    moveTextGap(buffer, pos);
+    buffer->revision++;
+    memcpy(buffer->data + buffer->gapStart, text, length);
+    for (const char *c = text; newlines > 0; c++) {
+        c = memchr(c, '\n', text + length - c);
+        buffer->lineStarts[buffer->lineGapStart++] = pos + (int)(c - text) + 1;
+        newlines--;
+    }
+    buffer->gapStart += length;
+    return true;
+}
+
+// Remove `length` characters starting at a position
+void deleteText(TextBuffer *buffer, int pos, int length) {
+    moveTextGap(buffer, pos);
+    // The removed newlines are the first line starts past the gap
+    int textLength = getTextLength(buffer);
+    while (buffer->lineGapEnd < buffer->lineCapacity &&
+           textLength - buffer->lineStarts[buffer->lineGapEnd] <= pos + length) {
+        buffer->lineGapEnd++;
+    }
+    buffer->gapEnd += length;
+    buffer->revision++;
+}
+
+// Replace the whole text
+bool setTextContent(TextBuffer *buffer, const char *text, int length) {
+    buffer->gapStart = 0;
+    buffer->gapEnd = buffer->capacity;
+    buffer->lineGapStart = 0;
+    buffer->lineGapEnd = buffer->lineCapacity;
+    buffer->revision++;
+    return insertText(buffer, 0, text, length);
+}
+
+// Number of lines, one more than the number of newlines
+int getTextLineCount(const TextBuffer *buffer) {
+    return 1 + buffer->lineCapacity - (buffer->lineGapEnd - buffer->lineGapStart);
+}
+
+// Offset of the first character of a line below the line count
+int getTextLineStart(const TextBuffer *buffer, int line) {
+    if (line == 0) return 0;
+    int entry = line - 1;
+    if (entry < buffer->lineGapStart) return buffer->lineStarts[entry];
+    return getTextLength(buffer) - buffer->lineStarts[entry + buffer->lineGapEnd - buffer->lineGapStart];
+}
+
+// Offset of the newline ending a line, or the text length for the last line
+int getTextLineEnd(const TextBuffer *buffer, int line) {
+    if (line + 1 >= getTextLineCount(buffer)) return getTextLength(buffer);
+    return getTextLineStart(buffer, line + 1) - 1;
+}
+
+// Line holding a position, a binary search over the line starts
+int getTextLineAt(const TextBuffer *buffer, int pos) {
+    int low = 0;
+    int high = getTextLineCount(buffer) - 1;
+    while (low < high) {
+        int mid = low + (high - low + 1) / 2;
+        if (getTextLineStart(buffer, mid) <= pos) {
+            low = mid;
+        } else {
+            high = mid - 1;
+        }
+    }
+    return low;
+}
+
+// The text as one terminated string, closing the gap behind it first
+const char *getTextString(TextBuffer *buffer) {
+    if (buffer->data == NULL) return "";
+    int length = getTextLength(buffer);
+    moveTextGap(buffer, length);
+    buffer->data[length] = '\0';
+    return buffer->data;
+}
+
+// Contiguous, unterminated view of [start, end). The gap only moves when it splits the range
+const char *getTextRange(TextBuffer *buffer, int start, int end) {
+    if (buffer->data == NULL) return "";
+    if (end <= buffer->gapStart) return buffer->data + start;
+    if (start < buffer->gapStart) moveTextGap(buffer, start);
+    return buffer->data + start + (buffer->gapEnd - buffer->gapStart);
+}
+
+// Copy [start, end) into a new terminated string without moving the gap. The caller frees it
+char *copyTextRange(const TextBuffer *buffer, int start, int end) {
+    char *copy = malloc(end - start + 1);
+    if (copy == NULL) return NULL;
+    int before = buffer->gapStart > start ? (buffer->gapStart < end ? buffer->gapStart : end) - start : 0;
+    if (before > 0) memcpy(copy, buffer->data + start, before);
+    if (end - start > before) {
+        memcpy(copy + before, buffer->data + start + before + (buffer->gapEnd - buffer->gapStart), end - start - before);
+    }
+    copy[end - start] = '\0';
+    return copy;
+}
+
+// Release the buffer, it is empty and usable again afterwards
+void freeTextBuffer(TextBuffer *buffer) {
+    free(buffer->data);
+    free(buffer->lineStarts);
+    unsigned int revision = buffer->revision;
+    *buffer = (TextBuffer){0};
+    buffer->revision = revision + 1;
+}
+
+// Drop the whole edit log
+void clearUndoHistory(Modal *modal) {
+    for (int i = 0; i < modal->editTotal; i++) free(modal->edits[i].text);
+    free(modal->edits);
+    modal->edits = NULL;
+    modal->editCount = 0;
+    modal->editTotal = 0;
+    modal->editCapacity = 0;
+    modal->coalesceEdits = false;
+}
+
+// Reverse a run of bytes in place
+void reverseBytes(char *data, int length) {
+    for (int i = 0, j = length - 1; i < j; i++, j--) {
+        char c = data[i];
+        data[i] = data[j];
+        data[j] = c;
+    }
+}
+
+// Extend a logged edit by keystrokes typed next to it, at its end or (for backspace) its start.
+// Backspaced text is appended back to front so every key is O(1), applyEditOp puts it in order
+bool growEditOp(EditOp *op, const char *text, int length, bool atStart) {
+    if (!atStart && op->reversed) {
+        return false;
+    }
+    if (atStart && !op->reversed) {
+        reverseBytes(op->text, op->length);
+        op->reversed = true;
+    }
+    if (op->length + length > op->capacity) {
+        int capacity = op->capacity * 2 > op->length + length ? op->capacity * 2 : op->length + length;
+        char *grown = realloc(op->text, capacity);
+        if (grown == NULL) return false;
+        op->text = grown;
+        op->capacity = capacity;
+    }
+    if (atStart) {
+        for (int i = 0; i < length; i++) {
+            op->text[op->length + i] = text[length - 1 - i];
+        }
+        op->pos -= length;
+    } else {
+        memcpy(op->text + op->length, text, length);
+    }
+    op->length += length;
+    return true;
+}
+
+// Log an edit before it is applied. Typing right after the previous keystroke joins its edit,
+// `joinStep` makes a new edit part of the step before it. Anything that was undone is dropped
+void recordEdit(Modal *modal, bool isInsert, int pos, const char *text, int length, bool isTyping, bool joinStep) {
+    for (int i = modal->editCount; i < modal->editTotal; i++) free(modal->edits[i].text);
+    modal->editTotal = modal->editCount;
+
+    if (modal->coalesceEdits && isTyping && modal->editCount > 0) {
+        EditOp *last = &modal->edits[modal->editCount - 1];
+        if (last->isTyping && last->isInsert == isInsert) {
+            if (isInsert && last->pos + last->length == pos) {
+                if (growEditOp(last, text, length, false)) return;
+            } else if (!isInsert && pos + length == last->pos) {
+                if (growEditOp(last, text, length, true)) return;
+            } else if (!isInsert && pos == last->pos) {
+                if (growEditOp(last, text, length, false)) return;
+            }
+        }
+    }
+
+    if (modal->editCount >= modal->editCapacity) {
+        int capacity = modal->editCapacity == 0 ? 64 : modal->editCapacity * 2;
+        EditOp *grown = realloc(modal->edits, capacity * sizeof(EditOp));
+        if (grown == NULL) {
+            // Without a log entry the earlier steps no longer line up with the text
+            printf("[EDITOR] Out of memory, clearing undo history\n");
+            clearUndoHistory(modal);
+            return;
+        }
+        modal->edits = grown;
+        modal->editCapacity = capacity;
+    }
+
+    EditOp *op = &modal->edits[modal->editCount];
+    op->text = malloc(length > 0 ? length : 1);
+    if (op->text == NULL) {
+        printf("[EDITOR] Out of memory, clearing undo history\n");
+        clearUndoHistory(modal);
+        return;
+    }
+    memcpy(op->text, text, length);
+    op->length = length;
+    op->capacity = length > 0 ? length : 1;
+    op->pos = pos;
+    op->isInsert = isInsert;
+    op->isTyping = isTyping;
+    op->startsStep = !joinStep || modal->editCount == 0;
+    op->reversed = false;
+    modal->editCount++;
+    modal->editTotal = modal->editCount;
+    modal->coalesceEdits = true;
+}
+
+// Apply a logged edit forwards or backwards, returning where the cursor lands
+int applyEditOp(Modal *modal, EditOp *op, bool reverse) {
+    // Undo and redo end coalescing, so a backspace run can be put in order for good
+    if (op->reversed) {
+        reverseBytes(op->text, op->length);
+        op->reversed = false;
+    }
+    if (op->isInsert != reverse) {
+        // The buffer only grows, so it already has room for every earlier state
+        if (!insertText(&modal->command, op->pos, op->text, op->length)) {
+            printf("[EDITOR] Out of memory replaying an edit\n");
+        }
+        return op->pos + op->length;
+    }
+    deleteText(&modal->command, op->pos, op->length);
+    return op->pos;
+}
+
+// Perform undo, reverting every edit of the last step
+void performUndo(Modal *modal) {
+    if (modal->editCount == 0) return;
+
+    int cursor = modal->cursorPos;
+    EditOp *op;
+    do {
+        op = &modal->edits[--modal->editCount];
+        cursor = applyEditOp(modal, op, true);
+    } while (!op->startsStep && modal->editCount > 0);
+
+    modal->commandLength = getTextLength(&modal->command);
+    modal->cursorPos = cursor;
+    modal->hasSelection = false;
+    modal->coalesceEdits = false;
+}
+
+// Perform redo, replaying the next undone step
+void performRedo(Modal *modal) {
+    if (modal->editCount == modal->editTotal) return;
+
+    int cursor = modal->cursorPos;
+    do {
+        cursor = applyEditOp(modal, &modal->edits[modal->editCount++], false);
+    } while (modal->editCount < modal->editTotal && !modal->edits[modal->editCount].startsStep);
+
+    modal->commandLength = getTextLength(&modal->command);
+    modal->cursorPos = cursor;
+    modal->hasSelection = false;
+    modal->coalesceEdits = false;
+}
+
+// Delete the selection if there is one, logging it as its own step
+void deleteSelection(Modal *modal) {
+    if (!modal->hasSelection) return;
+    int selStart = modal->selectionStart < modal->selectionEnd ? modal->selectionStart : modal->selectionEnd;
+    int selEnd = modal->selectionStart > modal->selectionEnd ? modal->selectionStart : modal->selectionEnd;
+
+    if (selEnd > selStart) {
+        recordEdit(modal, false, selStart, getTextRange(&modal->command, selStart, selEnd), selEnd - selStart, false, false);
+    }
+    deleteText(&modal->command, selStart, selEnd - selStart);
+    modal->commandLength -= (selEnd - selStart);
+    modal->cursorPos = selStart;
+    modal->hasSelection = false;
+}
+
+// Insert text at cursor position. A typed character replacing a selection undoes together with it
+void insertTextAtCursor(Modal *modal, const char *text) {
+    int textLen = strlen(text);
+    if (textLen == 0) return;
+    bool isTyping = textLen == 1 && text[0] != '\n';
+    bool replacesSelection = modal->hasSelection && modal->selectionStart != modal->selectionEnd;
+
+    deleteSelection(modal);
+
+    if (!reserveTextGap(&modal->command, textLen)) {
+        printf("[EDITOR] Out of memory, dropping %d inserted characters\n", textLen);
+        return;
+    }
+    recordEdit(modal, true, modal->cursorPos, text, textLen, isTyping, replacesSelection);
+    insertText(&modal->command, modal->cursorPos, text, textLen);
+    modal->commandLength += textLen;
+    modal->cursorPos += textLen;
+}
+
+// Delete character at cursor, runs of Backspace or Delete undo as one step
+void deleteCharAtCursor(Modal *modal, bool isBackspace) {
+    if (modal->hasSelection) {
+        deleteSelection(modal);
+    } else if (isBackspace && modal->cursorPos > 0) {
+        recordEdit(modal, false, modal->cursorPos - 1, getTextRange(&modal->command, modal->cursorPos - 1, modal->cursorPos), 1, true, false);
+        deleteText(&modal->command, modal->cursorPos - 1, 1);
+        modal->cursorPos--;
+        modal->commandLength--;
+    } else if (!isBackspace && modal->cursorPos < modal->commandLength) {
+        recordEdit(modal, false, modal->cursorPos, getTextRange(&modal->command, modal->cursorPos, modal->cursorPos + 1), 1, true, false);
+        deleteText(&modal->command, modal->cursorPos, 1);
+        modal->commandLength--;
+    }
+}
+
+// Get cursor position (line, column) from cursor index
+void getCursorLineCol(const TextBuffer *text, int cursorPos, int *line, int *col) {
+    *line = getTextLineAt(text, cursorPos);
+    *col = cursorPos - getTextLineStart(text, *line);
+}
+
+// Get cursor index from line and column, past the last line is the end of the text
+int getCursorPosFromLineCol(const TextBuffer *text, int targetLine, int targetCol) {
+    if (targetLine >= getTextLineCount(text)) {
+        return getTextLength(text);
+    }
+
+    int lineStart = getTextLineStart(text, targetLine);
+    int lineEnd = getTextLineEnd(text, targetLine);
+    return targetCol < lineEnd - lineStart ? lineStart + targetCol : lineEnd;
+}
+
+// Advance of one codepoint at the layout size, spacing not included
+float getGlyphAdvance(Font font, int codepoint, float scale) {
+    int index = GetGlyphIndex(font, codepoint);
+    if (font.glyphs[index].advanceX != 0) return (float)font.glyphs[index].advanceX * scale;
+    return (font.recs[index].width + (float)font.glyphs[index].offsetX) * scale;
+}
+
+// Refill the advance table when the font or size changed, dropping every measured line
+void updateTextLayoutFont(TextLayout *layout, Font font, float size, float spacing) {
+    // Like DrawTextEx, an unloaded font means the default one
+    if (font.texture.id == 0) font = GetFontDefault();
+    if (layout->font.texture.id == font.texture.id && layout->font.glyphs == font.glyphs &&
+        layout->font.baseSize == font.baseSize && layout->size == size && layout->spacing == spacing) {
+        return;
+    }
+
+    layout->font = font;
+    layout->size = size;
+    layout->spacing = spacing;
+    float scale = font.baseSize > 0 ? size / (float)font.baseSize : 1.0f;
+    for (int c = 0; c < 128; c++) {
+        layout->advances[c] = font.glyphs != NULL ? getGlyphAdvance(font, c, scale) : 0;
+    }
+    for (int i = 0; i < EDITOR_LAYOUT_SLOTS; i++) {
+        free(layout->lines[i].widths);
+        layout->lines[i] = (LineLayout){0};
+    }
+}
+
+// Prefix widths of a line, measured once per text revision. Matches MeasureTextEx, which
+// sums the scaled advances and adds the spacing between codepoints
+LineLayout *getLineLayout(TextLayout *layout, TextBuffer *text, int line) {
+    LineLayout *slot = &layout->lines[line % EDITOR_LAYOUT_SLOTS];
+    if (slot->widths != NULL && slot->line == line && slot->revision == text->revision) return slot;
+
+    int start = getTextLineStart(text, line);
+    int length = getTextLineEnd(text, line) - start;
+    if (length + 1 > slot->capacity) {
+        float *widths = realloc(slot->widths, (length + 1) * sizeof(float));
+        if (widths == NULL) return NULL;
+        slot->widths = widths;
+        slot->capacity = length + 1;
+    }
+
+    const char *chars = getTextRange(text, start, start + length);
+    float scale = layout->font.baseSize > 0 ? layout->size / (float)layout->font.baseSize : 1.0f;
+    float advances = 0;
+    int glyphs = 0;
+    slot->widths[0] = 0;
+    for (int i = 0; i < length;) {
+        unsigned char c = (unsigned char)chars[i];
+        int size = 1;
+        if (c < 128) {
+            advances += layout->advances[c];
+        } else {
+            // Decoded from a padded copy so a sequence cut at the line end reads nothing past it
+            char sequence[5] = {0};
+            memcpy(sequence, chars + i, length - i < 4 ? length - i : 4);
+            int codepoint = GetCodepointNext(sequence, &size);
+            if (size < 1) size = 1;
+            if (size > length - i) size = length - i;
+            advances += getGlyphAdvance(layout->font, codepoint, scale);
+        }
+        glyphs++;
+        // Offsets inside a codepoint keep the width before it
+        for (int k = 1; k < size; k++) slot->widths[i + k] = slot->widths[i];
+        i += size;
+        slot->widths[i] = advances + (float)(glyphs - 1) * layout->spacing;
+    }
+
+    slot->line = line;
+    slot->start = start;
+    slot->length = length;
+    slot->revision = text->revision;
+    return slot;
+}
+
+// Offset in a measured line closest to x, a binary search over the prefix widths
+int findLayoutColumn(const LineLayout *slot, float x) {
+    int low = 0;
+    int high = slot->length;
+    while (low < high) {
+        int mid = low + (high - low) / 2;
+        if (slot->widths[mid] < x) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    int column = low;
+    if (low > 0 && x - slot->widths[low - 1] <= slot->widths[low] - x) column = low - 1;
+    // Land on the first byte of a codepoint
+    while (column > 0 && slot->widths[column - 1] == slot->widths[column]) column--;
+    return column;
+}
+
+// Release the measured lines
+void freeTextLayout(TextLayout *layout) {
+    for (int i = 0; i < EDITOR_LAYOUT_SLOTS; i++) {
+        free(layout->lines[i].widths);
+    }
+    *layout = (TextLayout){0};
+}
+
+// Get cursor position from mouse click. Repeated calls on the same line, as while dragging,
+// reuse its measured widths
+int getCursorPosFromMouse(TextLayout *layout, Font font, TextBuffer *text, int mouseX, int mouseY, Rectangle box, float scrollY) {
+    int lineHeight = fontSize + 4;
+    int startX = (int)box.x + 45;
+    int startY = (int)box.y;
+
+    // Account for scroll offset when calculating which line was clicked
+    int adjustedMouseY = mouseY + (int)scrollY;
+    int clickedLine = (adjustedMouseY - startY) / lineHeight;
+    if (clickedLine < 0) clickedLine = 0;
+    if (clickedLine >= getTextLineCount(text)) clickedLine = getTextLineCount(text) - 1;
+
+    updateTextLayoutFont(layout, font, (float)fontSize, 1.0f);
+    LineLayout *line = getLineLayout(layout, text, clickedLine);
+    if (line == NULL) return getTextLineStart(text, clickedLine);
+
+    return line->start + findLayoutColumn(line, (float)(mouseX - startX));
+}
+
+// Initialize modal
+void initModal(Modal *modal) {
+    modal->isOpen = false;
+    modal->filename[0] = '\0';
+    modal->command = (TextBuffer){0};
+    modal->edits = NULL;
+    modal->editCount = 0;
+    modal->editTotal = 0;
+    modal->editCapacity = 0;
+    modal->coalesceEdits = false;
+    modal->layout = (TextLayout){0};
+    modal->filenameLength = 0;
+    modal->commandLength = 0;
+    modal->filenameActive = true;
+    modal->commandActive = false;
+    modal->framesCounter = 0;
+    modal->isEditMode = false;
+    modal->editPath[0] = '\0';
+    modal->commandScrollOffsetY = 0;
+    modal->commandScrollOffsetX = 0;
+    modal->commandMaxScrollY = 0;
+    modal->commandMaxScrollX = 0;
+    modal->cursorPos = 0;
+    modal->selectionStart = 0;
+    modal->selectionEnd = 0;
+    modal->hasSelection = false;
+    modal->isManualScrolling = false;
+    modal->manualScrollTimer = 0;
+    modal->isDraggingScrollbar = false;
+    modal->scrollbarDragOffset = 0;
+}
+
+// Open modal for new script
+void openModal(Modal *modal) {
+    clearUndoHistory(modal);
+    modal->isOpen = true;
+    modal->filename[0] = '\0';
+    setTextContent(&modal->command, "", 0);
+    modal->filenameLength = 0;
+    modal->commandLength = 0;
+    modal->filenameActive = true;
+    modal->commandActive = false;
+    modal->framesCounter = 0;
+    modal->isEditMode = false;
+    modal->editPath[0] = '\0';
+    modal->commandScrollOffsetY = 0;
+    modal->commandScrollOffsetX = 0;
+    modal->commandMaxScrollY = 0;
+    modal->commandMaxScrollX = 0;
+    modal->cursorPos = 0;
+    modal->selectionStart = 0;
+    modal->selectionEnd = 0;
+    modal->hasSelection = false;
+    modal->isManualScrolling = false;
+    modal->manualScrollTimer = 0;
+    modal->isDraggingScrollbar = false;
+    modal->scrollbarDragOffset = 0;
+}
+
+// Open modal for editing
+void openEditModal(Modal *modal, const ScriptIndex *index, const FileItem *file) {
+    clearUndoHistory(modal);
+    modal->isOpen = true;
+    modal->isEditMode = true;
+    getFilePath(index, file, modal->editPath, sizeof(modal->editPath));
+
+    strncpy(modal->filename, file->displayName, MAX_FILENAME_CHARS);
+    modal->filename[MAX_FILENAME_CHARS] = '\0';
+    modal->filenameLength = strlen(modal->filename);
+
+    char *content = readFileContent(modal->editPath);
+    if (content != NULL) {
+        char *actualCommand = content;
+#ifdef PLATFORM_WINDOWS
+        if (strncmp(content, "@echo off", 9) == 0) {
+            actualCommand = strchr(content, '\n');
+            if (actualCommand) actualCommand++;
+        }
+#else
+        if (strncmp(content, "#!/bin/bash", 11) == 0) {
+            actualCommand = strchr(content, '\n');
+            if (actualCommand) actualCommand++;
+        }
+#endif
+
+        setTextContent(&modal->command, "", 0);
+        if (actualCommand) {
+            int len = strlen(actualCommand);
+            while (len > 0 && (actualCommand[len-1] == '\n' || actualCommand[len-1] == '\r')) {
+                len--;
+            }
+            if (!setTextContent(&modal->command, actualCommand, len)) {
+                printf("[EDITOR] Out of memory loading %s\n", modal->editPath);
+            }
+        }
+        free(content);
+    } else {
+        setTextContent(&modal->command, "", 0);
+    }
+    modal->commandLength = getTextLength(&modal->command);
+
+    modal->filenameActive = true;
+    modal->commandActive = false;
+    modal->framesCounter = 0;
+    modal->commandScrollOffsetY = 0;
+    modal->commandScrollOffsetX = 0;
+    modal->commandMaxScrollY = 0;
+    modal->commandMaxScrollX = 0;
+    modal->cursorPos = modal->commandLength;
+    modal->selectionStart = 0;
+    modal->selectionEnd = 0;
+    modal->hasSelection = false;
+    modal->isManualScrolling = false;
+    modal->manualScrollTimer = 0;
+    modal->isDraggingScrollbar = false;
+    modal->scrollbarDragOffset = 0;
+}
+
+// Close modal
+void closeModal(Modal *modal) {
+    modal->isOpen = false;
+}
+
+// Lay out the name and buttons of the list row drawn at (x, y)
+FileRowLayout getFileRowLayout(Rectangle container, float x, float y, const char *displayName) {
+    FileRowLayout row;
+    row.bounds = (Rectangle){ x + 30, y, (float)MeasureText(displayName, fontSize), (float)fontSize };
+    row.editBounds = (Rectangle){ container.x + container.width - 80, y - 2, 30, 24 };
+    row.deleteBounds = (Rectangle){ container.x + container.width - 40, y - 2, 30, 24 };
+    row.cancelBounds = (Rectangle){ container.x + container.width - 120, y - 2, 30, 24 };
+    return row;
+}
+
+// Draw a simple file icon
+void drawFileIcon(int x, int y, Color color) {
+    DrawRectangle(x, y + 3, 16, 20, color);
+    DrawRectangle(x, y, 12, 3, color);
+    DrawTriangle((Vector2){x + 12, y}, (Vector2){x + 16, y + 3}, (Vector2){x + 12, y + 3}, color);
+    DrawRectangle(x + 3, y + 8, 10, 1, RAYWHITE);
+    DrawRectangle(x + 3, y + 11, 10, 1, RAYWHITE);
+    DrawRectangle(x + 3, y + 14, 7, 1, RAYWHITE);
+}
+
+// Draw folder icon
+void drawFolderIcon(int x, int y) {
+    DrawRectangle(x, y + 4, 18, 12, (Color){255, 200, 100, 255});
+    DrawRectangle(x, y + 2, 8, 3, (Color){255, 200, 100, 255});
+    DrawRectangleLines(x, y + 4, 18, 12, (Color){200, 150, 80, 255});
+}
+
+// Helper function to draw text with custom font
+void DrawTextCustom(Font font, bool useFont, const char *text, int x, int y, int size, Color color) {
+    if (useFont) {
+        DrawTextEx(font, text, (Vector2){(float)x, (float)y}, (float)size, 1.0f, color);
+    } else {
+        DrawText(text, x, y, size, color);
+    }
+}
+
+// Draw [start, end) of the text straight from the buffer, terminating it in place for the call
+void drawTextSpan(Font font, TextBuffer *text, int start, int end, Vector2 position, float size, Color color) {
+    if (end <= start) return;
+    char *span = (char *)getTextRange(text, start, end);
+    char saved = span[end - start];
+    span[end - start] = '\0';
+    DrawTextEx(font, span, position, size, 1.0f, color);
+    span[end - start] = saved;
+}
+
+// Draw command text with line numbers and scrolling. Only the visible lines are touched, found
+// through the line index, and their glyphs are positioned from the cached line layouts
+void DrawCommandWithLineNumbers(Font font, bool useFont,
+                                TextBuffer *text,
+                                TextLayout *layout,
+                                Rectangle box,
+                                float scrollY,
+                                int _fontSize,
+                                int cursorPos,
+                                bool showCursor,
+                                int selStart,
+                                int selEnd,
+                                bool hasSelection) {
+
+    // Draw line number background OUTSIDE scissor mode
+    DrawRectangle((int)box.x, (int)box.y, 40, (int)box.height, (Color){50, 52, 64, 255});
+    DrawLine((int)box.x + 40, (int)box.y, (int)box.x + 40, (int)box.y + (int)box.height, (Color){98, 114, 164, 255});
+
+    // Start scissor mode for scrollable content
+    BeginScissorMode(
+        (int)box.x,
+        (int)box.y,
+        (int)box.width,
+        (int)box.height
+    );
+
+    int lineHeight = _fontSize + 4;
+    float textX = box.x + 45;
+    updateTextLayoutFont(layout, font, (float)_fontSize, 1.0f);
+
+    // Normalize selection
+    int actualSelStart = selStart;
+    int actualSelEnd = selEnd;
+    if (hasSelection && selStart > selEnd) {
+        actualSelStart = selEnd;
+        actualSelEnd = selStart;
+    }
+
+    // Calculate visible range, line numbers below are 0-based
+    int firstVisibleLine = (int)(scrollY / lineHeight);
+    if (firstVisibleLine < 0) firstVisibleLine = 0;
+    int lastVisibleLine = firstVisibleLine + (int)(box.height / lineHeight) + 2; // +2 for partial lines
+    if (lastVisibleLine > getTextLineCount(text)) lastVisibleLine = getTextLineCount(text);
+
+    for (int line = firstVisibleLine; line < lastVisibleLine; line++) {
+        float lineY = box.y + (float)line * lineHeight - scrollY;
+
+        // Draw line number
+        DrawText(TextFormat("%d", line + 1),
+                 (int)(box.x + 5),
+                 (int)lineY,
+                 _fontSize,
+                 (Color){139, 233, 253, 255});
+
+        LineLayout *lineLayout = getLineLayout(layout, text, line);
+        if (lineLayout == NULL) continue;
+        int lineStart = lineLayout->start;
+        int lineLen = lineLayout->length;
+
+        // Draw selection highlight for this line
+        if (hasSelection && lineLen > 0 && actualSelEnd > lineStart && actualSelStart < lineStart + lineLen) {
+            int selStartInLine = actualSelStart > lineStart ? actualSelStart - lineStart : 0;
+            int selEndInLine = actualSelEnd < lineStart + lineLen ? actualSelEnd - lineStart : lineLen;
+            float selX = lineLayout->widths[selStartInLine];
+
+            DrawRectangle((int)(textX + selX), (int)lineY,
+                          (int)(lineLayout->widths[selEndInLine] - selX), lineHeight, (Color){80, 120, 200, 180});
+        }
 
-        Vector2 size = MeasureTextEx(font, substr, (float)fontSize, 1.0f);
-        int dist = abs((int)size.x - relativeX);
+        // Draw line text up to the right edge of the box
+        if (lineLen > 0) {
+            int visibleLen = findLayoutColumn(lineLayout, box.width - 45) + 2;
+            if (visibleLen > lineLen) visibleLen = lineLen;
+            drawTextSpan(font, text, lineStart, lineStart + visibleLen,
+                         (Vector2){textX, lineY}, (float)_fontSize, (Color){248, 248, 242, 255});
+        }
 
-        if (dist < minDist) {
-            minDist = dist;
-            bestPos = lineStart + i;
+        // Draw cursor if it's on this line
+        if (showCursor && cursorPos >= lineStart && cursorPos <= lineStart + lineLen) {
+            DrawRectangle((int)(textX + lineLayout->widths[cursorPos - lineStart]), (int)lineY,
+                          2, lineHeight, (Color){248, 248, 242, 255});
         }
     }
 
-    return bestPos;
+    EndScissorMode();
 }
 
-// Initialize modal
-void initModal(Modal *modal) {
-    modal->isOpen = false;
-    modal->filename[0] = '\0';
-    modal->command[0] = '\0';
-    modal->filenameLength = 0;
-    modal->commandLength = 0;
-    modal->filenameActive = true;
-    modal->commandActive = false;
-    modal->framesCounter = 0;
-    modal->isEditMode = false;
-    modal->editIndex = -1;
-    modal->commandScrollOffsetY = 0;
-    modal->commandScrollOffsetX = 0;
-    modal->commandMaxScrollY = 0;
-    modal->commandMaxScrollX = 0;
-    modal->undoStackSize = 0;
-    modal->redoStackSize = 0;
-    modal->cursorPos = 0;
-    modal->selectionStart = 0;
-    modal->selectionEnd = 0;
-    modal->hasSelection = false;
-    modal->isManualScrolling = false;
-    modal->manualScrollTimer = 0;
-    modal->isDraggingScrollbar = false;
-    modal->scrollbarDragOffset = 0;
+// Scroll the console with the mouse wheel, reaching the bottom re-enables tail follow
+void updateConsoleScroll(ConsoleBuffer *console, Rectangle textArea, float wheel) {
+    float contentHeight = (float)console->lineCount * CONSOLE_LINE_HEIGHT;
+    float maxScroll = contentHeight - textArea.height;
+    if (maxScroll < 0) maxScroll = 0;
+
+    if (console->followTail) {
+        console->scrollOffset = maxScroll;
+    }
+
+    if (wheel != 0) {
+        console->scrollOffset -= wheel * CONSOLE_LINE_HEIGHT * 3;
+        if (console->scrollOffset < 0) console->scrollOffset = 0;
+        if (console->scrollOffset > maxScroll) console->scrollOffset = maxScroll;
+        console->followTail = (console->scrollOffset >= maxScroll);
+    }
 }
 
-// Open modal for new script
-void openModal(Modal *modal) {
-    modal->isOpen = true;
-    modal->filename[0] = '\0';
-    modal->command[0] = '\0';
-    modal->filenameLength = 0;
-    modal->commandLength = 0;
-    modal->filenameActive = true;
-    modal->commandActive = false;
-    modal->framesCounter = 0;
-    modal->isEditMode = false;
-    modal->editIndex = -1;
-    modal->commandScrollOffsetY = 0;
-    modal->commandScrollOffsetX = 0;
-    modal->commandMaxScrollY = 0;
-    modal->commandMaxScrollX = 0;
-    modal->undoStackSize = 0;
-    modal->redoStackSize = 0;
-    modal->cursorPos = 0;
-    modal->selectionStart = 0;
-    modal->selectionEnd = 0;
-    modal->hasSelection = false;
-    modal->isManualScrolling = false;
-    modal->manualScrollTimer = 0;
-    modal->isDraggingScrollbar = false;
-    modal->scrollbarDragOffset = 0;
+// Draw captured output, only the lines inside the visible window are touched
+void DrawConsolePanel(Font font, bool useFont, OutputCapture *capture, Rectangle panel, Rectangle closeButton, bool isRunning, Vector2 mousePoint) {
+    ConsoleBuffer *console = &capture->console;
+
+    DrawRectangleRec(panel, (Color){30, 32, 44, 255});
+    DrawRectangleLinesEx(panel, 2, (Color){68, 71, 90, 255});
+
+    DrawTextCustom(font, useFont, TextFormat("Output: %s %s", capture->title, isRunning ? "(running)" : "(finished)"),
+                   (int)panel.x + 10, (int)panel.y + 6, 16, (Color){189, 147, 249, 255});
+
+    Color closeColor = CheckCollisionPointRec(mousePoint, closeButton) ?
+                      (Color){255, 85, 85, 255} : (Color){255, 121, 198, 255};
+    DrawRectangleRec(closeButton, closeColor);
+    DrawTextCustom(font, useFont, "X", (int)closeButton.x + 6, (int)closeButton.y + 2, 16, WHITE);
+
+    Rectangle textArea = { panel.x + 8, panel.y + 28, panel.width - 16, panel.height - 34 };
+    updateConsoleScroll(console, textArea, 0);
+
+    BeginScissorMode((int)textArea.x, (int)textArea.y, (int)textArea.width, (int)textArea.height);
+
+    uint64_t firstVisible = (uint64_t)(console->scrollOffset / CONSOLE_LINE_HEIGHT);
+    uint64_t visibleLines = (uint64_t)(textArea.height / CONSOLE_LINE_HEIGHT) + 2;
+    float y = textArea.y - (console->scrollOffset - (float)firstVisible * CONSOLE_LINE_HEIGHT);
+
+    // A line never needs more characters than fit across the panel
+    char lineText[512];
+    int maxChars = (int)(textArea.width / 6) + 1;
+    if (maxChars > (int)sizeof(lineText)) maxChars = (int)sizeof(lineText);
+
+    for (uint64_t i = firstVisible; i < firstVisible + visibleLines && i < console->lineCount; i++) {
+        getConsoleLine(console, console->firstLine + i, lineText, maxChars);
+        if (lineText[0] != '\0') {
+            DrawTextCustom(font, useFont, lineText, (int)textArea.x, (int)y, CONSOLE_FONT_SIZE, (Color){248, 248, 242, 255});
+        }
+        y += CONSOLE_LINE_HEIGHT;
+    }
+
+    EndScissorMode();
 }
 
-// Open modal for editing
-void openEditModal(Modal *modal, FileItem *file, int index) {
-    modal->isOpen = true;
-    modal->isEditMode = true;
-    modal->editIndex = index;
+// How many CLI runs may go at once: all of them unless KORT_MAX_PARALLEL says fewer
+int getParallelLimit(int count) {
+    const char *maxParallelEnv = getenv("KORT_MAX_PARALLEL");
+    if (maxParallelEnv != NULL && atoi(maxParallelEnv) > 0 && atoi(maxParallelEnv) < count) {
+        return atoi(maxParallelEnv);
+    }
+    return count;
+}
+
+// Entry of the script at a relative path, listing the folders on its path first when they are not listed yet.
+// -1 when it is not a script or memory ran out
+int indexScriptPath(ScriptIndex *index, const char *fileName) {
+    int fileIndex = findIndexedFile(index, fileName);
+    if (fileIndex >= 0) {
+        return fileIndex;
+    }
+
+    char folderPath[PATH_MAX];
+    snprintf(folderPath, sizeof(folderPath), "%s", fileName);
+    int folderId = 0;
+    for (char *slash = strchr(folderPath, '/'); slash != NULL; slash = strchr(slash + 1, '/')) {
+        if (!index->folders[folderId].loaded) loadScriptFolder(index, folderId);
+        *slash = '\0';
+        folderId = addScriptFolder(index, folderPath);
+        *slash = '/';
+        if (folderId < 0) return -1;
+    }
+    if (!index->folders[folderId].loaded) loadScriptFolder(index, folderId);
+
+    fileIndex = findIndexedFile(index, fileName);
+    if (fileIndex < 0) {
+        // Created after its folder was listed
+        char filePath[PATH_MAX];
+        ScriptMetadata metadata;
+        snprintf(filePath, sizeof(filePath), "%s/%s", index->scriptDir, fileName);
+        if (parseScriptMetadata(filePath, &metadata) && !metadata.isDirectory &&
+            addFileItem(index, folderId, fileName, &metadata) != NULL) {
+            fileIndex = index->count - 1;
+        }
+    }
+    return fileIndex;
+}
+
+// Match a script by display name or by file name. A name with a folder in it ("client/deploy") goes
+// straight to that path, so scripts in folders that are not listed are found too
+int findScriptArgument(ScriptIndex *index, const char *name) {
+    if (strchr(name, '/') != NULL) {
+        char fileName[PATH_MAX];
+        return resolveScriptPath(index->scriptDir, name, fileName, sizeof(fileName)) == 1 ?
+               indexScriptPath(index, fileName) : -1;
+    }
+
+    FileItem *files = index->files;
+    int fileCount = index->count;
+    int fileIndex = findFileByName(files, fileCount, name);
+    if (fileIndex >= 0) {
+        return fileIndex;
+    }
+    for (int i = 0; i < fileCount; i++) {
+        if (strcmp(files[i].fileName, name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Resident launcher (POSIX only): keeps the index in memory and answers requests on a
+// Unix socket. Every message is a fixed header followed by `length` payload bytes
+#define DAEMON_MAGIC 0x444B524Bu            // "KRKD"
+
+typedef enum {
+    DAEMON_OP_LIST = 1,     // Reply payload: "displayName\tfileName\n" per script
+    DAEMON_OP_RUN,          // Payload: script name and the client's environment, reply status: pid, or exit code with DAEMON_RUN_WAIT
+    DAEMON_OP_STATUS,       // Reply payload: human readable summary
+} DaemonOp;
+
+#define DAEMON_RUN_WAIT 0x1     // Reply when the script exits, payload is its HistoryRecord
+#define DAEMON_RUN_INLINE 0x2   // Use the stdin/stdout/stderr passed along, otherwise open a terminal
+
+// A run request passes the client's cwd (an O_PATH fd), then for inline runs its stdin/stdout/stderr
+#define DAEMON_RUN_FDS 4
+
+typedef struct {
+    uint32_t magic;
+    uint8_t op;
+    uint8_t flags;
+    uint16_t length;
+} DaemonRequest;
+
+typedef struct {
+    uint32_t magic;
+    int32_t status;         // Negative on failure
+    uint32_t length;
+} DaemonResponse;
+
+#define DAEMON_ERROR_UNKNOWN_SCRIPT -1
+#define DAEMON_ERROR_SPAWN -2
+#define DAEMON_ERROR_BUSY -3
+#define DAEMON_ERROR_BAD_REQUEST -4
+
+// Socket path: $KORT_SOCKET, else one per user in the runtime directory. Without one it goes
+// into a private /tmp/kort-<uid> directory, then the result is true and the daemon creates it
+bool getDaemonSocketPath(char *buffer, size_t bufferSize) {
+    const char *override = getenv("KORT_SOCKET");
+    const char *runtimeDir = getenv("XDG_RUNTIME_DIR");
+    if (override != NULL && override[0] != '\0') {
+        snprintf(buffer, bufferSize, "%s", override);
+    } else if (runtimeDir != NULL && runtimeDir[0] != '\0') {
+        snprintf(buffer, bufferSize, "%s/kort.sock", runtimeDir);
+    } else {
+#ifdef PLATFORM_WINDOWS
+        snprintf(buffer, bufferSize, "kort.sock");
+#else
+        snprintf(buffer, bufferSize, "/tmp/kort-%u/kort.sock", (unsigned)getuid());
+        return true;
+#endif
+    }
+    return false;
+}
+
+#ifndef PLATFORM_WINDOWS
+// send() until everything is out, false when the peer went away (never raises SIGPIPE)
+bool sendFully(int fd, const void *data, size_t size) {
+    const char *cursor = (const char*)data;
+    while (size > 0) {
+        ssize_t written = send(fd, cursor, size, MSG_NOSIGNAL);
+        if (written < 0 && errno == EINTR) continue;
+        if (written <= 0) return false;
+        cursor += written;
+        size -= (size_t)written;
+    }
+    return true;
+}
+
+// read() exactly size bytes, false on EOF or error
+bool readFully(int fd, void *data, size_t size) {
+    char *cursor = (char*)data;
+    while (size > 0) {
+        ssize_t got = read(fd, cursor, size);
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) return false;
+        cursor += got;
+        size -= (size_t)got;
+    }
+    return true;
+}
+
+// True when the process on the other end of a Unix socket runs as our own user
+bool isPeerOwnUser(int fd) {
+    struct ucred peer;
+    socklen_t length = sizeof(peer);
+    return getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &peer, &length) == 0 && peer.uid == getuid();
+}
+
+// Connect to the daemon, -1 when none is listening. Requests pass our stdio along, so a
+// socket served by another user (who got to a shared path first) is never talked to
+int connectDaemon(void) {
+    struct sockaddr_un address = {0};
+    address.sun_family = AF_UNIX;
+    getDaemonSocketPath(address.sun_path, sizeof(address.sun_path));
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd == -1) return -1;
+    if (connect(fd, (struct sockaddr*)&address, sizeof(address)) == -1) {
+        close(fd);
+        return -1;
+    }
+    if (!isPeerOwnUser(fd)) {
+        fprintf(stderr, "kort: %s is served by another user, ignoring it\n", address.sun_path);
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Create (or reuse) the daemon's socket directory, which must be ours and closed to everyone else
+bool preparePrivateDirectory(const char *path) {
+    if (mkdir(path, 0700) != 0 && errno != EEXIST) {
+        fprintf(stderr, "kort: cannot create %s: %s\n", path, strerror(errno));
+        return false;
+    }
+    struct stat info;
+    if (lstat(path, &info) != 0 || !S_ISDIR(info.st_mode) || info.st_uid != getuid() || (info.st_mode & 077) != 0) {
+        fprintf(stderr, "kort: %s is not a private directory of this user\n", path);
+        return false;
+    }
+    return true;
+}
+
+// Send one request, passing fds along with it (SCM_RIGHTS) when fdCount > 0
+bool sendDaemonRequest(int fd, DaemonOp op, uint8_t flags, const char *payload, size_t length, const int *fds, int fdCount) {
+    if (length > DAEMON_MAX_PAYLOAD || fdCount > DAEMON_RUN_FDS) return false;
+
+    DaemonRequest request = { DAEMON_MAGIC, (uint8_t)op, flags, (uint16_t)length };
+    struct iovec parts[2] = {
+        { &request, sizeof(request) },
+        { (void*)payload, length },
+    };
+    struct msghdr message = {0};
+    message.msg_iov = parts;
+    message.msg_iovlen = length > 0 ? 2 : 1;
+
+    union {
+        struct cmsghdr header;
+        char space[CMSG_SPACE(DAEMON_RUN_FDS * sizeof(int))];
+    } control;
+    if (fdCount > 0) {
+        memset(&control, 0, sizeof(control));
+        message.msg_control = control.space;
+        message.msg_controllen = CMSG_SPACE(fdCount * sizeof(int));
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&message);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(fdCount * sizeof(int));
+        memcpy(CMSG_DATA(cmsg), fds, fdCount * sizeof(int));
+    }
+
+    ssize_t sent;
+    do {
+        sent = sendmsg(fd, &message, MSG_NOSIGNAL);
+    } while (sent == -1 && errno == EINTR);
+    if (sent < 0) return false;
+
+    // Ancillary data went with the first byte, the rest is plain bytes
+    size_t total = sizeof(request) + length;
+    if ((size_t)sent < total) {
+        char *whole = (char*)malloc(total);
+        if (whole == NULL) return false;
+        memcpy(whole, &request, sizeof(request));
+        memcpy(whole + sizeof(request), payload, length);
+        bool ok = sendFully(fd, whole + sent, total - (size_t)sent);
+        free(whole);
+        return ok;
+    }
+    return true;
+}
+
+// Payload of a run request: the script name, then every entry of our environment, each string
+// NUL terminated. Returns its length, 0 when it does not fit in a request
+size_t buildDaemonRunPayload(const char *name, char *buffer, size_t bufferSize) {
+    size_t used = 0;
+    for (int i = -1; i < 0 || environ[i] != NULL; i++) {
+        const char *entry = i < 0 ? name : environ[i];
+        size_t length = strlen(entry) + 1;
+        if (used + length > bufferSize || used + length > DAEMON_MAX_PAYLOAD) return 0;
+        memcpy(buffer + used, entry, length);
+        used += length;
+    }
+    return used;
+}
+
+// Read one response, the payload is malloc'd and NUL terminated (NULL when empty)
+bool readDaemonResponse(int fd, DaemonResponse *response, char **payload) {
+    *payload = NULL;
+    if (!readFully(fd, response, sizeof(*response)) || response->magic != DAEMON_MAGIC) {
+        return false;
+    }
+    if (response->length > 0) {
+        *payload = (char*)malloc(response->length + 1);
+        if (*payload == NULL || !readFully(fd, *payload, response->length)) {
+            free(*payload);
+            *payload = NULL;
+            return false;
+        }
+        (*payload)[response->length] = '\0';
+    }
+    return true;
+}
+
+typedef struct {
+    int fd;                     // -1 when the slot is free
+    unsigned char buffer[sizeof(DaemonRequest) + DAEMON_MAX_PAYLOAD];
+    size_t used;
+    int passedFds[DAEMON_RUN_FDS];  // cwd, then stdin/stdout/stderr for an inline run
+    int passedFdCount;
+    int waitingRun;             // Run this client waits on, -1 when none
+} DaemonClient;
+
+typedef struct {
+    bool active;
+    pid_t pid;
+    uint64_t historyKey;
+    char displayName[64];
+    double startTime;
+    bool inlineRun;             // Terminal runs stay out of the history, their status is the terminal's
+    int client;                 // Client waiting for the exit status, -1 when none
+} DaemonRun;
+
+// A fork of the daemon waiting on commandFd for one run to exec, so starting a run costs the
+// daemon a message instead of a spawn. Forked ahead of time, like the warm shells
+typedef struct {
+    pid_t pid;
+    int commandFd;
+} DaemonSpawner;
+
+typedef struct {
+    char scriptDir[512];
+    ScriptIndex index;
+    struct timespec scriptDirTime;  // Directory mtime the index was built from
+    RunHistory history;             // Append only, never loaded by the daemon
+    DaemonClient clients[DAEMON_MAX_CLIENTS];
+    DaemonRun runs[DAEMON_MAX_RUNS];
+    int runCount;
+    int listenFd;
+    int nullFd;                     // Stdio of terminal runs
+    DaemonSpawner spawners[MAX_WARM_SHELLS];
+    int spawnerCount;
+    int spawnerTarget;              // KORT_WARM_SHELLS, like the GUI's warm shells
+    uint64_t launched;
+    uint64_t warmLaunches;
+    double startTime;
+} Daemon;
+
+// Self-pipe written from signal handlers, polled by the daemon loop
+static int daemonSignalPipe[2] = { -1, -1 };
+static volatile sig_atomic_t daemonStopRequested = 0;
+
+void daemonSignalHandler(int signalNumber) {
+    int savedErrno = errno;
+    if (signalNumber != SIGCHLD) daemonStopRequested = 1;
+    char byte = 0;
+    if (write(daemonSignalPipe[1], &byte, 1) == -1) {
+        // Pipe full, a wakeup is already pending
+    }
+    errno = savedErrno;
+}
+
+// Rescan the scripts directory when it changed since the last scan
+void refreshDaemonIndex(Daemon *daemon) {
+    struct stat info;
+    if (stat(daemon->scriptDir, &info) == 0 &&
+        info.st_mtim.tv_sec == daemon->scriptDirTime.tv_sec && info.st_mtim.tv_nsec == daemon->scriptDirTime.tv_nsec) {
+        return;
+    }
+    loadFiles(&daemon->index, daemon->scriptDir);
+    daemon->scriptDirTime = info.st_mtim;
+    printf("[DAEMON] Indexed %d scripts\n", daemon->index.count);
+}
+
+// Largest message to a spawner: argument count, the command line, then the client's environment
+#define DAEMON_SPAWN_MESSAGE (DAEMON_MAX_PAYLOAD + 8192)
+
+// Spawner side: wait for one run and exec it. The message is the argument count, then the
+// arguments and the environment, every string NUL terminated, with the cwd and stdio fds attached
+void runDaemonSpawner(int commandFd) {
+    static char message[DAEMON_SPAWN_MESSAGE + 1];
+    static char *environment[DAEMON_SPAWN_MESSAGE / 2 + 1];
+    struct iovec part = { message, DAEMON_SPAWN_MESSAGE };
+    union {
+        struct cmsghdr header;
+        char space[CMSG_SPACE(DAEMON_RUN_FDS * sizeof(int))];
+    } control;
+    struct msghdr request = {0};
+    request.msg_iov = &part;
+    request.msg_iovlen = 1;
+    request.msg_control = control.space;
+    request.msg_controllen = sizeof(control.space);
+
+    ssize_t got;
+    do {
+        got = recvmsg(commandFd, &request, MSG_CMSG_CLOEXEC);
+    } while (got < 0 && errno == EINTR);
+    // EOF: the daemon is gone or shutting down
+    if (got <= 0) _exit(0);
+    // Woken ahead of the daemon on a busy CPU: let it answer its client before exec takes the CPU
+    sched_yield();
+
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&request);
+    if ((request.msg_flags & (MSG_TRUNC | MSG_CTRUNC)) || cmsg == NULL || cmsg->cmsg_type != SCM_RIGHTS ||
+        cmsg->cmsg_len != CMSG_LEN(DAEMON_RUN_FDS * sizeof(int))) {
+        _exit(127);
+    }
+    int fds[DAEMON_RUN_FDS];
+    memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+    message[got] = '\0';
+
+    char *argv[16];
+    int argc = (unsigned char)message[0];
+    int count = 0;
+    int environmentCount = 0;
+    for (char *entry = message + 1; entry < message + got; entry += strlen(entry) + 1) {
+        if (count < argc) {
+            if (count < 15) argv[count] = entry;
+            count++;
+        } else {
+            environment[environmentCount++] = entry;
+        }
+    }
+    if (count != argc || argc == 0 || argc >= 16) _exit(127);
+    argv[argc] = NULL;
+    environment[environmentCount] = NULL;
+
+    // The received fds are close-on-exec, dup2 clears that for the copies on 0-2
+    if (fchdir(fds[0]) != 0) _exit(127);
+    for (int i = 0; i < 3; i++) {
+        dup2(fds[1 + i], i);
+    }
+    execve(argv[0], argv, environment);
+    _exit(127);
+}
+
+// Fork a spawner in its own process group, holding none of the daemon's fds but its command socket
+bool forkDaemonSpawner(DaemonSpawner *spawner) {
+    int commandFds[2];
+    // A packet socket, so one send is one whole run however large the environment
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, commandFds) != 0) {
+        return false;
+    }
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        struct sigaction action = {0};
+        action.sa_handler = SIG_DFL;
+        sigaction(SIGCHLD, &action, NULL);
+        sigaction(SIGINT, &action, NULL);
+        sigaction(SIGTERM, &action, NULL);
+        setpgid(0, 0);
+        // An idle spawner must not keep a client's pipe or socket open
+        if (commandFds[1] > 3) close_range(3, (unsigned)commandFds[1] - 1, 0);
+        close_range((unsigned)commandFds[1] + 1, ~0U, 0);
+        runDaemonSpawner(commandFds[1]);
+    }
+    close(commandFds[1]);
+    if (pid < 0) {
+        close(commandFds[0]);
+        return false;
+    }
+    // Also set here, so a signal to the group works before the child got to it
+    setpgid(pid, pid);
+    spawner->pid = pid;
+    spawner->commandFd = commandFds[0];
+    return true;
+}
+
+// Fork one more spawner while the daemon has fewer than spawnerTarget
+void refillDaemonSpawners(Daemon *daemon) {
+    if (daemon->spawnerCount >= daemon->spawnerTarget) {
+        return;
+    }
+    if (!forkDaemonSpawner(&daemon->spawners[daemon->spawnerCount])) {
+        // Don't retry on every request, later runs just start cold
+        daemon->spawnerTarget = daemon->spawnerCount;
+        printf("[DAEMON] Could not fork a spawner: %s, runs start cold\n", strerror(errno));
+        return;
+    }
+    daemon->spawnerCount++;
+}
+
+// Hand a run to an idle spawner, returns its pid or 0 when none took it
+pid_t launchOnDaemonSpawner(Daemon *daemon, const char *message, size_t length, const int fds[DAEMON_RUN_FDS]) {
+    while (daemon->spawnerCount > 0) {
+        DaemonSpawner spawner = daemon->spawners[--daemon->spawnerCount];
+
+        struct iovec part = { (void*)message, length };
+        union {
+            struct cmsghdr header;
+            char space[CMSG_SPACE(DAEMON_RUN_FDS * sizeof(int))];
+        } control;
+        memset(&control, 0, sizeof(control));
+        struct msghdr request = {0};
+        request.msg_iov = &part;
+        request.msg_iovlen = 1;
+        request.msg_control = control.space;
+        request.msg_controllen = sizeof(control.space);
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&request);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(DAEMON_RUN_FDS * sizeof(int));
+        memcpy(CMSG_DATA(cmsg), fds, DAEMON_RUN_FDS * sizeof(int));
+
+        ssize_t sent;
+        do {
+            sent = sendmsg(spawner.commandFd, &request, MSG_NOSIGNAL);
+        } while (sent < 0 && errno == EINTR);
+        close(spawner.commandFd);
+        // Killed while idle: reapDaemonRuns collects it, the next one is tried
+        if (sent == (ssize_t)length) {
+            daemon->warmLaunches++;
+            return spawner.pid;
+        }
+    }
+    return 0;
+}
+
+// Start a run in the client's cwd and environment, on an idle spawner when there is one, else with
+// posix_spawn. fds are the cwd and the stdio for the run, the environment is NUL separated entries
+pid_t spawnDaemonRun(Daemon *daemon, char *const argv[], const char *environment, size_t environmentLength,
+                     const int fds[DAEMON_RUN_FDS]) {
+    static char message[DAEMON_SPAWN_MESSAGE];
+    size_t used = 1;
+    int argc = 0;
+    for (; argv[argc] != NULL && used < sizeof(message); argc++) {
+        size_t length = strlen(argv[argc]) + 1;
+        if (used + length > sizeof(message)) break;
+        memcpy(message + used, argv[argc], length);
+        used += length;
+    }
+    if (argv[argc] == NULL && used + environmentLength <= sizeof(message)) {
+        message[0] = (char)argc;
+        memcpy(message + used, environment, environmentLength);
+        pid_t pid = launchOnDaemonSpawner(daemon, message, used + environmentLength, fds);
+        if (pid != 0) return pid;
+    }
+
+    int environmentCount = 0;
+    for (size_t i = 0; i < environmentLength; i += strlen(environment + i) + 1) {
+        environmentCount++;
+    }
+    char **envp = (char**)malloc((environmentCount + 1) * sizeof(char*));
+    if (envp == NULL) return 0;
+    int count = 0;
+    for (size_t i = 0; i < environmentLength; i += strlen(environment + i) + 1) {
+        envp[count++] = (char*)environment + i;
+    }
+    envp[count] = NULL;
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addfchdir_np(&actions, fds[0]);
+    for (int i = 0; i < 3; i++) {
+        posix_spawn_file_actions_adddup2(&actions, fds[1 + i], i);
+    }
+
+    posix_spawnattr_t attributes;
+    posix_spawnattr_init(&attributes);
+    posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETPGROUP);
+    posix_spawnattr_setpgroup(&attributes, 0);
+
+    pid_t pid = 0;
+    int result = posix_spawn(&pid, argv[0], &actions, &attributes, argv, envp);
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attributes);
+    free(envp);
+    return result == 0 ? pid : 0;
+}
+
+// Send a response to a client, dropping the client when it has gone away
+void sendDaemonResponse(Daemon *daemon, int clientIndex, int32_t status, const void *payload, uint32_t length) {
+    DaemonClient *client = &daemon->clients[clientIndex];
+    DaemonResponse response = { DAEMON_MAGIC, status, length };
+    if (!sendFully(client->fd, &response, sizeof(response)) || (length > 0 && !sendFully(client->fd, payload, length))) {
+        // The poll loop notices the hangup and frees the slot
+        shutdown(client->fd, SHUT_RDWR);
+    }
+}
+
+// Drop fds a client passed for a run that did not use them
+void closePassedFds(DaemonClient *client) {
+    for (int i = 0; i < client->passedFdCount; i++) {
+        close(client->passedFds[i]);
+    }
+    client->passedFdCount = 0;
+}
+
+// Handle one complete request from a client, payload is NUL terminated past its length
+void handleDaemonRequest(Daemon *daemon, int clientIndex, const DaemonRequest *request, const char *payload) {
+    DaemonClient *client = &daemon->clients[clientIndex];
+
+    if (request->op == DAEMON_OP_LIST) {
+        refreshDaemonIndex(daemon);
+        const ScriptIndex *index = &daemon->index;
+        size_t capacity = 1;
+        for (int i = 0; i < index->count; i++) {
+            capacity += strlen(index->files[i].displayName) + strlen(index->files[i].fileName) + 2;
+        }
+        char *list = (char*)malloc(capacity);
+        size_t used = 0;
+        for (int i = 0; list != NULL && i < index->count; i++) {
+            used += (size_t)snprintf(list + used, capacity - used, "%s\t%s\n",
+                                     index->files[i].displayName, index->files[i].fileName);
+        }
+        sendDaemonResponse(daemon, clientIndex, list != NULL ? 0 : DAEMON_ERROR_BUSY, list, (uint32_t)used);
+        free(list);
+        return;
+    }
+
+    if (request->op == DAEMON_OP_STATUS) {
+        char status[4096];
+        size_t used = (size_t)snprintf(status, sizeof(status),
+                                       "pid %ld, up %.0fs, %d scripts, %d running, %llu launched (%llu warm)\n",
+                                       (long)getpid(), getMonotonicSeconds() - daemon->startTime, daemon->index.count,
+                                       daemon->runCount, (unsigned long long)daemon->launched,
+                                       (unsigned long long)daemon->warmLaunches);
+        double now = getMonotonicSeconds();
+        for (int i = 0; i < DAEMON_MAX_RUNS && used < sizeof(status) - 128; i++) {
+            if (!daemon->runs[i].active) continue;
+            used += (size_t)snprintf(status + used, sizeof(status) - used, "  %ld %s %.1fs\n", (long)daemon->runs[i].pid,
+                                     daemon->runs[i].displayName, now - daemon->runs[i].startTime);
+        }
+        sendDaemonResponse(daemon, clientIndex, 0, status, (uint32_t)used);
+        return;
+    }
+
+    if (request->op != DAEMON_OP_RUN) {
+        closePassedFds(client);
+        sendDaemonResponse(daemon, clientIndex, DAEMON_ERROR_BAD_REQUEST, NULL, 0);
+        return;
+    }
+
+    refreshDaemonIndex(daemon);
+    int fileIndex = findScriptArgument(&daemon->index, payload);
+    bool inlineRun = (request->flags & DAEMON_RUN_INLINE) != 0;
+    int slot = -1;
+    for (int i = 0; i < DAEMON_MAX_RUNS && slot < 0; i++) {
+        if (!daemon->runs[i].active) slot = i;
+    }
+
+    int32_t error = 0;
+    if (client->passedFdCount != (inlineRun ? DAEMON_RUN_FDS : 1)) error = DAEMON_ERROR_BAD_REQUEST;
+    else if (fileIndex < 0) error = DAEMON_ERROR_UNKNOWN_SCRIPT;
+    else if (slot < 0) error = DAEMON_ERROR_BUSY;
+    if (error != 0) {
+        closePassedFds(client);
+        sendDaemonResponse(daemon, clientIndex, error, NULL, 0);
+        return;
+    }
+
+    // The script runs in the client's cwd and environment, which follow its name in the payload
+    FileItem *file = &daemon->index.files[fileIndex];
+    char filePath[1024];
+    getFilePath(&daemon->index, file, filePath, sizeof(filePath));
+    char *argv[12];
+    fillRunArgv(argv, filePath, inlineRun ? RUN_MODE_INLINE : RUN_MODE_TERMINAL);
+    int fds[DAEMON_RUN_FDS] = { client->passedFds[0], daemon->nullFd, daemon->nullFd, daemon->nullFd };
+    if (inlineRun) {
+        memcpy(fds, client->passedFds, sizeof(fds));
+    }
+    size_t nameLength = strlen(payload) + 1;
+    size_t environmentLength = request->length > nameLength ? request->length - nameLength : 0;
+    pid_t pid = spawnDaemonRun(daemon, argv, payload + nameLength, environmentLength, fds);
+    closePassedFds(client);
+    if (pid == 0) {
+        sendDaemonResponse(daemon, clientIndex, DAEMON_ERROR_SPAWN, NULL, 0);
+        return;
+    }
+
+    DaemonRun *run = &daemon->runs[slot];
+    run->active = true;
+    run->pid = pid;
+    run->historyKey = file->historyKey;
+    // The name is copied out of the same Daemon object, which snprintf may not overlap
+    nameLength = strnlen(file->displayName, sizeof(run->displayName) - 1);
+    memcpy(run->displayName, file->displayName, nameLength);
+    run->displayName[nameLength] = '\0';
+    run->startTime = getMonotonicSeconds();
+    run->inlineRun = inlineRun;
+    run->client = -1;
+    daemon->runCount++;
+    daemon->launched++;
+
+    if (request->flags & DAEMON_RUN_WAIT) {
+        run->client = clientIndex;
+        client->waitingRun = slot;
+    } else {
+        sendDaemonResponse(daemon, clientIndex, (int32_t)pid, NULL, 0);
+    }
+}
+
+// Read what a client sent, keeping any fds that came along, and handle complete requests
+void readDaemonClient(Daemon *daemon, int clientIndex) {
+    DaemonClient *client = &daemon->clients[clientIndex];
+
+    struct iovec part = { client->buffer + client->used, sizeof(client->buffer) - client->used };
+    union {
+        struct cmsghdr header;
+        char space[CMSG_SPACE(DAEMON_RUN_FDS * sizeof(int))];
+    } control;
+    struct msghdr message = {0};
+    message.msg_iov = &part;
+    message.msg_iovlen = 1;
+    message.msg_control = control.space;
+    message.msg_controllen = sizeof(control.space);
+
+    ssize_t got = recvmsg(client->fd, &message, MSG_CMSG_CLOEXEC);
+    if (got < 0 && errno == EINTR) return;
+
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&message); cmsg != NULL; cmsg = CMSG_NXTHDR(&message, cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) continue;
+        int count = (int)((cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+        int *fds = (int*)CMSG_DATA(cmsg);
+        closePassedFds(client);
+        for (int i = 0; i < count; i++) {
+            if (i < DAEMON_RUN_FDS) client->passedFds[client->passedFdCount++] = fds[i];
+            else close(fds[i]);
+        }
+    }
+
+    if (got <= 0) {
+        // Hung up: a run it was waiting on goes down with it, like Ctrl-C on a local run
+        if (client->waitingRun >= 0) {
+            DaemonRun *run = &daemon->runs[client->waitingRun];
+            run->client = -1;
+            kill(-run->pid, SIGTERM);
+        }
+        closePassedFds(client);
+        close(client->fd);
+        client->fd = -1;
+        return;
+    }
+    client->used += (size_t)got;
+
+    while (client->used >= sizeof(DaemonRequest) && client->waitingRun < 0) {
+        DaemonRequest request;
+        memcpy(&request, client->buffer, sizeof(request));
+        if (request.magic != DAEMON_MAGIC) {
+            shutdown(client->fd, SHUT_RDWR);
+            client->used = 0;
+            return;
+        }
+        size_t total = sizeof(request) + request.length;
+        if (client->used < total) break;
+
+        char payload[DAEMON_MAX_PAYLOAD + 1];
+        memcpy(payload, client->buffer + sizeof(request), request.length);
+        payload[request.length] = '\0';
+        memmove(client->buffer, client->buffer + total, client->used - total);
+        client->used -= total;
+
+        handleDaemonRequest(daemon, clientIndex, &request, payload);
+    }
+}
+
+// Reap every exited child, record it and answer whoever waits on it
+void reapDaemonRuns(Daemon *daemon) {
+    for (;;) {
+        int status = 0;
+        struct rusage usage;
+        pid_t pid = wait4(-1, &status, WNOHANG, &usage);
+        if (pid <= 0) break;
+
+        int slot = -1;
+        for (int i = 0; i < DAEMON_MAX_RUNS && slot < 0; i++) {
+            if (daemon->runs[i].active && daemon->runs[i].pid == pid) slot = i;
+        }
+        if (slot < 0) continue;
+
+        DaemonRun *run = &daemon->runs[slot];
+        RunResult result = {0};
+        result.exitCode = -1;
+        fillRunResult(status, &usage, &result);
+        result.wallSeconds = getMonotonicSeconds() - run->startTime;
+        if (run->inlineRun) {
+            appendRunHistory(&daemon->history, run->historyKey, &result);
+        }
+
+        if (run->client >= 0) {
+            HistoryRecord record = {0};
+            record.scriptKey = run->historyKey;
+            record.timestamp = (int64_t)time(NULL);
+            record.durationMs = (uint32_t)(result.wallSeconds * 1000.0);
+            record.exitCode = result.exitCode;
+            record.maxRssKb = (uint32_t)result.maxRssKb;
+            daemon->clients[run->client].waitingRun = -1;
+            sendDaemonResponse(daemon, run->client, result.exitCode, &record, sizeof(record));
+        }
+        run->active = false;
+        daemon->runCount--;
+    }
+}
+
+// `kort --daemon`: serve requests until SIGINT/SIGTERM, returns the exit status
+int runDaemon(void) {
+    static Daemon daemon;
+    memset(&daemon, 0, sizeof(daemon));
+    daemon.startTime = getMonotonicSeconds();
+    getScriptsPath(daemon.scriptDir, sizeof(daemon.scriptDir));
+    getHistoryPath(daemon.scriptDir, daemon.history.path, sizeof(daemon.history.path));
+    for (int i = 0; i < DAEMON_MAX_CLIENTS; i++) {
+        daemon.clients[i].fd = -1;
+    }
+
+    struct sockaddr_un address = {0};
+    address.sun_family = AF_UNIX;
+    if (getDaemonSocketPath(address.sun_path, sizeof(address.sun_path))) {
+        char directory[sizeof(address.sun_path)];
+        snprintf(directory, sizeof(directory), "%s", address.sun_path);
+        *strrchr(directory, '/') = '\0';
+        if (!preparePrivateDirectory(directory)) return 1;
+    }
+
+    int existing = connectDaemon();
+    if (existing >= 0) {
+        close(existing);
+        fprintf(stderr, "kort: a daemon is already listening on %s\n", address.sun_path);
+        return 1;
+    }
+    // Only a stale socket of our own is replaced, never someone else's file
+    struct stat stale;
+    if (lstat(address.sun_path, &stale) == 0) {
+        if (!S_ISSOCK(stale.st_mode) || stale.st_uid != getuid()) {
+            fprintf(stderr, "kort: %s is not a socket of this user, not replacing it\n", address.sun_path);
+            return 1;
+        }
+        unlink(address.sun_path);
+    }
+    refreshDaemonIndex(&daemon);
+    daemon.nullFd = open("/dev/null", O_RDWR | O_CLOEXEC);
+    if (daemon.nullFd < 0) {
+        fprintf(stderr, "kort: cannot open /dev/null: %s\n", strerror(errno));
+        return 1;
+    }
+    daemon.spawnerTarget = getWarmShellTarget();
+
+    daemon.listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    mode_t oldMask = umask(077);
+    bool bound = daemon.listenFd >= 0 && bind(daemon.listenFd, (struct sockaddr*)&address, sizeof(address)) == 0;
+    umask(oldMask);
+    if (!bound || listen(daemon.listenFd, 128) != 0) {
+        fprintf(stderr, "kort: cannot listen on %s: %s\n", address.sun_path, strerror(errno));
+        return 1;
+    }
 
-    strncpy(modal->filename, file->displayName, MAX_FILENAME_CHARS);
-    modal->filename[MAX_FILENAME_CHARS] = '\0';
-    modal->filenameLength = strlen(modal->filename);
+    if (pipe(daemonSignalPipe) != 0) {
+        return 1;
+    }
+    for (int i = 0; i < 2; i++) {
+        fcntl(daemonSignalPipe[i], F_SETFD, FD_CLOEXEC);
+        fcntl(daemonSignalPipe[i], F_SETFL, O_NONBLOCK);
+    }
+    struct sigaction action = {0};
+    action.sa_handler = daemonSignalHandler;
+    action.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGCHLD, &action, NULL);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    printf("[DAEMON] Listening on %s\n", address.sun_path);
+    fflush(stdout);
+
+    struct pollfd pollFds[2 + DAEMON_MAX_CLIENTS];
+    int pollClients[DAEMON_MAX_CLIENTS];
+    while (!daemonStopRequested) {
+        int count = 0;
+        pollFds[count++] = (struct pollfd){ daemon.listenFd, POLLIN, 0 };
+        pollFds[count++] = (struct pollfd){ daemonSignalPipe[0], POLLIN, 0 };
+        int clientCount = 0;
+        for (int i = 0; i < DAEMON_MAX_CLIENTS; i++) {
+            if (daemon.clients[i].fd < 0) continue;
+            pollClients[clientCount++] = i;
+            pollFds[count++] = (struct pollfd){ daemon.clients[i].fd, POLLIN, 0 };
+        }
 
-    char *content = readFileContent(file->filePath);
-    if (content != NULL) {
-        char *actualCommand = content;
-#ifdef PLATFORM_WINDOWS
-        if (strncmp(content, "@echo off", 9) == 0) {
-            actualCommand = strchr(content, '\n');
-            if (actualCommand) actualCommand++;
+        // Spawners are forked once nothing happened for a millisecond, so a fork neither holds up
+        // a waiting request nor competes with the run that just started
+        int ready = poll(pollFds, count, daemon.spawnerCount < daemon.spawnerTarget ? 1 : -1);
+        if (ready < 0) {
+            if (errno == EINTR) continue;
+            break;
         }
-#else
-        if (strncmp(content, "#!/bin/bash", 11) == 0) {
-            actualCommand = strchr(content, '\n');
-            if (actualCommand) actualCommand++;
+        if (ready == 0) {
+            refillDaemonSpawners(&daemon);
+            continue;
         }
-#endif
 
-        if (actualCommand) {
-            strncpy(modal->command, actualCommand, MAX_COMMAND_CHARS);
-            modal->command[MAX_COMMAND_CHARS] = '\0';
-            int len = strlen(modal->command);
-            while (len > 0 && (modal->command[len-1] == '\n' || modal->command[len-1] == '\r')) {
-                modal->command[--len] = '\0';
+        if (pollFds[1].revents & POLLIN) {
+            char drain[64];
+            while (read(daemonSignalPipe[0], drain, sizeof(drain)) > 0) {
             }
-            modal->commandLength = len;
         }
-        free(content);
-    }
+        // Also catches exits whose SIGCHLD coalesced with another
+        reapDaemonRuns(&daemon);
 
-    modal->filenameActive = true;
-    modal->commandActive = false;
-    modal->framesCounter = 0;
-    modal->commandScrollOffsetY = 0;
-    modal->commandScrollOffsetX = 0;
-    modal->commandMaxScrollY = 0;
-    modal->commandMaxScrollX = 0;
-    modal->undoStackSize = 0;
-    modal->redoStackSize = 0;
-    modal->cursorPos = modal->commandLength;
-    modal->selectionStart = 0;
-    modal->selectionEnd = 0;
-    modal->hasSelection = false;
-    modal->isManualScrolling = false;
-    modal->manualScrollTimer = 0;
-    modal->isDraggingScrollbar = false;
-    modal->scrollbarDragOffset = 0;
+        for (int i = 0; i < clientCount; i++) {
+            if (pollFds[2 + i].revents & (POLLIN | POLLHUP | POLLERR)) {
+                readDaemonClient(&daemon, pollClients[i]);
+            }
+        }
 
-    // Push initial state to undo stack
-    if (modal->commandLength > 0) {
-        pushUndo(modal);
+        if (pollFds[0].revents & POLLIN) {
+            int fd = accept4(daemon.listenFd, NULL, NULL, SOCK_CLOEXEC);
+            if (fd >= 0 && !isPeerOwnUser(fd)) {
+                close(fd);
+                fd = -1;
+            }
+            int slot = -1;
+            for (int i = 0; i < DAEMON_MAX_CLIENTS && slot < 0 && fd >= 0; i++) {
+                if (daemon.clients[i].fd < 0) slot = i;
+            }
+            if (slot >= 0) {
+                DaemonClient *client = &daemon.clients[slot];
+                client->fd = fd;
+                client->used = 0;
+                client->passedFdCount = 0;
+                client->waitingRun = -1;
+            } else if (fd >= 0) {
+                close(fd);
+            }
+        }
     }
-}
 
-// Close modal
-void closeModal(Modal *modal) {
-    modal->isOpen = false;
+    printf("[DAEMON] Shutting down, %d runs still going, %llu of %llu launched warm\n", daemon.runCount,
+           (unsigned long long)daemon.warmLaunches, (unsigned long long)daemon.launched);
+    // Idle spawners exit on the EOF
+    for (int i = 0; i < daemon.spawnerCount; i++) {
+        close(daemon.spawners[i].commandFd);
+    }
+    close(daemon.nullFd);
+    close(daemon.listenFd);
+    unlink(address.sun_path);
+    return 0;
 }
 
-// Draw a simple file icon
-void drawFileIcon(int x, int y, Color color) {
-    DrawRectangle(x, y + 3, 16, 20, color);
-    DrawRectangle(x, y, 12, 3, color);
-    DrawTriangle((Vector2){x + 12, y}, (Vector2){x + 16, y + 3}, (Vector2){x + 12, y + 3}, color);
-    DrawRectangle(x + 3, y + 8, 10, 1, RAYWHITE);
-    DrawRectangle(x + 3, y + 11, 10, 1, RAYWHITE);
-    DrawRectangle(x + 3, y + 14, 7, 1, RAYWHITE);
-}
+// Run scripts through the daemon on our stdio and in our cwd, at most maxParallel at once. Same
+// status rules as runScriptsInline
+int runScriptsViaDaemon(int firstFd, int cwdFd, char **names, int count, int maxParallel) {
+    int *fds = (int*)malloc(count * sizeof(int));
+    struct pollfd *pollFds = (struct pollfd*)malloc(count * sizeof(struct pollfd));
+    if (fds == NULL || pollFds == NULL) {
+        free(fds);
+        free(pollFds);
+        close(firstFd);
+        return 1;
+    }
 
-// Draw folder icon
-void drawFolderIcon(int x, int y) {
-    DrawRectangle(x, y + 4, 18, 12, (Color){255, 200, 100, 255});
-    DrawRectangle(x, y + 2, 8, 3, (Color){255, 200, 100, 255});
-    DrawRectangleLines(x, y + 4, 18, 12, (Color){200, 150, 80, 255});
-}
+    static char payload[DAEMON_MAX_PAYLOAD];
+    const int runFds[DAEMON_RUN_FDS] = { cwdFd, STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO };
+    int status = 0;
+    int next = 0;
+    int running = 0;
+    int finished = 0;
+
+    while (finished < count) {
+        while (running < maxParallel && next < count) {
+            fds[next] = next == 0 ? firstFd : connectDaemon();
+            size_t length = buildDaemonRunPayload(names[next], payload, sizeof(payload));
+            if (fds[next] < 0 || !sendDaemonRequest(fds[next], DAEMON_OP_RUN, DAEMON_RUN_WAIT | DAEMON_RUN_INLINE,
+                                                    payload, length, runFds, DAEMON_RUN_FDS)) {
+                fprintf(stderr, "kort: lost the daemon before starting %s\n", names[next]);
+                if (fds[next] >= 0) close(fds[next]);
+                fds[next] = -1;
+                if (status == 0) status = 1;
+                finished++;
+            } else {
+                running++;
+            }
+            next++;
+        }
 
-// Helper function to draw text with custom font
-void DrawTextCustom(Font font, bool useFont, const char *text, int x, int y, int size, Color color) {
-    if (useFont) {
-        DrawTextEx(font, text, (Vector2){(float)x, (float)y}, (float)size, 1.0f, color);
-    } else {
-        DrawText(text, x, y, size, color);
+        int pollCount = 0;
+        for (int i = 0; i < next; i++) {
+            if (fds[i] >= 0) pollFds[pollCount++] = (struct pollfd){ fds[i], POLLIN, 0 };
+        }
+        if (pollCount == 0) continue;
+        if (poll(pollFds, pollCount, -1) < 0 && errno != EINTR) break;
+
+        for (int p = 0; p < pollCount; p++) {
+            if (pollFds[p].revents == 0) continue;
+            int i = 0;
+            while (fds[i] != pollFds[p].fd) i++;
+
+            DaemonResponse response;
+            char *payload = NULL;
+            int result;
+            if (!readDaemonResponse(fds[i], &response, &payload)) {
+                fprintf(stderr, "kort: lost the daemon while %s was running\n", names[i]);
+                result = 1;
+            } else if (response.status == DAEMON_ERROR_UNKNOWN_SCRIPT) {
+                fprintf(stderr, "kort: no script named '%s'\n", names[i]);
+                result = 2;
+            } else if (response.status < 0) {
+                fprintf(stderr, "kort: the daemon could not start %s (%d)\n", names[i], response.status);
+                result = 127;
+            } else {
+                result = response.status;
+                if (count > 1 && payload != NULL && response.length >= sizeof(HistoryRecord)) {
+                    HistoryRecord record;
+                    memcpy(&record, payload, sizeof(record));
+                    fprintf(stderr, "kort: %s exited with %d after %.2fs\n", names[i], result, record.durationMs / 1000.0);
+                }
+            }
+            free(payload);
+            close(fds[i]);
+            fds[i] = -1;
+            if (status == 0 && result != 0) status = result;
+            running--;
+            finished++;
+        }
     }
-}
 
-// Draw command text with line numbers and scrolling - OPTIMIZED VERSION
-void DrawCommandWithLineNumbers(Font font, bool useFont,
-                                const char *text,
-                                Rectangle box,
-                                float scrollY,
-                                int _fontSize,
-                                int cursorPos,
-                                bool showCursor,
-                                int selStart,
-                                int selEnd,
-                                bool hasSelection) {
-
-    // Draw line number background OUTSIDE scissor mode
-    DrawRectangle((int)box.x, (int)box.y, 40, (int)box.height, (Color){50, 52, 64, 255});
-    DrawLine((int)box.x + 40, (int)box.y, (int)box.x + 40, (int)box.y + (int)box.height, (Color){98, 114, 164, 255});
+    free(fds);
+    free(pollFds);
+    return status;
+}
 
-    // Start scissor mode for scrollable content
-    BeginScissorMode(
-        (int)box.x,
-        (int)box.y,
-        (int)box.width,
-        (int)box.height
-    );
+// Forward a CLI command to the daemon. Returns -1 when no daemon is listening or the
+// command is not one it serves, so the caller handles it locally
+int runDaemonCommand(int argc, char **argv) {
+    bool isList = strcmp(argv[1], "list") == 0 && argc == 2;
+    bool isStatus = strcmp(argv[1], "status") == 0 && argc == 2;
+    bool isTrigger = strcmp(argv[1], "trigger") == 0 && argc == 3;
+    bool isParallel = strcmp(argv[1], "run") == 0 && argc > 3 && strcmp(argv[2], "--parallel") == 0;
+    bool isRun = strcmp(argv[1], "run") == 0 && (isParallel || (argc == 3 && strcmp(argv[2], "--parallel") != 0));
+    if (!isList && !isStatus && !isTrigger && !isRun) {
+        return -1;
+    }
 
-    int lineHeight = _fontSize + 4;
-    float yOffset = -scrollY;
-    int lineNumber = 1;
+    // Runs go out with our cwd and environment. When those can't be passed (a removed cwd, an
+    // environment past the payload limit) they run locally instead
+    static char runPayload[DAEMON_MAX_PAYLOAD];
+    int first = isParallel ? 3 : 2;
+    int cwdFd = -1;
+    size_t runLength = 0;
+    if (isRun || isTrigger) {
+        for (int i = first; i < argc; i++) {
+            runLength = buildDaemonRunPayload(argv[i], runPayload, sizeof(runPayload));
+            if (runLength == 0) return -1;
+        }
+        cwdFd = open(".", O_PATH | O_DIRECTORY | O_CLOEXEC);
+        if (cwdFd < 0) return -1;
+    }
 
-    // Normalize selection
-    int actualSelStart = selStart;
-    int actualSelEnd = selEnd;
-    if (hasSelection && selStart > selEnd) {
-        actualSelStart = selEnd;
-        actualSelEnd = selStart;
+    int fd = connectDaemon();
+    if (fd < 0) {
+        if (cwdFd >= 0) close(cwdFd);
+        return -1;
     }
 
-    int charIndex = 0;
-    int textLen = strlen(text);
-    int lineStart = 0;
+    if (isRun) {
+        int status = runScriptsViaDaemon(fd, cwdFd, argv + first, argc - first, getParallelLimit(argc - first));
+        close(cwdFd);
+        return status;
+    }
 
-    // Calculate visible range to skip rendering invisible lines
-    int firstVisibleLine = (int)(scrollY / lineHeight);
-    if (firstVisibleLine < 0) firstVisibleLine = 0;
+    DaemonResponse response;
+    char *payload = NULL;
+    int status = -1;
+    DaemonOp op = isList ? DAEMON_OP_LIST : isStatus ? DAEMON_OP_STATUS : DAEMON_OP_RUN;
+    bool sent = isTrigger ? sendDaemonRequest(fd, op, 0, runPayload, runLength, &cwdFd, 1)
+                          : sendDaemonRequest(fd, op, 0, NULL, 0, NULL, 0);
+    if (sent && readDaemonResponse(fd, &response, &payload)) {
+        status = 0;
+        if (isList) {
+            for (char *line = payload; line != NULL && *line != '\0'; ) {
+                char *end = strchr(line, '\n');
+                if (end != NULL) *end = '\0';
+                char *tab = strchr(line, '\t');
+                if (tab != NULL) *tab = '\0';
+                printf("%-32s %s\n", line, tab != NULL ? tab + 1 : "");
+                line = end != NULL ? end + 1 : NULL;
+            }
+        } else if (isStatus) {
+            fputs(payload != NULL ? payload : "", stdout);
+        } else if (response.status == DAEMON_ERROR_UNKNOWN_SCRIPT) {
+            fprintf(stderr, "kort: no script named '%s'\n", argv[2]);
+            status = 2;
+        } else if (response.status < 0) {
+            fprintf(stderr, "kort: the daemon could not start %s (%d)\n", argv[2], response.status);
+            status = 1;
+        }
+    } else if (isTrigger) {
+        // It may already have started, running it again locally could double it
+        fprintf(stderr, "kort: lost the daemon while triggering %s\n", argv[2]);
+        status = 1;
+    }
 
-    int visibleLines = (int)(box.height / lineHeight) + 2; // +2 for partial lines
+    free(payload);
+    if (cwdFd >= 0) close(cwdFd);
+    close(fd);
+    return status;
+}
+#endif
 
-    // Parse lines without modifying original text
-    for (int i = 0; i <= textLen; i++) {
-        bool isNewline = (text[i] == '\n' || text[i] == '\0');
+// Command line usage, printed for anything the CLI does not understand
+void printUsage(void) {
+    fprintf(stderr,
+            "usage: kort                              open the script manager\n"
+            "       kort list                         list the scripts\n"
+            "       kort run <name>                   run a script here and exit with its status\n"
+            "       kort run --parallel <name>...     run several at once (KORT_MAX_PARALLEL caps it)\n"
+            "       kort trigger <name>               start a script in a terminal window and return\n"
+            "       kort status                       show what the daemon is running\n"
+            "       kort --daemon                     keep the index resident and serve the commands above\n"
+            "a <name> in a subfolder is its path from the scripts folder, e.g. client/deploy\n");
+}
 
-        if (isNewline) {
-            float lineY = box.y + yOffset;
+// Run scripts on kort's own stdio, at most maxParallel at once. Returns the first
+// failing status (0 when all succeeded)
+int runScriptsInline(const ScriptIndex *index, const int *fileIndices, int count, int maxParallel, RunHistory *history) {
+    ScriptRun *runs = (ScriptRun*)calloc(count, sizeof(ScriptRun));
+    if (runs == NULL) {
+        return 1;
+    }
 
-            // Only process visible lines
-            if (lineNumber >= firstVisibleLine && lineNumber < firstVisibleLine + visibleLines) {
-                // Draw line number
-                DrawText(TextFormat("%d", lineNumber),
-                         (int)(box.x + 5),
-                         (int)lineY,
-                         _fontSize,
-                         (Color){139, 233, 253, 255});
+    int status = 0;
+    int next = 0;
+    int running = 0;
+    int finished = 0;
+
+    while (finished < count) {
+        while (running < maxParallel && next < count) {
+            ScriptRun *run = &runs[next];
+            const FileItem *file = &index->files[fileIndices[next]];
+            run->fileIndex = fileIndices[next];
+            run->startTime = getMonotonicSeconds();
+            getFilePath(index, file, run->filePath, sizeof(run->filePath));
+            run->pid = executeFileContent(run->filePath, RUN_MODE_INLINE, &run->processHandle, &run->jobHandle, NULL);
+            if (run->pid == 0) {
+                fprintf(stderr, "kort: could not start %s\n", file->displayName);
+                if (status == 0) status = 127;
+                finished++;
+            } else {
+                run->active = true;
+                running++;
+            }
+            next++;
+        }
 
-                int lineLen = i - lineStart;
+        // A single run can simply block, several are polled so any of them can finish first
+        bool reaped = false;
+        for (int i = 0; i < next; i++) {
+            ScriptRun *run = &runs[i];
+            RunResult result;
+            if (!run->active || !collectProcessResult(run->pid, run->processHandle, count == 1, &result)) continue;
+
+            result.wallSeconds = getMonotonicSeconds() - run->startTime;
+            appendRunHistory(history, index->files[run->fileIndex].historyKey, &result);
+            if (count > 1) {
+                fprintf(stderr, "kort: %s exited with %d after %.2fs\n",
+                        index->files[run->fileIndex].displayName, result.exitCode, result.wallSeconds);
+            }
+            if (status == 0 && result.exitCode != 0) {
+                status = result.exitCode > 0 ? result.exitCode : 1;
+            }
 
-                // Draw selection highlight for this line
-                if (hasSelection && lineLen > 0) {
-                    int lineCharStart = charIndex;
-                    int lineCharEnd = charIndex + lineLen;
+#ifdef PLATFORM_WINDOWS
+            CloseHandle(run->processHandle);
+            if (run->jobHandle != NULL) CloseHandle(run->jobHandle);
+#endif
+            run->active = false;
+            running--;
+            finished++;
+            reaped = true;
+        }
+        if (!reaped && running > 0) {
+            sleepBriefly();
+        }
+    }
 
-                    if (actualSelEnd > lineCharStart && actualSelStart < lineCharEnd) {
-                        int selStartInLine = actualSelStart > lineCharStart ? actualSelStart - lineCharStart : 0;
-                        int selEndInLine = actualSelEnd < lineCharEnd ? actualSelEnd - lineCharStart : lineLen;
+    free(runs);
+    return status;
+}
 
-                        // Measure text before selection
-                        char beforeSel[512];
-                        int beforeLen = selStartInLine > 511 ? 511 : selStartInLine;
-                        strncpy(beforeSel, text + lineStart, beforeLen);
-                        beforeSel[beforeLen] = '\0';
+// Headless front end, never touches raylib. Returns the exit status, or -1 when
+// there are no arguments and the window should open
+int runCommandLine(int argc, char **argv) {
+    if (argc < 2) {
+        return -1;
+    }
 
-                        // Measure selected text
-                        char selected[512];
-                        int selLen = (selEndInLine - selStartInLine) > 511 ? 511 : (selEndInLine - selStartInLine);
-                        strncpy(selected, text + lineStart + selStartInLine, selLen);
-                        selected[selLen] = '\0';
+#ifdef PLATFORM_WINDOWS
+    // Release builds are GUI subsystem, borrow the console of whoever started us
+    if (GetStdHandle(STD_OUTPUT_HANDLE) == NULL && AttachConsole(ATTACH_PARENT_PROCESS)) {
+        freopen("CONOUT$", "w", stdout);
+        freopen("CONOUT$", "w", stderr);
+    }
+#endif
 
-                        Vector2 beforeSize = MeasureTextEx(font, beforeSel, (float)_fontSize, 1.0f);
-                        Vector2 selSize = MeasureTextEx(font, selected, (float)_fontSize, 1.0f);
+    if (strcmp(argv[1], "--daemon") == 0 && argc == 2) {
+#ifdef PLATFORM_WINDOWS
+        fprintf(stderr, "kort: --daemon needs Unix domain sockets and is not available on Windows\n");
+        return 1;
+#else
+        return runDaemon();
+#endif
+    }
 
-                        DrawRectangle((int)(box.x + 45 + beforeSize.x), (int)lineY,
-                                    (int)selSize.x, lineHeight, (Color){80, 120, 200, 180});
-                    }
-                }
+#ifndef PLATFORM_WINDOWS
+    // A running daemon answers without this process scanning the scripts directory
+    int daemonStatus = runDaemonCommand(argc, argv);
+    if (daemonStatus >= 0) {
+        return daemonStatus;
+    }
+#endif
 
-                // Draw line text (only if not empty)
-                if (lineLen > 0) {
-                    char lineText[512];
-                    int copyLen = lineLen > 511 ? 511 : lineLen;
-                    strncpy(lineText, text + lineStart, copyLen);
-                    lineText[copyLen] = '\0';
-
-                    DrawTextEx(font,
-                               lineText,
-                               (Vector2){box.x + 45, lineY},
-                               (float)_fontSize,
-                               1.0f,
-                               (Color){248, 248, 242, 255});
-                }
+    if (strcmp(argv[1], "status") == 0 && argc == 2) {
+        fprintf(stderr, "kort: no daemon running\n");
+        return 1;
+    }
 
-                // Draw cursor if it's on this line
-                if (showCursor && cursorPos >= charIndex && cursorPos <= charIndex + lineLen) {
-                    int cursorPosInLine = cursorPos - charIndex;
+    static ScriptIndex scriptIndex;
+    char scriptDir[512];
+    getScriptsPath(scriptDir, sizeof(scriptDir));
+    loadFiles(&scriptIndex, scriptDir);
+    if (strcmp(argv[1], "trigger") == 0 && argc == 3) {
+        int fileIndex = findScriptArgument(&scriptIndex, argv[2]);
+        if (fileIndex < 0) {
+            fprintf(stderr, "kort: no script named '%s' in %s\n", argv[2], scriptDir);
+            return 2;
+        }
+        // Not waited for, it outlives this process like a terminal run from the GUI
+        void *processHandle = NULL;
+        void *jobHandle = NULL;
+        char filePath[1024];
+        getFilePath(&scriptIndex, &scriptIndex.files[fileIndex], filePath, sizeof(filePath));
+        ProcessId pid = executeFileContent(filePath, RUN_MODE_TERMINAL, &processHandle, &jobHandle, NULL);
+#ifdef PLATFORM_WINDOWS
+        if (processHandle != NULL) CloseHandle(processHandle);
+        if (jobHandle != NULL) CloseHandle(jobHandle);
+#endif
+        return pid != 0 ? 0 : 1;
+    }
 
-                    char beforeCursor[512];
-                    int beforeLen = cursorPosInLine > 511 ? 511 : cursorPosInLine;
-                    strncpy(beforeCursor, text + lineStart, beforeLen);
-                    beforeCursor[beforeLen] = '\0';
+    if (strcmp(argv[1], "list") == 0 && argc == 2) {
+        for (int i = 0; i < scriptIndex.count; i++) {
+            printf("%-32s %s\n", scriptIndex.files[i].displayName, scriptIndex.files[i].fileName);
+        }
+        return 0;
+    }
 
-                    Vector2 beforeSize = MeasureTextEx(font, beforeCursor, (float)_fontSize, 1.0f);
+    if (strcmp(argv[1], "run") == 0) {
+        bool parallel = argc > 2 && strcmp(argv[2], "--parallel") == 0;
+        int first = parallel ? 3 : 2;
+        int count = argc - first;
+        if (count < 1 || (!parallel && count != 1)) {
+            printUsage();
+            return 2;
+        }
 
-                    // Draw cursor line
-                    DrawRectangle((int)(box.x + 45 + beforeSize.x), (int)lineY,
-                                2, lineHeight, (Color){248, 248, 242, 255});
-                }
+        int *fileIndices = (int*)malloc(count * sizeof(int));
+        if (fileIndices == NULL) {
+            return 1;
+        }
+        for (int i = 0; i < count; i++) {
+            fileIndices[i] = findScriptArgument(&scriptIndex, argv[first + i]);
+            if (fileIndices[i] < 0) {
+                fprintf(stderr, "kort: no script named '%s' in %s\n", argv[first + i], scriptDir);
+                free(fileIndices);
+                return 2;
             }
+        }
 
-            charIndex += (i - lineStart) + 1; // +1 for the newline
-            yOffset += lineHeight;
-            lineNumber++;
-            lineStart = i + 1;
+        int maxParallel = getParallelLimit(count);
 
-            if (text[i] == '\0') break;
-        }
+        // Runs are appended to the history, but it is never loaded here
+        RunHistory history = {0};
+        getHistoryPath(scriptDir, history.path, sizeof(history.path));
+
+        int status = runScriptsInline(&scriptIndex, fileIndices, count, maxParallel, &history);
+        free(fileIndices);
+        return status;
     }
 
-    EndScissorMode();
+    printUsage();
+    return 2;
 }
 
-int main() {
-    FileItem files[MAX_FILES];
-    int fileCount = 0;
+int main(int argc, char **argv) {
+    int commandStatus = runCommandLine(argc, argv);
+    if (commandStatus >= 0) {
+        return commandStatus;
+    }
+
+    double startTime = getMonotonicSeconds();
+
+    // files and fileCount alias the index and are refreshed after every change to it
+    static ScriptIndex scriptIndex;
     char scriptDir[512];
     getScriptsPath(scriptDir, sizeof(scriptDir));
 
-    fileCount = loadFiles(files, scriptDir);
+    // Paths are searchable as soon as they are listed, bodies once the indexer thread has read them
+    static SearchIndex scriptSearch;
+    initSearchIndex(&scriptSearch, scriptDir);
+    scriptIndex.search = &scriptSearch;
+    static SearchResult searchResults[SEARCH_MAX_RESULTS];
+    int searchResultCount = 0;
+    char searchQuery[SEARCH_MAX_QUERY + 1] = "";
+    int searchLength = 0;
+    char searchedQuery[SEARCH_MAX_QUERY + 1] = "";
+    uint64_t searchedGeneration = 0;
+    double searchMs = 0.0;
+
+    // The same box greps every script for the exact text once switched to contents
+    static ContentGrep contentGrep;
+    initContentGrep(&contentGrep, scriptDir);
+    bool grepMode = false;
+    char greppedQuery[SEARCH_MAX_QUERY + 1] = "";
+
+    resetScriptIndex(&scriptIndex, scriptDir);
+
+    // Last session's listing is shown in the first frame, the scan thread then checks it against the disk
+    static IndexCache indexCache;
+    if (openIndexCache(&indexCache, scriptDir)) {
+        loadIndexCache(&indexCache, &scriptIndex);
+        printf("[STARTUP] Listed %d cached scripts after %.1f ms\n", scriptIndex.count,
+               (getMonotonicSeconds() - startTime) * 1000.0);
+    }
+    FileItem *files = scriptIndex.files;
+    int fileCount = scriptIndex.count;
+
+    // Scripts copied in from outside show up live, without rescanning the directory
+    static ScriptWatcher scriptWatcher;
+    startScriptWatcher(&scriptWatcher, scriptDir);
+
+    // Without a cache the list starts empty and fills in while the first frames are drawn
+    startScriptScan(&scriptWatcher, &scriptIndex, &indexCache, startTime);
+    bool firstFrameDrawn = false;
+
+    // Aggregated off-thread so a long history never delays the first frame
+    static RunHistory runHistory;
+    initRunHistory(&runHistory, scriptDir);
+    scriptIndex.history = &runHistory;
 
     SetConfigFlags(FLAG_WINDOW_RESIZABLE);
     InitWindow(screenWidth, screenHeight, "k0rT Script Manager");
@@ -855,16 +8603,43 @@ int main() {
 
     Rectangle addButton = { 10, 10, 40, 40 };
     Rectangle folderButton = { 60, 10, 40, 40 };
+    Rectangle searchModeButton = { 20, 62, 90, 30 };
+    Rectangle searchBox = { 118, 62, GetScreenWidth() - 318, 30 };
+    Rectangle sortButton = { 0, 62, 170, 30 };
+    Rectangle searchClearButton = { 0, 66, 22, 22 };
 
     ScrollableList scrollList;
-    scrollList.container = (Rectangle){ 20, 70, GetScreenWidth() - 40, GetScreenHeight() - 130 };
+    scrollList.container = (Rectangle){ 20, 104, GetScreenWidth() - 40, GetScreenHeight() - 164 };
     scrollList.scrollOffset = 0;
     scrollList.maxScroll = 0;
 
     Modal modal;
     initModal(&modal);
 
-    int executingIndex = -1;
+    RunManager runManager;
+    initRunManager(&runManager);
+    runManager.history = &runHistory;
+    RunMode runMode = RUN_MODE_TERMINAL;
+    Rectangle modeButton = { 0, 15, 150, 30 };
+
+    // Batch runs: KORT_MAX_PARALLEL overrides the default concurrency cap
+    int poolConcurrency = DEFAULT_POOL_WORKERS;
+    const char *parallelEnv = getenv("KORT_MAX_PARALLEL");
+    if (parallelEnv != NULL && atoi(parallelEnv) > 0) {
+        poolConcurrency = atoi(parallelEnv) > MAX_POOL_WORKERS ? MAX_POOL_WORKERS : atoi(parallelEnv);
+    }
+    WorkerPool workerPool;
+    initWorkerPool(&workerPool, poolConcurrency);
+    Rectangle runSelectedButton = { 0, 15, 150, 30 };
+    Rectangle poolMinusButton = { 0, 18, 24, 24 };
+    Rectangle poolPlusButton = { 0, 18, 24, 24 };
+
+    // Dependency pipelines share the pool's event queue and concurrency cap
+    static Pipeline pipeline;
+    char pipelineSummary[320] = "";
+    Rectangle pipelineButton = { 0, 15, 130, 30 };
+    Rectangle consolePanel = {0};
+    Rectangle consoleCloseButton = {0};
     Image icon = LoadImage("icons/logo.png");
     SetWindowIcon(icon);
 
@@ -873,12 +8648,106 @@ int main() {
     while (!WindowShouldClose()) {
         Vector2 mousePoint = GetMousePosition();
 
+        pollRunHistory(&runHistory);
+        applyScriptChanges(&scriptWatcher, &scriptIndex, &runManager, &workerPool);
+        files = scriptIndex.files;
+        fileCount = scriptIndex.count;
+        pollScriptRuns(&runManager, &scriptIndex);
+        processRunEvents(&workerPool, &runManager, &scriptIndex);
+        enforceRunDeadlines(&runManager, &scriptIndex);
+        pollPipeline(&pipeline, pipelineSummary, sizeof(pipelineSummary));
+        pumpOutputCaptures(&runManager);
+        pollSearchIndex(&scriptSearch);
+        refreshScriptOrders(&scriptIndex);
+
         scrollList.container.width = GetScreenWidth() - 40;
-        scrollList.container.height = GetScreenHeight() - 130;
+        scrollList.container.height = GetScreenHeight() - 164;
+        searchBox.width = GetScreenWidth() - 318;
+        sortButton.x = GetScreenWidth() - 190;
+        searchClearButton.x = searchBox.x + searchBox.width - 26;
+        modeButton.x = GetScreenWidth() - 170;
+        runSelectedButton.x = modeButton.x - 160;
+        poolPlusButton.x = runSelectedButton.x - 34;
+        poolMinusButton.x = poolPlusButton.x - 64;
+        pipelineButton.x = poolMinusButton.x - 140;
+
+        // Console panel takes the bottom of the list area while it shows a capture
+        if (runManager.shownCapture != NULL) {
+            scrollList.container.height -= CONSOLE_PANEL_HEIGHT + 10;
+            consolePanel = (Rectangle){ 20, scrollList.container.y + scrollList.container.height + 10,
+                                        scrollList.container.width, CONSOLE_PANEL_HEIGHT };
+            consoleCloseButton = (Rectangle){ consolePanel.x + consolePanel.width - 28, consolePanel.y + 4, 22, 20 };
+        }
+
+        // Typing while no modal is open goes to the search box
+        if (!modal.isOpen) {
+            int key = GetCharPressed();
+            while (key > 0) {
+                if (key >= 32 && key <= 126 && searchLength < SEARCH_MAX_QUERY) {
+                    searchQuery[searchLength++] = (char)key;
+                    searchQuery[searchLength] = '\0';
+                }
+                key = GetCharPressed();
+            }
+            if ((IsKeyPressed(KEY_BACKSPACE) || IsKeyPressedRepeat(KEY_BACKSPACE)) && searchLength > 0) {
+                searchQuery[--searchLength] = '\0';
+            }
+            if (searchLength > 0 && IsMouseButtonPressed(MOUSE_LEFT_BUTTON) && CheckCollisionPointRec(mousePoint, searchClearButton)) {
+                searchLength = 0;
+                searchQuery[0] = '\0';
+            }
+            if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON) && CheckCollisionPointRec(mousePoint, sortButton)) {
+                scriptIndex.sortMode = (SortMode)((scriptIndex.sortMode + 1) % SORT_MODE_COUNT);
+            }
+            if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON) && CheckCollisionPointRec(mousePoint, searchModeButton)) {
+                grepMode = !grepMode;
+                greppedQuery[0] = '\0';
+                searchedQuery[0] = '\0';
+                if (!grepMode) cancelContentGrep(&contentGrep);
+            }
+        }
+
+        // Every change of the query restarts the grep, matches stream in while it runs
+        if (grepMode && strcmp(searchQuery, greppedQuery) != 0) {
+            memcpy(greppedQuery, searchQuery, sizeof(greppedQuery));
+            scrollList.scrollOffset = 0;
+            if (searchLength > 0) {
+                startContentGrep(&contentGrep, searchQuery);
+            } else {
+                cancelContentGrep(&contentGrep);
+            }
+        }
+        pollContentGrep(&contentGrep);
+        bool showGrep = grepMode && searchLength > 0;
+
+        // Rank again on every keystroke and whenever the index moved on, rows look results up by key
+        if (!grepMode && searchLength > 0 && (strcmp(searchQuery, searchedQuery) != 0 || scriptSearch.generation != searchedGeneration)) {
+            if (strcmp(searchQuery, searchedQuery) != 0) scrollList.scrollOffset = 0;
+            double searchStart = getMonotonicSeconds();
+            searchResultCount = searchScripts(&scriptSearch, &scriptIndex, searchQuery, searchResults, SEARCH_MAX_RESULTS);
+            searchMs = (getMonotonicSeconds() - searchStart) * 1000.0;
+            memcpy(searchedQuery, searchQuery, sizeof(searchedQuery));
+            searchedGeneration = scriptSearch.generation;
+        } else if (searchLength == 0 && searchedQuery[0] != '\0') {
+            searchedQuery[0] = '\0';
+            searchResultCount = 0;
+        }
+        const SearchResult *shownResults = !grepMode && searchLength > 0 ? searchResults : NULL;
 
-        int contentHeight = fileCount * 40;
+        // Rows of the expanded tree (or the matches), only the visible ones are ever resolved
+        int rowCount = showGrep ? contentGrep.matchCount :
+                       shownResults != NULL ? searchResultCount : scriptIndex.folders[0].contentRows;
+        int contentHeight = rowCount * 40;
         scrollList.maxScroll = contentHeight - scrollList.container.height;
         if (scrollList.maxScroll < 0) scrollList.maxScroll = 0;
+        if (scrollList.scrollOffset > scrollList.maxScroll) scrollList.scrollOffset = scrollList.maxScroll;
+        int firstRow = (int)((scrollList.scrollOffset - 50) / 40);
+        if (firstRow < 0) firstRow = 0;
+        if (shownResults != NULL) {
+            int lastRow = firstRow + (int)(scrollList.container.height / 40) + 2;
+            listSearchMatchFolders(&scriptWatcher, &scriptIndex, &scriptSearch, shownResults, firstRow,
+                                   lastRow < searchResultCount ? lastRow : searchResultCount);
+        }
 
         if (modal.isOpen) {
             modal.framesCounter++;
@@ -899,11 +8768,7 @@ int main() {
             int modalX = (GetScreenWidth() - modalWidth) / 2;
             int modalY = (GetScreenHeight() - modalHeight) / 2;
 
-            // Count lines for scrollbar calculation
-            int lineCount = 1;
-            for (int i = 0; i < modal.commandLength; i++) {
-                if (modal.command[i] == '\n') lineCount++;
-            }
+            int lineCount = getTextLineCount(&modal.command);
             int lineHeight = fontSize + 4;
             float contentHeight = lineCount * lineHeight;
             modal.commandMaxScrollY = contentHeight - 290;
@@ -977,7 +8842,7 @@ int main() {
 
                     // Set cursor position from mouse click (only if not on scrollbar)
                     if (useCustomFont && !modal.isDraggingScrollbar) {
-                        modal.cursorPos = getCursorPosFromMouse(customFont, modal.command,
+                        modal.cursorPos = getCursorPosFromMouse(&modal.layout, customFont, &modal.command,
                                                                (int)mousePoint.x, (int)mousePoint.y,
                                                                modal.commandBox, modal.commandScrollOffsetY);
                         modal.hasSelection = false;
@@ -990,7 +8855,7 @@ int main() {
             // Handle mouse dragging for selection (but not when dragging scrollbar)
             if (IsMouseButtonDown(MOUSE_LEFT_BUTTON) && isMouseDragging && modal.commandActive && !modal.isDraggingScrollbar) {
                 if (useCustomFont) {
-                    int newPos = getCursorPosFromMouse(customFont, modal.command,
+                    int newPos = getCursorPosFromMouse(&modal.layout, customFont, &modal.command,
                                                       (int)mousePoint.x, (int)mousePoint.y,
                                                       modal.commandBox, modal.commandScrollOffsetY);
                     modal.cursorPos = newPos;
@@ -1083,29 +8948,29 @@ int main() {
                         if (modal.hasSelection) {
                             int start = modal.selectionStart < modal.selectionEnd ? modal.selectionStart : modal.selectionEnd;
                             int end = modal.selectionStart > modal.selectionEnd ? modal.selectionStart : modal.selectionEnd;
-                            char temp[MAX_COMMAND_CHARS];
-                            strncpy(temp, modal.command + start, end - start);
-                            temp[end - start] = '\0';
-                            SetClipboardText(temp);
+                            char *temp = copyTextRange(&modal.command, start, end);
+                            if (temp != NULL) {
+                                SetClipboardText(temp);
+                                free(temp);
+                            }
                         }
                     } else if (IsKeyPressed(KEY_X)) {
                         // Cut
                         if (modal.hasSelection) {
                             int start = modal.selectionStart < modal.selectionEnd ? modal.selectionStart : modal.selectionEnd;
                             int end = modal.selectionStart > modal.selectionEnd ? modal.selectionStart : modal.selectionEnd;
-                            char temp[MAX_COMMAND_CHARS];
-                            strncpy(temp, modal.command + start, end - start);
-                            temp[end - start] = '\0';
-                            SetClipboardText(temp);
+                            char *temp = copyTextRange(&modal.command, start, end);
+                            if (temp != NULL) {
+                                SetClipboardText(temp);
+                                free(temp);
+                            }
 
-                            pushUndo(&modal);
                             deleteCharAtCursor(&modal, true);
                         }
                     } else if (IsKeyPressed(KEY_V)) {
                         // Paste
                         const char *clipText = GetClipboardText();
                         if (clipText != NULL) {
-                            pushUndo(&modal);
                             insertTextAtCursor(&modal, clipText);
                         }
                     }
@@ -1158,9 +9023,9 @@ int main() {
 
                 if (IsKeyPressed(KEY_UP) || IsKeyPressedRepeat(KEY_UP)) {
                     int line, col;
-                    getCursorLineCol(modal.command, modal.cursorPos, &line, &col);
+                    getCursorLineCol(&modal.command, modal.cursorPos, &line, &col);
                     if (line > 0) {
-                        int newPos = getCursorPosFromLineCol(modal.command, line - 1, col);
+                        int newPos = getCursorPosFromLineCol(&modal.command, line - 1, col);
                         if (shiftPressed) {
                             if (!modal.hasSelection) {
                                 modal.selectionStart = modal.cursorPos;
@@ -1181,8 +9046,8 @@ int main() {
 
                 if (IsKeyPressed(KEY_DOWN) || IsKeyPressedRepeat(KEY_DOWN)) {
                     int line, col;
-                    getCursorLineCol(modal.command, modal.cursorPos, &line, &col);
-                    int newPos = getCursorPosFromLineCol(modal.command, line + 1, col);
+                    getCursorLineCol(&modal.command, modal.cursorPos, &line, &col);
+                    int newPos = getCursorPosFromLineCol(&modal.command, line + 1, col);
                     if (newPos != modal.cursorPos) {
                         if (shiftPressed) {
                             if (!modal.hasSelection) {
@@ -1204,8 +9069,8 @@ int main() {
 
                 if (IsKeyPressed(KEY_HOME)) {
                     int line, col;
-                    getCursorLineCol(modal.command, modal.cursorPos, &line, &col);
-                    int newPos = getCursorPosFromLineCol(modal.command, line, 0);
+                    getCursorLineCol(&modal.command, modal.cursorPos, &line, &col);
+                    int newPos = getCursorPosFromLineCol(&modal.command, line, 0);
                     if (shiftPressed) {
                         if (!modal.hasSelection) {
                             modal.selectionStart = modal.cursorPos;
@@ -1225,8 +9090,8 @@ int main() {
 
                 if (IsKeyPressed(KEY_END)) {
                     int line, col;
-                    getCursorLineCol(modal.command, modal.cursorPos, &line, &col);
-                    int newPos = getCursorPosFromLineCol(modal.command, line, 10000);
+                    getCursorLineCol(&modal.command, modal.cursorPos, &line, &col);
+                    int newPos = getCursorPosFromLineCol(&modal.command, line, 10000);
                     if (shiftPressed) {
                         if (!modal.hasSelection) {
                             modal.selectionStart = modal.cursorPos;
@@ -1244,15 +9109,10 @@ int main() {
                     printf("[SCROLL] Cursor moved via keyboard (END), auto-scroll enabled\n");
                 }
 
-                // Regular text input
+                // Regular text input, the edit log groups consecutive keystrokes into one undo step
                 int key = GetCharPressed();
-                bool textChanged = false;
                 while (key > 0) {
                     if ((key >= 32) && (key <= 126)) {
-                        if (!textChanged) {
-                            pushUndo(&modal);
-                            textChanged = true;
-                        }
                         char ch[2] = {(char)key, '\0'};
                         insertTextAtCursor(&modal, ch);
                     }
@@ -1261,14 +9121,12 @@ int main() {
 
                 // Handle Enter for new line
                 if (IsKeyPressed(KEY_ENTER)) {
-                    pushUndo(&modal);
                     insertTextAtCursor(&modal, "\n");
                 }
 
                 // Handle Backspace
                 if (IsKeyPressed(KEY_BACKSPACE) || IsKeyPressedRepeat(KEY_BACKSPACE)) {
                     if (modal.commandLength > 0 || modal.hasSelection) {
-                        pushUndo(&modal);
                         deleteCharAtCursor(&modal, true);
                     }
                 }
@@ -1276,7 +9134,6 @@ int main() {
                 // Handle Delete
                 if (IsKeyPressed(KEY_DELETE) || IsKeyPressedRepeat(KEY_DELETE)) {
                     if (modal.commandLength > 0 || modal.hasSelection) {
-                        pushUndo(&modal);
                         deleteCharAtCursor(&modal, false);
                     }
                 }
@@ -1284,7 +9141,7 @@ int main() {
                 // Auto-scroll to cursor ONLY if not manually scrolling
                 if (!modal.isManualScrolling) {
                     int line, col;
-                    getCursorLineCol(modal.command, modal.cursorPos, &line, &col);
+                    getCursorLineCol(&modal.command, modal.cursorPos, &line, &col);
                     int lineHeight = fontSize + 4;
                     float cursorY = line * lineHeight;
 
@@ -1337,66 +9194,127 @@ int main() {
             // Check for folder button click
             if (CheckCollisionPointRec(mousePoint, folderButton)) {
                 if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) {
-                    openScriptsFolder(scriptDir);
+                    trackHelperProcess(&runManager, openScriptsFolder(scriptDir));
+                }
+            }
+
+            // Cycle terminal windows, in-app capture and capture on warm shells
+            if (CheckCollisionPointRec(mousePoint, modeButton) && IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) {
+                if (runMode == RUN_MODE_TERMINAL) {
+                    runMode = RUN_MODE_CAPTURE;
+                } else if (runMode == RUN_MODE_CAPTURE) {
+                    // Shells are only kept around once someone asks for them
+                    initWarmShells();
+                    runMode = RUN_MODE_WARM;
+                } else {
+                    runMode = RUN_MODE_TERMINAL;
                 }
             }
 
-            // Update file bounds and check for clicks
-            float y = scrollList.container.y + 10 - scrollList.scrollOffset;
-            float x = scrollList.container.x + 10;
+            // Batch controls: run every selected script through the pool
+            if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) {
+                if (CheckCollisionPointRec(mousePoint, runSelectedButton)) {
+                    runSelectedScripts(&workerPool, &runManager, &scriptIndex, runMode);
+                } else if (CheckCollisionPointRec(mousePoint, pipelineButton)) {
+                    startPipeline(&pipeline, &workerPool, &runManager, &scriptIndex, runMode,
+                                  pipelineSummary, sizeof(pipelineSummary));
+                } else if (CheckCollisionPointRec(mousePoint, poolMinusButton)) {
+                    setPoolConcurrency(&workerPool, workerPool.concurrencyCap - 1);
+                } else if (CheckCollisionPointRec(mousePoint, poolPlusButton)) {
+                    setPoolConcurrency(&workerPool, workerPool.concurrencyCap + 1);
+                }
+            }
 
-            for (int i = 0; i < fileCount; i++) {
-                files[i].bounds = (Rectangle){ x + 30, y, (float)MeasureText(files[i].displayName, fontSize), (float)fontSize };
-                files[i].editBounds = (Rectangle){
-                    scrollList.container.x + scrollList.container.width - 80,
-                    y - 2, 30, 24
-                };
-                files[i].deleteBounds = (Rectangle){
-                    scrollList.container.x + scrollList.container.width - 40,
-                    y - 2, 30, 24
-                };
-
-                if (y >= scrollList.container.y && y <= scrollList.container.y + scrollList.container.height) {
-                    if (CheckCollisionPointRec(mousePoint, files[i].bounds)) {
+            // Console panel scrolling and close
+            if (runManager.shownCapture != NULL) {
+                if (CheckCollisionPointRec(mousePoint, consoleCloseButton) && IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) {
+                    showOutputCapture(&runManager, NULL);
+                } else if (CheckCollisionPointRec(mousePoint, consolePanel)) {
+                    Rectangle textArea = { consolePanel.x + 8, consolePanel.y + 28, consolePanel.width - 16, consolePanel.height - 34 };
+                    updateConsoleScroll(&runManager.shownCapture->console, textArea, GetMouseWheelMove());
+                }
+            }
+
+            // Lay out the visible rows and check for clicks
+            for (int r = firstRow; r < rowCount; r++) {
+                float y = scrollList.container.y + 10 - scrollList.scrollOffset + r * 40;
+                if (y > scrollList.container.y + scrollList.container.height) break;
+
+                // A grep match opens its script in the editor, once the script is listed
+                if (showGrep) {
+                    Rectangle matchBounds = { scrollList.container.x + 10, y - 5, scrollList.container.width - 20, 30 };
+                    if (y >= scrollList.container.y && CheckCollisionPointRec(mousePoint, matchBounds) && IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) {
+                        int fileIndex = findIndexedFile(&scriptIndex, contentGrep.matches[r].fileName);
+                        if (fileIndex >= 0) openEditModal(&modal, &scriptIndex, &files[fileIndex]);
+                    }
+                    continue;
+                }
+
+                ScriptRow entry;
+                if (y >= scrollList.container.y && getListRow(&scriptIndex, shownResults, searchResultCount, r, &entry)) {
+                    float x = scrollList.container.x + 10 + entry.depth * 24;
+
+                    // Folder rows expand and collapse, listing the folder the first time
+                    if (entry.file < 0) {
+                        ScriptFolder *folder = &scriptIndex.folders[entry.folder];
+                        FileRowLayout row = getFileRowLayout(scrollList.container, x, y, folder->name);
+                        Rectangle toggleBounds = { x - 4, y - 4, row.bounds.x + row.bounds.width + 30 - x, 30 };
+                        if (CheckCollisionPointRec(mousePoint, toggleBounds) && IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) {
+                            listFolderOnExpand(&scriptWatcher, &scriptIndex, entry.folder);
+                            setFolderExpanded(&scriptIndex, entry.folder, !folder->expanded);
+                            files = scriptIndex.files;
+                            fileCount = scriptIndex.count;
+                        }
+                        continue;
+                    }
+
+                    int i = entry.file;
+                    FileRowLayout row = getFileRowLayout(scrollList.container, x, y, files[i].displayName);
+
+                    // The file icon doubles as the selection checkbox
+                    Rectangle selectBounds = { x - 4, y - 4, 26, 30 };
+                    if (CheckCollisionPointRec(mousePoint, selectBounds)) {
                         if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) {
-                            executeFileContent(files[i].filePath);
-                            files[i].isExecuting = true;
-                            executingIndex = i;
+                            files[i].isSelected = !files[i].isSelected;
                         }
                     }
 
-                    if (CheckCollisionPointRec(mousePoint, files[i].editBounds)) {
+                    if (CheckCollisionPointRec(mousePoint, row.bounds)) {
                         if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) {
-                            openEditModal(&modal, &files[i], i);
+                            startScriptRun(&runManager, &scriptIndex, i, runMode);
                         }
                     }
 
-                    if (CheckCollisionPointRec(mousePoint, files[i].deleteBounds)) {
+                    if (peekRunInfo(&scriptIndex, &files[i])->activeRuns > 0 &&
+                        CheckCollisionPointRec(mousePoint, row.cancelBounds)) {
                         if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) {
-                            if (deleteScript(files[i].filePath)) {
-                                fileCount = loadFiles(files, scriptDir);
-                            }
+                            cancelFileRuns(&runManager, &scriptIndex, i);
                         }
                     }
-                }
 
-                y += 40;
-            }
+                    if (CheckCollisionPointRec(mousePoint, row.editBounds)) {
+                        if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) {
+                            openEditModal(&modal, &scriptIndex, &files[i]);
+                        }
+                    }
 
-            static int executingTimer = 0;
-            if (executingIndex >= 0) {
-                executingTimer++;
-                if (executingTimer > 30) {
-                    if (executingIndex < fileCount) {
-                        files[executingIndex].isExecuting = false;
+                    if (CheckCollisionPointRec(mousePoint, row.deleteBounds)) {
+                        if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) {
+                            char filePath[1024];
+                            getFilePath(&scriptIndex, &files[i], filePath, sizeof(filePath));
+                            if (deleteScript(filePath) && !scriptWatcher.running) {
+                                reloadFiles(&scriptIndex, &runManager, &workerPool);
+                                files = scriptIndex.files;
+                                fileCount = scriptIndex.count;
+                            }
+                        }
                     }
-                    executingIndex = -1;
-                    executingTimer = 0;
                 }
             }
         }
 
-        // Draw
+        // Draw, with anything listed by a click above already in order
+        refreshScriptOrders(&scriptIndex);
         BeginDrawing();
         ClearBackground((Color){40, 42, 54, 255});
 
@@ -1418,6 +9336,84 @@ int main() {
             DrawTextCustom(customFont, useCustomFont, "Add Script", 110, 16, 16, (Color){189, 147, 249, 255});
             DrawTextCustom(customFont, useCustomFont, "| Open Folder", 190, 16, 16, (Color){139, 233, 253, 255});
 
+            // Draw run mode toggle
+            Color modeColor = CheckCollisionPointRec(mousePoint, modeButton) ?
+                             (Color){70, 75, 90, 255} : (Color){50, 55, 70, 255};
+            DrawRectangleRec(modeButton, modeColor);
+            DrawRectangleLinesEx(modeButton, 2, (Color){100, 105, 120, 255});
+            const char *modeLabel = "Mode: Terminal";
+            Color modeLabelColor = (Color){248, 248, 242, 255};
+            if (runMode == RUN_MODE_CAPTURE) {
+                modeLabel = "Mode: Capture";
+                modeLabelColor = (Color){80, 250, 123, 255};
+            } else if (runMode == RUN_MODE_WARM) {
+                modeLabel = "Mode: Warm";
+                modeLabelColor = (Color){255, 184, 108, 255};
+            }
+            DrawTextCustom(customFont, useCustomFont, modeLabel,
+                           (int)modeButton.x + 12, (int)modeButton.y + 7, 16, modeLabelColor);
+
+            // Draw batch controls
+            int selectedCount = 0;
+            for (int i = 0; i < fileCount; i++) {
+                if (files[i].isSelected) selectedCount++;
+            }
+            Color runSelectedColor = CheckCollisionPointRec(mousePoint, runSelectedButton) ?
+                                    (Color){70, 75, 90, 255} : (Color){50, 55, 70, 255};
+            DrawRectangleRec(runSelectedButton, runSelectedColor);
+            DrawRectangleLinesEx(runSelectedButton, 2, (Color){100, 105, 120, 255});
+            DrawTextCustom(customFont, useCustomFont, TextFormat("Run Selected (%d)", selectedCount),
+                           (int)runSelectedButton.x + 8, (int)runSelectedButton.y + 7, 16,
+                           selectedCount > 0 ? (Color){80, 250, 123, 255} : (Color){98, 114, 164, 255});
+
+            Color pipelineColor = CheckCollisionPointRec(mousePoint, pipelineButton) ?
+                                 (Color){70, 75, 90, 255} : (Color){50, 55, 70, 255};
+            DrawRectangleRec(pipelineButton, pipelineColor);
+            DrawRectangleLinesEx(pipelineButton, 2, (Color){100, 105, 120, 255});
+            DrawTextCustom(customFont, useCustomFont, "Run Pipeline", (int)pipelineButton.x + 10, (int)pipelineButton.y + 7, 16,
+                           pipeline.active ? (Color){241, 250, 140, 255} : (Color){248, 248, 242, 255});
+
+            DrawRectangleRec(poolMinusButton, CheckCollisionPointRec(mousePoint, poolMinusButton) ? (Color){70, 75, 90, 255} : (Color){50, 55, 70, 255});
+            DrawTextCustom(customFont, useCustomFont, "-", (int)poolMinusButton.x + 8, (int)poolMinusButton.y + 3, 18, (Color){248, 248, 242, 255});
+            DrawTextCustom(customFont, useCustomFont, TextFormat("x%d", workerPool.concurrencyCap),
+                           (int)poolMinusButton.x + 30, (int)poolMinusButton.y + 4, 16, (Color){139, 233, 253, 255});
+            DrawRectangleRec(poolPlusButton, CheckCollisionPointRec(mousePoint, poolPlusButton) ? (Color){70, 75, 90, 255} : (Color){50, 55, 70, 255});
+            DrawTextCustom(customFont, useCustomFont, "+", (int)poolPlusButton.x + 7, (int)poolPlusButton.y + 3, 18, (Color){248, 248, 242, 255});
+
+            // Draw search mode toggle and search box, with the match count and how long it took
+            Color searchModeColor = CheckCollisionPointRec(mousePoint, searchModeButton) ?
+                                   (Color){70, 75, 90, 255} : (Color){50, 55, 70, 255};
+            DrawRectangleRec(searchModeButton, searchModeColor);
+            DrawRectangleLinesEx(searchModeButton, 2, (Color){100, 105, 120, 255});
+            DrawTextCustom(customFont, useCustomFont, grepMode ? "Contents" : "Names", (int)searchModeButton.x + 10,
+                           (int)searchModeButton.y + 7, 16, grepMode ? (Color){255, 184, 108, 255} : (Color){139, 233, 253, 255});
+
+            const char *sortLabels[SORT_MODE_COUNT] = { "Sort: Name", "Sort: Modified", "Sort: Last run", "Sort: Run count", "Sort: Avg time" };
+            Color sortColor = CheckCollisionPointRec(mousePoint, sortButton) ?
+                             (Color){70, 75, 90, 255} : (Color){50, 55, 70, 255};
+            DrawRectangleRec(sortButton, sortColor);
+            DrawRectangleLinesEx(sortButton, 2, (Color){100, 105, 120, 255});
+            DrawTextCustom(customFont, useCustomFont, sortLabels[scriptIndex.sortMode], (int)sortButton.x + 12, (int)sortButton.y + 7, 16,
+                           scriptIndex.sortMode == SORT_BY_NAME ? (Color){248, 248, 242, 255} : (Color){80, 250, 123, 255});
+
+            DrawRectangleRec(searchBox, (Color){30, 32, 44, 255});
+            DrawRectangleLinesEx(searchBox, 2, searchLength > 0 ? (Color){189, 147, 249, 255} : (Color){68, 71, 90, 255});
+            if (searchLength > 0) {
+                DrawTextCustom(customFont, useCustomFont, searchQuery, (int)searchBox.x + 10, (int)searchBox.y + 6, 18, (Color){248, 248, 242, 255});
+                const char *searchInfo = grepMode ?
+                    TextFormat("%d%s lines  %.1f ms%s", contentGrep.matchCount, contentGrep.matchCount == GREP_MAX_MATCHES ? "+" : "",
+                               contentGrep.elapsedMs, contentGrep.active ? "  searching..." : "") :
+                    TextFormat("%d%s matches  %.2f ms", searchResultCount, searchResultCount == SEARCH_MAX_RESULTS ? "+" : "", searchMs);
+                DrawTextCustom(customFont, useCustomFont, searchInfo,
+                               (int)searchClearButton.x - 12 - MeasureText(searchInfo, 14), (int)searchBox.y + 8, 14, (Color){98, 114, 164, 255});
+                Color clearColor = CheckCollisionPointRec(mousePoint, searchClearButton) ?
+                                   (Color){255, 85, 85, 255} : (Color){98, 114, 164, 255};
+                DrawTextCustom(customFont, useCustomFont, "x", (int)searchClearButton.x + 6, (int)searchClearButton.y + 1, 18, clearColor);
+            } else {
+                DrawTextCustom(customFont, useCustomFont, grepMode ? "Type to find exact text in every script" : "Type to search names and contents",
+                               (int)searchBox.x + 10, (int)searchBox.y + 7, 16, (Color){98, 114, 164, 255});
+            }
+
             // Draw scrollable container
             DrawRectangleRec(scrollList.container, (Color){30, 32, 44, 255});
             DrawRectangleLinesEx(scrollList.container, 2, (Color){68, 71, 90, 255});
@@ -1429,40 +9425,140 @@ int main() {
                 (int)scrollList.container.height
             );
 
-            float y = scrollList.container.y + 10 - scrollList.scrollOffset;
-            float x = scrollList.container.x + 10;
+            for (int r = firstRow; r < rowCount; r++) {
+                float y = scrollList.container.y + 10 - scrollList.scrollOffset + r * 40;
+                if (y > scrollList.container.y + scrollList.container.height) break;
 
-            for (int i = 0; i < fileCount; i++) {
-                if (y >= scrollList.container.y - 40 && y <= scrollList.container.y + scrollList.container.height) {
+                if (showGrep) {
+                    if (y < scrollList.container.y - 40) continue;
+                    const GrepMatch *match = &contentGrep.matches[r];
+                    float x = scrollList.container.x + 10;
+                    if (CheckCollisionPointRec(mousePoint, (Rectangle){ x, y - 5, scrollList.container.width - 20, 30 })) {
+                        DrawRectangle((int)x, (int)(y - 5), (int)scrollList.container.width - 20, 30, (Color){44, 47, 62, 255});
+                    }
+                    const char *location = TextFormat("%s:%d", match->fileName, match->line);
+                    DrawTextCustom(customFont, useCustomFont, location, (int)x, (int)y + 2, 16, (Color){139, 233, 253, 255});
+                    DrawTextCustom(customFont, useCustomFont, match->preview, (int)x + MeasureText(location, 16) + 16, (int)y + 2, 16, (Color){248, 248, 242, 255});
+                    continue;
+                }
+
+                ScriptRow entry;
+                if (y >= scrollList.container.y - 40 && getListRow(&scriptIndex, shownResults, searchResultCount, r, &entry)) {
+                    float x = scrollList.container.x + 10 + entry.depth * 24;
+
+                    if (entry.file < 0) {
+                        const ScriptFolder *folder = &scriptIndex.folders[entry.folder];
+                        FileRowLayout row = getFileRowLayout(scrollList.container, x, y, folder->name);
+                        if (CheckCollisionPointRec(mousePoint, row.bounds)) {
+                            DrawRectangle((int)x, (int)(y - 5), (int)(scrollList.container.x + scrollList.container.width - 10 - x), 30, (Color){44, 47, 62, 255});
+                        }
+                        drawFolderIcon((int)x, (int)y + 2);
+                        DrawTextCustom(customFont, useCustomFont, folder->name, (int)(x + 30), (int)y, fontSize, (Color){255, 200, 100, 255});
+
+                        // Chevron, then the entry count once the folder has been listed
+                        float chevronX = row.bounds.x + row.bounds.width + 12;
+                        float chevronY = y + fontSize / 2.0f;
+                        Color chevronColor = (Color){98, 114, 164, 255};
+                        if (folder->expanded) {
+                            DrawTriangle((Vector2){chevronX, chevronY - 3}, (Vector2){chevronX + 10, chevronY - 3}, (Vector2){chevronX + 5, chevronY + 4}, chevronColor);
+                        } else {
+                            DrawTriangle((Vector2){chevronX, chevronY - 5}, (Vector2){chevronX + 7, chevronY}, (Vector2){chevronX, chevronY + 5}, chevronColor);
+                        }
+                        if (folder->loaded) {
+                            DrawTextCustom(customFont, useCustomFont, TextFormat("%d", folder->childCount + folder->fileCount),
+                                           (int)chevronX + 20, (int)y + 3, 14, chevronColor);
+                        }
+                        continue;
+                    }
+
+                    int i = entry.file;
+                    FileRowLayout row = getFileRowLayout(scrollList.container, x, y, files[i].displayName);
                     Color textColor = (Color){248, 248, 242, 255};
                     Color iconColor = (Color){189, 147, 249, 255};
-
-                    if (files[i].isExecuting) {
+                    const ScriptRunInfo *runInfo = peekRunInfo(&scriptIndex, &files[i]);
+
+                    if (runInfo->runState == RUN_STATE_RUNNING) {
+                        textColor = (Color){139, 233, 253, 255};
+                        iconColor = (Color){139, 233, 253, 255};
+                    } else if (runInfo->runState == RUN_STATE_QUEUED) {
+                        textColor = (Color){241, 250, 140, 255};
+                        iconColor = (Color){241, 250, 140, 255};
+                    } else if (runInfo->runState == RUN_STATE_STOPPING) {
+                        textColor = (Color){255, 184, 108, 255};
+                        iconColor = (Color){255, 184, 108, 255};
+                    } else if (runInfo->runState == RUN_STATE_SUCCEEDED) {
                         textColor = (Color){80, 250, 123, 255};
                         iconColor = (Color){80, 250, 123, 255};
+                    } else if (runInfo->runState == RUN_STATE_FAILED) {
+                        textColor = (Color){255, 85, 85, 255};
+                        iconColor = (Color){255, 85, 85, 255};
                     }
 
-                    if (CheckCollisionPointRec(mousePoint, files[i].bounds)) {
+                    if (files[i].isSelected) {
+                        DrawRectangle((int)x - 4, (int)(y - 4), 26, 30, (Color){68, 71, 90, 255});
+                        DrawRectangleLines((int)x - 4, (int)(y - 4), 26, 30, (Color){139, 233, 253, 255});
+                    }
+
+                    if (CheckCollisionPointRec(mousePoint, row.bounds)) {
                         DrawRectangle((int)x, (int)(y - 5), (int)scrollList.container.width - 20, 30, (Color){44, 47, 62, 255});
                     }
 
                     drawFileIcon((int)x, (int)y, iconColor);
                     DrawTextCustom(customFont, useCustomFont, files[i].displayName, (int)(x + 30), (int)y, fontSize, textColor);
 
-                    Color editColor = CheckCollisionPointRec(mousePoint, files[i].editBounds) ?
+                    int metricsEnd = (int)(row.bounds.x + row.bounds.width);
+                    if (shownResults != NULL && files[i].folder != 0) {
+                        const char *folderPath = scriptIndex.folders[files[i].folder].path;
+                        DrawTextCustom(customFont, useCustomFont, folderPath, metricsEnd + 16, (int)y + 3, 14, (Color){255, 200, 100, 255});
+                        metricsEnd += 16 + MeasureText(folderPath, 14);
+                    }
+                    if (runInfo->hasResult) {
+                        const RunResult *last = &runInfo->lastResult;
+                        const char *metrics = TextFormat("%s %d  %.2fs  cpu %.2fs  %.1f MB",
+                                                         last->timedOut ? "timed out" : last->cancelled ? "cancelled" : "exit",
+                                                         last->exitCode, last->wallSeconds, last->cpuSeconds, (double)last->maxRssKb / 1024.0);
+                        DrawTextCustom(customFont, useCustomFont, metrics, metricsEnd + 16, (int)y + 3, 14, (Color){98, 114, 164, 255});
+                        metricsEnd += 16 + MeasureText(metrics, 14);
+                    }
+
+                    // Run history, right aligned against the row buttons when there is room
+                    const ScriptHistory *stats = getScriptHistory(&runHistory, files[i].historyKey);
+                    if (stats != NULL && stats->runs > 0) {
+                        char p50[16], p95[16], p99[16], historyText[128];
+                        formatDurationMs(stats->p50Ms, p50, sizeof(p50));
+                        formatDurationMs(stats->p95Ms, p95, sizeof(p95));
+                        formatDurationMs(stats->p99Ms, p99, sizeof(p99));
+                        snprintf(historyText, sizeof(historyText), "p50 %s  p95 %s  p99 %s  %u%% fail  n=%u",
+                                 p50, p95, p99, (unsigned)((uint64_t)stats->failures * 100 / stats->runs), stats->runs);
+                        int historyX = (int)row.cancelBounds.x - 16 - MeasureText(historyText, 14);
+                        if (historyX > metricsEnd + 16) {
+                            Color historyColor = stats->failures > 0 ? (Color){255, 184, 108, 255} : (Color){98, 114, 164, 255};
+                            DrawTextCustom(customFont, useCustomFont, historyText, historyX, (int)y + 3, 14, historyColor);
+                        }
+                    }
+
+                    // Stop button, only while something from this entry is running
+                    if (runInfo->activeRuns > 0) {
+                        Color cancelColor = runInfo->stoppingRuns > 0 ? (Color){255, 184, 108, 255} :
+                                            CheckCollisionPointRec(mousePoint, row.cancelBounds) ?
+                                            (Color){255, 85, 85, 255} : (Color){255, 121, 198, 255};
+                        DrawRectangleRec(row.cancelBounds, cancelColor);
+                        DrawRectangleLinesEx(row.cancelBounds, 1, (Color){98, 114, 164, 255});
+                        DrawRectangle((int)row.cancelBounds.x + 10, (int)row.cancelBounds.y + 7, 10, 10, WHITE);
+                    }
+
+                    Color editColor = CheckCollisionPointRec(mousePoint, row.editBounds) ?
                                      (Color){241, 250, 140, 255} : (Color){139, 233, 253, 255};
-                    DrawRectangleRec(files[i].editBounds, editColor);
-                    DrawRectangleLinesEx(files[i].editBounds, 1, (Color){98, 114, 164, 255});
-                    DrawTextCustom(customFont, useCustomFont, "E", (int)files[i].editBounds.x + 10, (int)files[i].editBounds.y + 4, 16, (Color){40, 42, 54, 255});
+                    DrawRectangleRec(row.editBounds, editColor);
+                    DrawRectangleLinesEx(row.editBounds, 1, (Color){98, 114, 164, 255});
+                    DrawTextCustom(customFont, useCustomFont, "E", (int)row.editBounds.x + 10, (int)row.editBounds.y + 4, 16, (Color){40, 42, 54, 255});
 
-                    Color deleteColor = CheckCollisionPointRec(mousePoint, files[i].deleteBounds) ?
+                    Color deleteColor = CheckCollisionPointRec(mousePoint, row.deleteBounds) ?
                                        (Color){255, 85, 85, 255} : (Color){255, 121, 198, 255};
-                    DrawRectangleRec(files[i].deleteBounds, deleteColor);
-                    DrawRectangleLinesEx(files[i].deleteBounds, 1, (Color){98, 114, 164, 255});
-                    DrawTextCustom(customFont, useCustomFont, "X", (int)files[i].deleteBounds.x + 10, (int)files[i].deleteBounds.y + 4, 16, WHITE);
+                    DrawRectangleRec(row.deleteBounds, deleteColor);
+                    DrawRectangleLinesEx(row.deleteBounds, 1, (Color){98, 114, 164, 255});
+                    DrawTextCustom(customFont, useCustomFont, "X", (int)row.deleteBounds.x + 10, (int)row.deleteBounds.y + 4, 16, WHITE);
                 }
-
-                y += 40;
             }
 
             EndScissorMode();
@@ -1480,6 +9576,16 @@ int main() {
                 );
             }
 
+            if (runManager.shownCapture != NULL) {
+                OutputCapture *shown = runManager.shownCapture;
+                bool isRunning = !shown->processExited || !atomic_load(&shown->readerDone);
+                DrawConsolePanel(customFont, useCustomFont, shown, consolePanel, consoleCloseButton, isRunning, mousePoint);
+            }
+
+            if (pipelineSummary[0] != '\0') {
+                DrawTextCustom(customFont, useCustomFont, pipelineSummary, 340, GetScreenHeight() - 28, 16, (Color){241, 250, 140, 255});
+            }
+
             #ifdef PLATFORM_WINDOWS
                 DrawTextCustom(customFont, useCustomFont, TextFormat("Windows | Scripts: %d | Format: .bat", fileCount),
                         10, GetScreenHeight() - 28, 16, (Color){98, 114, 164, 255});
@@ -1527,11 +9633,7 @@ int main() {
             DrawRectangleRec(modal.commandBox, (Color){68, 71, 90, 255});
             DrawRectangleLinesEx(modal.commandBox, 2, modal.commandActive ? (Color){139, 233, 253, 255} : (Color){98, 114, 164, 255});
 
-            // Count lines for line numbers
-            int lineCount = 1;
-            for (int i = 0; i < modal.commandLength; i++) {
-                if (modal.command[i] == '\n') lineCount++;
-            }
+            int lineCount = getTextLineCount(&modal.command);
 
             // Calculate content height for scrolling
             int lineHeight = fontSize + 4;
@@ -1545,7 +9647,7 @@ int main() {
 
             // Use the enhanced DrawCommandWithLineNumbers function
             bool showCursor = modal.commandActive && ((modal.framesCounter / 20) % 2) == 0;
-            DrawCommandWithLineNumbers(customFont, useCustomFont, modal.command, modal.commandBox,
+            DrawCommandWithLineNumbers(customFont, useCustomFont, &modal.command, &modal.layout, modal.commandBox,
                                      modal.commandScrollOffsetY, fontSize,
                                      modal.cursorPos, showCursor,
                                      modal.selectionStart, modal.selectionEnd, modal.hasSelection);
@@ -1582,12 +9684,22 @@ int main() {
             DrawTextCustom(customFont, useCustomFont, "Save", (int)saveButton.x + 25, (int)saveButton.y + 8, 20, (Color){40, 42, 54, 255});
 
             if (CheckCollisionPointRec(mousePoint, saveButton) && IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) {
-                if (modal.isEditMode && modal.editIndex >= 0 && modal.editIndex < fileCount) {
-                    deleteScript(files[modal.editIndex].filePath);
+                // An edited script is saved back into the folder it came from
+                char saveDir[512];
+                snprintf(saveDir, sizeof(saveDir), "%s", scriptDir);
+                if (modal.isEditMode && modal.editPath[0] != '\0') {
+                    deleteScript(modal.editPath);
+                    snprintf(saveDir, sizeof(saveDir), "%s", modal.editPath);
+                    char *lastSlash = strrchr(saveDir, '/');
+                    if (lastSlash != NULL) *lastSlash = '\0';
                 }
 
-                if (saveNewScript(scriptDir, modal.filename, modal.command)) {
-                    fileCount = loadFiles(files, scriptDir);
+                if (saveNewScript(saveDir, modal.filename, getTextString(&modal.command))) {
+                    if (!scriptWatcher.running) {
+                        reloadFiles(&scriptIndex, &runManager, &workerPool);
+                        files = scriptIndex.files;
+                        fileCount = scriptIndex.count;
+                    }
                     closeModal(&modal);
                 }
             }
@@ -1607,6 +9719,12 @@ int main() {
         }
 
         EndDrawing();
+
+        if (!firstFrameDrawn) {
+            firstFrameDrawn = true;
+            printf("[STARTUP] First frame after %.1f ms (%d scripts listed so far)\n",
+                   (getMonotonicSeconds() - startTime) * 1000.0, fileCount);
+        }
     }
 
     // Unload custom font
@@ -1614,6 +9732,18 @@ int main() {
         UnloadFont(customFont);
     }
 
+    stopScriptWatcher(&scriptWatcher);
+    freeScriptIndex(&scriptIndex);
+    freeSearchIndex(&scriptSearch);
+    freeContentGrep(&contentGrep);
+    clearUndoHistory(&modal);
+    freeTextBuffer(&modal.command);
+    freeTextLayout(&modal.layout);
+    shutdownWorkerPool(&workerPool);
+    shutdownWarmShells();
+    shutdownRunManager(&runManager);
+    shutdownRunHistory(&runHistory);
+
     CloseWindow();
     return 0;
 }